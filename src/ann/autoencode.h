@@ -18,6 +18,7 @@
  * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cmath>
 #include <torch/nn/modules/loss.h>
 #include <torch/optim/adamw.h>
 #include <torch/optim/sgd.h>
@@ -27,9 +28,11 @@
 #include "autoencoder.h"
 #include "globals.h"
 #include "../data/eisdataset.h"
+#include "../data/eisdataloader.h"
 #include "log.h"
 #include "tensoroptions.h"
 #include "trainlog.h"
+#include "metricaccumulator.h"
 #include "indicators.hpp"
 #include "r2score.h"
 
@@ -62,7 +65,7 @@ int trainEpoch(std::shared_ptr<AutoEncoder> network, DataLoader& loader, LossFn&
 		indicators::option::MaxProgress(data_size/(batch_size))
 	);
 
-	torch::Tensor loss;
+	MetricAccumulator metrics(*offload_device);
 
 	for(auto& batch : loader)
 	{
@@ -71,25 +74,34 @@ int trainEpoch(std::shared_ptr<AutoEncoder> network, DataLoader& loader, LossFn&
 		torch::Tensor prediction = network->forward(data);
 		torch::Tensor loss = lossFn(prediction, data);
 
-		if(torch::isnan(torch::sum(loss)).item().to<bool>())
-		{
-			Log(Log::ERROR)<<loss<<"\nloss contains NAN!";
-			return -1;
-		}
-
 		optimizer.zero_grad();
 		loss.backward();
 		optimizer.step();
 
-		if(log && index % loginterval == 0)
+		metrics.add(loss, prediction.size(0));
+
+		// the loss is only checked when it is read back anyway, to avoid synchronizing with the device every step
+		if(index % loginterval == 0)
 		{
-			auto end = std::min(data_size, (index + 1) * batch_size);
-			log->logTrainLoss(epoch, end, loss.template item<float>(), 0, data_size);
+			MetricAccumulator::Values values = metrics.read();
+			if(std::isnan(values.loss))
+			{
+				Log(Log::ERROR)<<"loss contains NAN!";
+				return -1;
+			}
+			if(log)
+				log->logTrainLoss(epoch, metrics.getSamples(), values.loss, 0, data_size);
 		}
 
 		index++;
 	}
 
+	if(index > 0 && std::isnan(metrics.read().meanLoss))
+	{
+		Log(Log::ERROR)<<"loss contains NAN!";
+		return -1;
+	}
+
 	return 0;
 }
 
@@ -165,10 +177,12 @@ void train(TrainLog* trainLog, std::shared_ptr<AutoEncoder> net, EisDataset<Data
 	net->setExtraInputs(dataset->extraInputs());
 	net->to(*offload_device);
 
-	torch::data::DataLoaderOptions options;
-	options = options.batch_size(batch_size).workers(JOBS);
-	auto trainDataLoader = torch::data::make_data_loader<torch::data::samplers::RandomSampler>(dataset->map(torch::data::transforms::Stack<>()), options);
-	auto testDataLoader = testDataset ? torch::data::make_data_loader<torch::data::samplers::RandomSampler>(testDataset->map(torch::data::transforms::Stack<>()), options) : nullptr;
+	EisDataLoaderOptions trainLoaderOptions = EisDataLoaderOptions::fromGlobals(batch_size);
+	trainLoaderOptions.device = *offload_device;
+	trainLoaderOptions.augmentation = dataset->getAugmentation();
+	auto trainDataLoader = std::make_unique<EisDataLoader<DatasetType>>(dataset, trainLoaderOptions);
+	auto testDataLoader = testDataset ? std::make_unique<EisDataLoader<TestDatasetType>>(testDataset, EisDataLoaderOptions::fromGlobals(batch_size)) : nullptr;
+	Log(Log::DEBUG)<<"Decoding training data with "<<trainDataLoader->workers()<<" workers";
 
 	size_t active_parameters = 0;
 	size_t inactive_parameters = 0;
@@ -198,7 +212,7 @@ void train(TrainLog* trainLog, std::shared_ptr<AutoEncoder> net, EisDataset<Data
 		}
 
 		trainLog->saveNetwork(net);
-		Log(Log::INFO)<<"Epoch "<<i<<'/'<<epochs;
+		Log(Log::INFO)<<"Epoch "<<i<<'/'<<epochs<<", trainer waited "<<trainDataLoader->waitSeconds()<<"s for data";
 	}
 
 	sum = 0;
@@ -29,9 +29,11 @@
 #include "net.h"
 #include "globals.h"
 #include "../data/eisdataset.h"
+#include "../data/eisdataloader.h"
 #include "log.h"
 #include "tensoroptions.h"
 #include "trainlog.h"
+#include "metricaccumulator.h"
 #include "tensoroperators.h"
 #include "indicators.hpp"
 #include <ATen/autocast_mode.h>
@@ -51,12 +53,12 @@ void exportRandomSamples(const torch::Tensor& data, const torch::Tensor& targets
 						 bool outputProb);
 
 template <typename DataLoader>
-void trainImpl(std::shared_ptr<Net> network, DataLoader& loader, torch::optim::Optimizer& optimizer,
+int trainImpl(std::shared_ptr<Net> network, DataLoader& loader, torch::optim::Optimizer& optimizer,
 		   size_t epoch, size_t data_size, torch::Tensor classWeights, bool isMulticlass = false, TrainLog* log = nullptr)
 {
 	size_t index = 0;
 	network->train();
-	float accF = 0;
+	MetricAccumulator metrics(*offload_device);
 
 	torch::nn::BCEWithLogitsLoss lossBCE(torch::nn::BCEWithLogitsLossOptions().reduction(torch::kMean).pos_weight(classWeights));
 	torch::nn::NLLLoss lossNll(torch::nn::NLLLossOptions().reduction(torch::kMean).weight(classWeights));
@@ -79,30 +81,43 @@ void trainImpl(std::shared_ptr<Net> network, DataLoader& loader, torch::optim::O
 		{
 			targets = targets.view({-1});
 			loss = lossNll->forward(prediction, targets.to(torch::kInt64));
-			acc = prediction.argmax(1).eq(targets).sum().to(torch::kCPU);
+			acc = prediction.argmax(1).eq(targets).sum();
 		}
 		else
 		{
 			targets = targets.reshape({prediction.size(0), prediction.size(1)});
 
-			loss = lossBCE->forward(prediction, targets.to(torch::kFloat32)).to(torch::kCPU);
-			acc = multiClassHits(torch::sigmoid(prediction), targets, 0.25).sum().to(torch::kCPU);
+			loss = lossBCE->forward(prediction, targets.to(torch::kFloat32));
+			acc = multiClassHits(torch::sigmoid(prediction), targets, 0.25).sum();
 		}
-		assert(!std::isnan(loss.template item<float>()));
 
 		optimizer.zero_grad();
 		loss.backward();
 		optimizer.step();
 
-		accF += acc.template item<float>();
+		metrics.add(loss, prediction.size(0), acc);
 
-		if (index++ % batchesPerPrint == 0 )
+		// the loss is only checked when it is read back anyway, to avoid synchronizing with the device every step
+		if(index++ % batchesPerPrint == 0)
 		{
-			auto end = std::min(data_size, (index + 1) * batch_size);
+			MetricAccumulator::Values values = metrics.read();
+			if(std::isnan(values.loss))
+			{
+				Log(Log::ERROR)<<"loss contains NAN!";
+				return -1;
+			}
 			if(log)
-				log->logTrainLoss(epoch, end, loss.template item<float>()*100, accF/end, data_size);
+				log->logTrainLoss(epoch, metrics.getSamples(), values.loss*100, values.accuracy, data_size);
 		}
 	}
+
+	if(index > 0 && std::isnan(metrics.read().meanLoss))
+	{
+		Log(Log::ERROR)<<"loss contains NAN!";
+		return -1;
+	}
+
+	return 0;
 }
 
 template <typename DataLoader>
@@ -267,11 +282,12 @@ void train(TrainLog* trainLog, std::shared_ptr<Net> net, EisDataset<DatasetType>
 	else
 		classWeights = trainDataset->classWeights().to(*offload_device);
 
-	torch::data::DataLoaderOptions options;
-	options = options.batch_size(batch_size).workers(JOBS);
-	auto trainDataLoader = torch::data::make_data_loader<torch::data::samplers::RandomSampler>(trainDataset->map(torch::data::transforms::Stack<>()), options);
-	options = options.batch_size(batch_size*16).workers(JOBS);
-	auto testDataLoader = testDataset ? torch::data::make_data_loader(testDataset->map(torch::data::transforms::Stack<>()), options) : nullptr;
+	EisDataLoaderOptions trainLoaderOptions = EisDataLoaderOptions::fromGlobals(batch_size);
+	trainLoaderOptions.device = *offload_device;
+	trainLoaderOptions.augmentation = trainDataset->getAugmentation();
+	auto trainDataLoader = std::make_unique<EisDataLoader<DatasetType>>(trainDataset, trainLoaderOptions);
+	auto testDataLoader = testDataset ? std::make_unique<EisDataLoader<TestDatasetType>>(testDataset, EisDataLoaderOptions::fromGlobals(batch_size*16, false)) : nullptr;
+	Log(Log::DEBUG)<<"Decoding training data with "<<trainDataLoader->workers()<<" workers";
 
 	size_t active_parameters = 0;
 	size_t inactive_parameters = 0;
@@ -294,8 +310,9 @@ void train(TrainLog* trainLog, std::shared_ptr<Net> net, EisDataset<DatasetType>
 
 	for (size_t i = 0; i < epochs; ++i)
 	{
-		trainImpl(net, *trainDataLoader, optimizer, i, trainDataset->size().value(),
-			classWeights, trainDataset->isMulticlass(), trainLog);
+		if(trainImpl(net, *trainDataLoader, optimizer, i, trainDataset->size().value(),
+			classWeights, trainDataset->isMulticlass(), trainLog) != 0)
+			return;
 		if(testDataset)
 		{
 			test(net, *testDataLoader, testDataset->size().value(), trainDataset->outputSize(),
@@ -303,7 +320,7 @@ void train(TrainLog* trainLog, std::shared_ptr<Net> net, EisDataset<DatasetType>
 		}
 
 		trainLog->saveNetwork(net);
-		Log(Log::INFO)<<"Epoch "<<i<<'/'<<epochs;
+		Log(Log::INFO)<<"Epoch "<<i<<'/'<<epochs<<", trainer waited "<<trainDataLoader->waitSeconds()<<"s for data";
 	}
 
 	sum = 0;
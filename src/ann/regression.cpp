@@ -36,8 +36,8 @@ torch::Tensor ann::regression::use(torch::Tensor input, std::shared_ptr<Net> net
 	torch::NoGradGuard noGrad;
 	net->eval();
 	torch::Tensor output = net->forward(input);
-	torch::Tensor outputScalars = net->getOutputScalars();
-	torch::Tensor outputBias    = net->getOutputBiases();
+	torch::Tensor outputScalars = net->getOutputScalars().to(output.device());
+	torch::Tensor outputBias    = net->getOutputBiases().to(output.device());
 	output = (output*outputScalars+outputBias);
 	return output;
 }
@@ -28,7 +28,10 @@
 #include <torch/nn/modules/loss.h>
 #include <torch/nn/options/loss.h>
 #include <torch/optim.h>
+#include <filesystem>
+#include <sstream>
 #include <string>
+#include <type_traits>
 #include <eisgenerator/model.h>
 #include <torch/optim/adamw.h>
 #include <torch/optim/sgd.h>
@@ -38,8 +41,12 @@
 #include "globals.h"
 #include "log.h"
 #include "trainlog.h"
+#include "anomalyguard.h"
+#include "metricaccumulator.h"
+#include "randomgen.h"
 #include "loss/eisdistanceloss.h"
 #include "data/regressiondataset.h"
+#include "data/eisdataloader.h"
 #include "tensoroptions.h"
 #include "tensoroperators.h"
 #include "r2score.h"
@@ -70,89 +77,76 @@ int trainImpl(std::shared_ptr<Net> network, DataLoader& loader,
 	size_t index = 0;
 	network->train();
 
-	float lossAccumulator = 0;
-	torch::Tensor distanceAccumulator = torch::zeros({outputSize}, torch::TensorOptions().dtype(torch::kFloat32).device(*offload_device));
+	MetricAccumulator metrics(*offload_device);
 
 	int64_t loginterval = data_size/10000 ?: (data_size/batch_size-1)/10 ?: 1;
 
-	std::vector<torch::OrderedDict<std::string, torch::Tensor>> parameters;
+	AnomalyGuard guard(*network, anomaly_check_interval, anomaly_snapshot_interval);
 
-	torch::Tensor prevLoss;
 	torch::Tensor loss;
+	torch::Tensor data;
+	torch::Tensor targets;
+	torch::Tensor prediction;
 
-	for(auto& batch : loader)
-	{
-		torch::Tensor data = batch.data.to(*offload_device);
-		torch::Tensor targets = ((batch.target-network->getOutputBiases())/network->getOutputScalars()).to(*offload_device);
-
-		torch::Tensor prediction = network->forward(data);
+	torch::Tensor outputBiases = network->getOutputBiases().to(*offload_device);
+	torch::Tensor outputScalars = network->getOutputScalars().to(*offload_device);
 
-		parameters.push_back(network->named_parameters(true));
-		for(torch::OrderedDict<std::string, torch::Tensor>::Item& parameter : parameters.back())
-			parameter.value() = parameter.value().clone();
-		if(parameters.size() > 3)
-			parameters.erase(parameters.begin());
+	auto reportAnomaly = [&]()
+	{
+		std::stringstream description;
+		description<<"Non finite prediction or loss in epoch "<<epoch<<" with seed "<<rd::getSeed();
+		Log(Log::ERROR)<<"Prediction or loss contains NAN or INF in epoch "<<epoch<<" step "<<index;
+		guard.writeBundle(*network, log ? log->getDir() : std::filesystem::current_path(), epoch, description.str(),
+			{{"inputs", data}, {"targets", targets}, {"prediction", prediction.detach()}, {"loss", loss.detach()}});
+	};
 
-		if(torch::isnan(torch::sum(prediction)).item().to<bool>())
-		{
-			for(torch::OrderedDict<std::string, torch::Tensor> dict : parameters)
-			{
-				Log(Log::ERROR)<<"STEP";
-				for(torch::OrderedDict<std::string, torch::Tensor>::Item& parameter : dict)
-				{
-					Log(Log::ERROR)<<parameter.key()<<'\n'<<parameter.value();
-				}
-			}
-			Log(Log::ERROR)<<prediction<<"\nPrediction contains NAN!\nData:\n"<<data;
-			return -1;
-		}
+	for(auto& batch : loader)
+	{
+		data = batch.data.to(*offload_device);
+		targets = (batch.target.to(*offload_device)-outputBiases)/outputScalars;
 
-		torch::Tensor predictionOrig = prediction.clone();
-		torch::Tensor base = torch::ones(prediction.sizes(), tensorOptCpu<float>().device(*offload_device))*10;
-		if(torch::isnan(torch::sum(prediction)).item().to<bool>())
-		{
-			Log(Log::ERROR)<<prediction<<"\nPrediction after scaleing contains NAN!\nData:\n"<<data;
-			return -1;
-		}
-		loss = lossFn(prediction, targets);
-		/*torch::Tensor negatives = ((torch::sign(prediction)-1)*-1)/2;
-		loss = loss + (negatives.sum()/negatives.numel());*/
+		prediction = network->forward(data);
 
-		if(torch::isnan(torch::sum(loss)).item().to<bool>())
-		{
-			Log(Log::ERROR)<<loss<<"\nloss contains NAN!";
-			Log(Log::DEBUG)<<"targets:\n"<<targets<<'\n';
-			Log(Log::DEBUG)<<"prediction:\n"<<predictionOrig<<'\n';
-			Log(Log::DEBUG)<<"prediction clamped:\n"<<predictionOrig.clamp(-12, 7)<<'\n';
-			Log(Log::DEBUG)<<"prediction pow:\n"<<prediction<<'\n';
-			Log(Log::DEBUG)<<"loss:\n"<<loss<<'\n';
-			return -1;
-		}
+		if constexpr(std::is_same_v<LossFn, EisDistanceLoss>)
+			loss = lossFn(prediction, targets, loader.indices());
+		else
+			loss = lossFn(prediction, targets);
+		guard.watch(prediction);
+		guard.watch(loss);
+		guard.recordIndices(loader.indices());
 
 		optimizer.zero_grad();
 		loss.backward();
 		optimizer.step();
 
-		lossAccumulator += loss.template item<float>();
-
-		if(log && index % loginterval == 0)
+		if(!guard.step(*network))
 		{
-			//Log(Log::INFO)<<"last targets:\n"<<targets[0];
-			//Log(Log::INFO)<<"last prediction:\n"<<prediction[0];
-			auto end = std::min(data_size, (index + 1) * batch_size);
-			log->logTrainLoss(epoch, end, loss.template item<float>(), 0, data_size);
+			reportAnomaly();
+			return -1;
 		}
 
-		prevLoss = loss;
+		metrics.add(loss, prediction.size(0));
+
+		if(log && index % loginterval == 0)
+			log->logTrainLoss(epoch, metrics.getSamples(), metrics.read().loss, 0, data_size);
 
 		index++;
 	}
 
-	if(log)
-		log->logTrainLoss(epoch, data_size, lossAccumulator/index, 0, data_size);
+	if(index > 0 && !guard.check(*network))
+	{
+		reportAnomaly();
+		return -1;
+	}
 
-	if(finalLoss)
-		*finalLoss = loss.item().toDouble();
+	if(log || finalLoss)
+	{
+		MetricAccumulator::Values values = metrics.read();
+		if(log)
+			log->logTrainLoss(epoch, data_size, values.meanLoss, 0, data_size);
+		if(finalLoss)
+			*finalLoss = values.loss;
+	}
 
 	return 0;
 }
@@ -280,6 +274,8 @@ int train(TrainLog* trainLog, std::shared_ptr<Net> net, RegressionDataset<Datase
 			<<"and will be based on "<<trainDataset->targetName();
 		torch::Tensor omega = torch::logspace(LOSS_START_DECADE, LOSS_FINISH_DECADE, LOSS_POINT_COUNT);
 		lossEis.reset(new EisDistanceLoss(trainDataset->targetName(), omega));
+		// the targets of the examples do not change between epochs, so their spectra only need to be simulated once
+		lossEis->enableTargetCache(trainDataset->size().value());
 	}
 	else
 	{
@@ -303,13 +299,13 @@ int train(TrainLog* trainLog, std::shared_ptr<Net> net, RegressionDataset<Datase
 	if(!noLabels)
 		net->setOutputLabels(outputLables);
 
-	torch::data::DataLoaderOptions options;
-	options = options.batch_size(batch_size).workers(1);
-	auto trainDataLoader = torch::data::make_data_loader<torch::data::samplers::RandomSampler>
-		(trainDataset->map(torch::data::transforms::Stack<>()), options);
-	//options.batch_size(5);
-	auto testDataLoader =
-		testDataset ? torch::data::make_data_loader(testDataset->map(torch::data::transforms::Stack<>()), options) : nullptr;
+	EisDataLoaderOptions trainLoaderOptions = EisDataLoaderOptions::fromGlobals(batch_size);
+	trainLoaderOptions.device = *offload_device;
+	trainLoaderOptions.augmentation = trainDataset->getAugmentation();
+	auto trainDataLoader = std::make_unique<EisDataLoader<DatasetType>>(trainDataset, trainLoaderOptions);
+	auto testDataLoader = testDataset ?
+		std::make_unique<EisDataLoader<TestDatasetType>>(testDataset, EisDataLoaderOptions::fromGlobals(batch_size, false)) : nullptr;
+	Log(Log::DEBUG)<<"Decoding training data with "<<trainDataLoader->workers()<<" workers";
 	torch::optim::AdamW optimizer(net->parameters(), torch::optim::AdamWOptions(learingRate).weight_decay(0.001));
 
 	for (size_t epoch = 0; epoch < epochs; ++epoch)
@@ -336,7 +332,7 @@ int train(TrainLog* trainLog, std::shared_ptr<Net> net, RegressionDataset<Datase
 
 		if(trainLog)
 			trainLog->saveNetwork(net);
-		Log(Log::INFO)<<"Epoch "<<epoch<<'/'<<epochs;
+		Log(Log::INFO)<<"Epoch "<<epoch<<'/'<<epochs<<", trainer waited "<<trainDataLoader->waitSeconds()<<"s for data";
 	}
 
 	if(trainLog)
@@ -0,0 +1,283 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <eisgenerator/model.h>
+#include <eisgenerator/log.h>
+#include <eisgenerator/translators.h>
+#include <kisstype/type.h>
+
+#include "commonoptions.h"
+#include "data/eisdataloader.h"
+#include "data/loaders/regressionloader.h"
+#include "data/loaders/regressiondirloader.h"
+#include "data/loaders/tarloader.h"
+#include "data/loaders/dirloader.h"
+#include "data/loaders/packeddataset.h"
+#include "fit/fit.h"
+#include "globals.h"
+#include "log.h"
+#include "net.h"
+#include "options.h"
+#include "randomgen.h"
+#include "indicators.hpp"
+
+template <typename DataSetType>
+int fit(const Config& config, std::shared_ptr<ann::Net> net)
+{
+	try
+	{
+		DataSetType dataset(config.fileName);
+		if(dataset.size().value() == 0)
+		{
+			Log(Log::ERROR)<<"Failed to load dataset from "<<config.fileName;
+			return 2;
+		}
+
+		c10::optional<torch::Tensor> frequencies = dataset.frequencies();
+		if(!frequencies.has_value() || frequencies->numel() == 0)
+		{
+			Log(Log::ERROR)<<"The dataset "<<config.fileName<<" does not provide the frequencies of its spectra";
+			return 2;
+		}
+		torch::Tensor omegas = frequencies->to(*offload_device, torch::kFloat32);
+		const int64_t pointCount = omegas.numel();
+
+		if(net && net->getInputSize() != static_cast<int64_t>(dataset.inputSize()))
+		{
+			Log(Log::ERROR)<<"The network was trained for an input size of "<<net->getInputSize()
+				<<" but the dataset has an input size of "<<dataset.inputSize();
+			return 2;
+		}
+
+		std::ofstream file(config.outFileName);
+		if(!file.is_open())
+		{
+			Log(Log::ERROR)<<"Could not open "<<config.outFileName<<" for writing";
+			return 2;
+		}
+
+		eis::Model model(config.model);
+		file<<"index";
+		for(size_t i = 0; i < model.getParameterCount(); ++i)
+			file<<", p"<<i;
+		file<<", residual, converged, iterations";
+		if(config.baseline)
+			file<<", iterations saved";
+		file<<'\n';
+
+		FitOptions fitOptions;
+		fitOptions.starts = config.starts.value_or(net ? 1 : 8);
+		fitOptions.maxIterations = config.iterations;
+		fitOptions.learningRate = config.learningRate;
+		fitOptions.seed = rd::getSeed();
+
+		EisDataLoaderOptions loaderOptions = EisDataLoaderOptions::fromGlobals(config.batchSize, false);
+		loaderOptions.device = *offload_device;
+		EisDataLoader<DataSetType> loader(&dataset, loaderOptions);
+
+		Log(Log::INFO)<<"Fitting "<<dataset.size().value()<<" spectra from "<<config.fileName<<" to "<<model.getModelStr()
+			<<" with "<<fitOptions.starts<<" starts per spectrum";
+
+		indicators::BlockProgressBar bar(
+			indicators::option::BarWidth(50),
+			indicators::option::PrefixText("Fitting: "),
+			indicators::option::ShowElapsedTime(true),
+			indicators::option::ShowRemainingTime(true),
+			indicators::option::MaxProgress(loader.batches())
+		);
+
+		size_t converged = 0;
+		double residualSum = 0;
+		int64_t iterationSum = 0;
+		int64_t savedSum = 0;
+		for(auto& batch : loader)
+		{
+			torch::Tensor spectra = torch::complex(batch.data.narrow(1, 0, pointCount), batch.data.narrow(1, pointCount, pointCount));
+			FitResult result = net ? eisFitBatch(batch.data, omegas, net, fitOptions, loader.indices()) :
+				eisFitBatch(spectra, omegas, config.model, fitOptions, torch::Tensor(), loader.indices());
+
+			torch::Tensor saved;
+			if(config.baseline)
+			{
+				FitResult baseline = eisFitBatch(spectra, omegas, config.model, fitOptions, torch::Tensor(), loader.indices());
+				saved = (baseline.iterations - result.iterations).cpu().contiguous();
+			}
+
+			torch::Tensor parameters = result.parameters.to(torch::kCPU, torch::kFloat64).contiguous();
+			torch::Tensor residuals = result.residuals.to(torch::kCPU, torch::kFloat64).contiguous();
+			torch::Tensor batchConverged = result.converged.to(torch::kCPU).contiguous();
+			torch::Tensor iterations = result.iterations.to(torch::kCPU).contiguous();
+			auto parameterAccessor = parameters.accessor<double, 2>();
+			auto residualAccessor = residuals.accessor<double, 1>();
+			auto convergedAccessor = batchConverged.accessor<bool, 1>();
+			auto iterationAccessor = iterations.accessor<int64_t, 1>();
+
+			// the rows of a batch are formatted first so that the file is written in one call per batch
+			std::stringstream rows;
+			rows.precision(std::numeric_limits<double>::max_digits10);
+			for(int64_t row = 0; row < parameters.size(0); ++row)
+			{
+				rows<<loader.indices()[row];
+				for(int64_t i = 0; i < parameters.size(1); ++i)
+					rows<<", "<<parameterAccessor[row][i];
+				rows<<", "<<residualAccessor[row]<<", "<<convergedAccessor[row]<<", "<<iterationAccessor[row];
+				if(saved.defined())
+				{
+					rows<<", "<<saved.data_ptr<int64_t>()[row];
+					savedSum += saved.data_ptr<int64_t>()[row];
+				}
+				rows<<'\n';
+				residualSum += residualAccessor[row];
+				converged += convergedAccessor[row];
+				iterationSum += iterationAccessor[row];
+			}
+			file<<rows.rdbuf();
+			bar.tick();
+		}
+		bar.mark_as_completed();
+
+		if(!file.good())
+		{
+			Log(Log::ERROR)<<"Failed to write "<<config.outFileName;
+			return 1;
+		}
+
+		Log(Log::INFO)<<converged<<" of "<<dataset.size().value()<<" fits converged, mean residual: "
+			<<residualSum/dataset.size().value()<<", mean iterations: "<<static_cast<double>(iterationSum)/dataset.size().value();
+		if(config.baseline)
+			Log(Log::INFO)<<"Starting from the network saved "<<static_cast<double>(savedSum)/dataset.size().value()<<" iterations per spectrum on average";
+	}
+	catch(const dataset_error& err)
+	{
+		Log(Log::ERROR)<<err.what();
+		return 2;
+	}
+	catch(const std::invalid_argument& err)
+	{
+		Log(Log::ERROR)<<err.what();
+		return 2;
+	}
+	return 0;
+}
+
+static bool sameTopology(std::string a, std::string b)
+{
+	eis::purgeEisParamBrackets(a);
+	eis::purgeEisParamBrackets(b);
+	return a == b;
+}
+
+int main(int argc, char** argv)
+{
+	Log::level = Log::INFO;
+	eis::Log::level = eis::Log::ERROR;
+
+	Config config;
+	argp_parse(&argp, argc, argv, 0, 0, &config);
+
+	if(config.datasetMode == DATASET_INVALID)
+	{
+		Log(Log::ERROR)<<"You must specify what dataset to use: -d " DATASET_LIST;
+		return -1;
+	}
+
+	if(config.fileName.empty() || config.outFileName.empty() || (config.model.empty() && config.networkFileName.empty()))
+	{
+		Log(Log::ERROR)<<"You must specify a dataset to fit via -f, a model via -m or a network via -n and a output file via -o";
+		return 2;
+	}
+
+	if(config.baseline && config.networkFileName.empty())
+	{
+		Log(Log::ERROR)<<"A baseline can only be fitted in addition to a network";
+		return 2;
+	}
+
+	choose_device(config.noGpu);
+
+	std::shared_ptr<ann::Net> net;
+	if(!config.networkFileName.empty())
+	{
+		net = ann::Net::newNetFromCheckpointDir(config.networkFileName);
+		if(!net)
+		{
+			Log(Log::ERROR)<<"Could not load network from "<<config.networkFileName;
+			return 2;
+		}
+
+		std::string networkModel = regressionModelString(*net);
+		if(networkModel.empty())
+		{
+			Log(Log::ERROR)<<"The loaded network does not report to be a regression network, its purpose is "<<net->getPurpose();
+			return 2;
+		}
+		if(config.model.empty())
+			config.model = networkModel;
+		else if(!sameTopology(config.model, networkModel))
+		{
+			Log(Log::ERROR)<<"The network was trained for "<<networkModel<<" not "<<config.model;
+			return 2;
+		}
+
+		net->to(*offload_device);
+		net->eval();
+		Log(Log::INFO)<<"Starting fits from the estimates of "<<config.networkFileName;
+	}
+	data_workers = config.workers;
+	if(config.seed)
+		rd::seed(*config.seed);
+	else
+		rd::init();
+	Log(Log::INFO)<<"Using seed "<<rd::getSeed();
+
+	int ret;
+	switch(config.datasetMode)
+	{
+		case DATASET_DIR:
+			ret = fit<EisDirDataset>(config, net);
+			break;
+		case DATASET_TAR:
+			ret = fit<EisTarDataset>(config, net);
+			break;
+		case DATASET_DIR_REGRESSION:
+			ret = fit<RegressionLoaderDir>(config, net);
+			break;
+		case DATASET_TAR_REGRESSION:
+			ret = fit<RegressionLoaderTar>(config, net);
+			break;
+		case DATASET_PACKED:
+			ret = fit<EisPackedDataset>(config, net);
+			break;
+		default:
+			Log(Log::ERROR)<<"Dataset not implemented";
+			ret = 1;
+			break;
+	}
+
+	free_device();
+	return ret;
+}
@@ -0,0 +1,143 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <string>
+#include <argp.h>
+#include <iostream>
+#include <filesystem>
+#include <optional>
+#include <cstdint>
+#include "utils/log.h"
+#include "commonoptions.h"
+
+const inline char *argp_program_version = "TorchKissAnnFit";
+const inline char *argp_program_bug_address = "<carl@uvos.xyz>";
+static char doc[] = "Application that fits the spectra of a dataset to a circuit model in batches";
+static char args_doc[] = "";
+
+static struct argp_option options[] =
+{
+  {"verbose",		'v', 0,				0,	"Show debug messages" },
+  {"quiet", 		'q', 0,				0,	"only output data" },
+  {"dataset", 		'd', "[STRING]",	0,	"dataset to fit: " DATASET_LIST},
+  {"file", 			'f', "[STRING]",	0,	"filename for dataset"},
+  {"model",			'm', "[STRING]",	0,	"model to fit the spectra to, default: the model of the network"},
+  {"network",		'n', "[PATH]",		0,	"regression network whose estimates are used as the starting points of the fit"},
+  {"baseline",		'a', 0,				0,	"also fit from the centers of the parameter ranges and report the iterations the network saved"},
+  {"out",			'o', "[FILENAME]",	0,	"filename of the csv file to write the fitted parameters and residuals to"},
+  {"batch-size",	'b', "[NUMBER]",	0,	"number of spectra fitted at once, default: 1024"},
+  {"starts",		's', "[NUMBER]",	0,	"number of starting points per spectrum, default: 8 or 1 with a network"},
+  {"iterations",	'i', "[NUMBER]",	0,	"maximum number of optimizer iterations per batch, default: 2000"},
+  {"learing-rate",	'r', "[NUMBER]",	0,	"adam lering rate, default: 0.05"},
+  {"cpu",			'c', 0,				0,	"don't use gpu even if one is available"},
+  {"workers",		'w', "[NUMBER]",	0, 	"number of threads decoding the dataset, default: number of cpu threads"},
+  {"seed",			'e', "[NUMBER]",	0, 	"seed for the random starts, default: a random seed"},
+  { 0 }
+};
+
+struct Config
+{
+	DatasetMode datasetMode = DATASET_INVALID;
+	std::filesystem::path fileName;
+	std::filesystem::path outFileName;
+	std::string model;
+	std::filesystem::path networkFileName;
+	bool baseline = false;
+	size_t batchSize = 1024;
+	std::optional<size_t> starts;
+	size_t iterations = 2000;
+	double learningRate = 0.05;
+	bool noGpu = false;
+	size_t workers = 0;
+	std::optional<uint64_t> seed;
+};
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state)
+{
+	Config *config = reinterpret_cast<Config*>(state->input);
+
+	try
+	{
+		switch (key)
+		{
+		case 'q':
+			Log::level = Log::ERROR;
+			break;
+		case 'v':
+			Log::level = Log::DEBUG;
+			break;
+		case 'd':
+			config->datasetMode = parseDatasetMode(arg);
+			if(config->datasetMode == DATASET_INVALID)
+			{
+				Log(Log::ERROR)<<"dataset has to be one of: " DATASET_LIST;
+				argp_usage(state);
+			}
+			break;
+		case 'f':
+			config->fileName.assign(arg);
+			break;
+		case 'm':
+			config->model.assign(arg);
+			break;
+		case 'o':
+			config->outFileName.assign(arg);
+			break;
+		case 'n':
+			config->networkFileName.assign(arg);
+			break;
+		case 'a':
+			config->baseline = true;
+			break;
+		case 'b':
+			config->batchSize = std::stoul(std::string(arg));
+			break;
+		case 's':
+			config->starts = std::stoul(std::string(arg));
+			break;
+		case 'i':
+			config->iterations = std::stoul(std::string(arg));
+			break;
+		case 'r':
+			config->learningRate = std::stod(std::string(arg));
+			break;
+		case 'c':
+			config->noGpu = true;
+			break;
+		case 'w':
+			config->workers = std::stoul(std::string(arg));
+			break;
+		case 'e':
+			config->seed = std::stoull(std::string(arg));
+			break;
+		default:
+			return ARGP_ERR_UNKNOWN;
+		}
+	}
+	catch(const std::invalid_argument& ex)
+	{
+		std::cout<<arg<<" passed for argument -"<<static_cast<char>(key)<<" is not a valid number.\n";
+		return ARGP_KEY_ERROR;
+	}
+	return 0;
+}
+
+static struct argp argp = {options, parse_opt, args_doc, doc};
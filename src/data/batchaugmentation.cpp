@@ -0,0 +1,240 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "batchaugmentation.h"
+
+#include <cassert>
+#include <cmath>
+
+#include "tensoroptions.h"
+#include "randomgen.h"
+
+bool AugmentationOptions::empty() const
+{
+	bool anyDropout = false;
+	for(const DropDesc& desc : dropouts)
+		anyDropout = anyDropout || desc.dropout;
+	return !anyDropout && replaceProbability <= 0 && noise <= 0 && frequencyJitter <= 0;
+}
+
+bool AugmentationOptions::needsStats() const
+{
+	return replaceProbability > 0 || noise > 0;
+}
+
+BatchAugmentation::BatchAugmentation(const AugmentationOptions& optionsIn, size_t columnsIn, size_t pointCountIn, const DatasetStats* stats,
+	uint64_t seedIn):
+options(optionsIn), columns(columnsIn), pointCount(pointCountIn), seed(seedIn)
+{
+	if(pointCount*2 > columns)
+		pointCount = 0;
+
+	if(!options.dropouts.empty())
+	{
+		assert(options.dropouts.size() == columns);
+		std::vector<float> mask(columns);
+		std::vector<float> min(columns);
+		std::vector<float> range(columns);
+		std::vector<float> strength(columns);
+		for(size_t i = 0; i < columns; ++i)
+		{
+			const DropDesc& desc = options.dropouts[i];
+			mask[i] = desc.dropout;
+			min[i] = desc.min;
+			range[i] = desc.max - desc.min;
+			strength[i] = desc.dropout ? desc.strength : 0;
+			hasDropouts = hasDropouts || desc.dropout;
+		}
+		cpuParameters.dropMask = torch::tensor(mask, tensorOptCpu<float>()).to(torch::kBool);
+		cpuParameters.dropMin = torch::tensor(min, tensorOptCpu<float>());
+		cpuParameters.dropRange = torch::tensor(range, tensorOptCpu<float>());
+		cpuParameters.dropStrength = torch::tensor(strength, tensorOptCpu<float>());
+	}
+
+	if(options.needsStats())
+	{
+		assert(stats && stats->inputs.columns() == columns);
+		std::vector<double> variance = stats->inputs.variance();
+		std::vector<float> min(columns);
+		std::vector<float> range(columns);
+		std::vector<float> std(columns);
+		for(size_t i = 0; i < columns; ++i)
+		{
+			min[i] = stats->inputs.min[i];
+			range[i] = stats->inputs.max[i] - stats->inputs.min[i];
+			std[i] = std::sqrt(variance[i]);
+		}
+		cpuParameters.columnMin = torch::tensor(min, tensorOptCpu<float>());
+		cpuParameters.columnRange = torch::tensor(range, tensorOptCpu<float>());
+		cpuParameters.columnStd = torch::tensor(std, tensorOptCpu<float>());
+	}
+}
+
+const BatchAugmentation::Parameters& BatchAugmentation::parametersFor(const torch::Device& device) const
+{
+	if(device.is_cpu())
+		return cpuParameters;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto search = deviceParameters.find(device.str());
+	if(search != deviceParameters.end())
+		return search->second;
+
+	auto toDevice = [&device](const torch::Tensor& tensor)
+	{
+		return tensor.defined() ? tensor.to(device) : tensor;
+	};
+
+	Parameters parameters;
+	parameters.dropMask = toDevice(cpuParameters.dropMask);
+	parameters.dropMin = toDevice(cpuParameters.dropMin);
+	parameters.dropRange = toDevice(cpuParameters.dropRange);
+	parameters.dropStrength = toDevice(cpuParameters.dropStrength);
+	parameters.columnMin = toDevice(cpuParameters.columnMin);
+	parameters.columnRange = toDevice(cpuParameters.columnRange);
+	parameters.columnStd = toDevice(cpuParameters.columnStd);
+	return deviceParameters.emplace(device.str(), std::move(parameters)).first->second;
+}
+
+bool BatchAugmentation::jitterEnabled() const
+{
+	return options.frequencyJitter > 0 && pointCount > 1;
+}
+
+size_t BatchAugmentation::randomWidth() const
+{
+	size_t width = jitterEnabled() ? 1 : 0;
+	if(hasDropouts)
+		width += columns;
+	if(options.replaceProbability > 0)
+		width += columns*2;
+	if(options.noise > 0)
+		width += columns;
+	return width;
+}
+
+torch::Tensor BatchAugmentation::draw(c10::ArrayRef<size_t> indices, uint64_t epoch) const
+{
+	const size_t width = randomWidth();
+	torch::Tensor random = torch::empty({static_cast<int64_t>(indices.size()), static_cast<int64_t>(width)}, tensorOptCpu<float>());
+	float* randomPtr = random.data_ptr<float>();
+	rd::Philox generator(seed, epoch);
+
+	for(size_t row = 0; row < indices.size(); ++row)
+	{
+		float* out = randomPtr + row*width;
+		const uint64_t index = indices[row];
+		// the streams start at fixed block positions, so enabling one augmentation does not change the values of another
+		if(jitterEnabled())
+		{
+			generator.uniform(out, 1, index, STREAM_JITTER << 32);
+			out += 1;
+		}
+		if(hasDropouts)
+		{
+			generator.uniform(out, columns, index, STREAM_DROPOUT << 32);
+			out += columns;
+		}
+		if(options.replaceProbability > 0)
+		{
+			generator.uniform(out, columns, index, STREAM_REPLACE_MASK << 32);
+			generator.uniform(out + columns, columns, index, STREAM_REPLACE_VALUE << 32);
+			out += columns*2;
+		}
+		if(options.noise > 0)
+			generator.normal(out, columns, index, STREAM_NOISE << 32);
+	}
+
+	return random;
+}
+
+void BatchAugmentation::jitter(torch::Tensor& inputs, const torch::Tensor& random) const
+{
+	const int64_t points = pointCount;
+	torch::TensorOptions tensorOptions = inputs.options();
+
+	torch::Tensor shift = (random*2 - 1)*options.frequencyJitter;
+	torch::Tensor position = (torch::arange(points, tensorOptions).unsqueeze(0) + shift).clamp(0, points - 1);
+	torch::Tensor lower = position.floor();
+	torch::Tensor fraction = position - lower;
+	torch::Tensor lowerIndex = lower.to(torch::kInt64);
+	torch::Tensor upperIndex = (lowerIndex + 1).clamp_max(points - 1);
+
+	for(int64_t offset : {int64_t(0), points})
+	{
+		torch::Tensor part = inputs.narrow(1, offset, points);
+		torch::Tensor shifted = torch::lerp(part.gather(1, lowerIndex), part.gather(1, upperIndex), fraction);
+		part.copy_(shifted);
+	}
+}
+
+void BatchAugmentation::apply(torch::Tensor& inputs, const torch::Tensor& randomIn) const
+{
+	assert(inputs.dim() == 2);
+	assert(randomIn.size(0) == inputs.size(0) && randomIn.size(1) == static_cast<int64_t>(randomWidth()));
+	torch::NoGradGuard noGrad;
+	const Parameters& parameters = parametersFor(inputs.device());
+	const torch::Tensor random = randomIn.to(inputs.device(), inputs.scalar_type());
+	const int64_t width = columns;
+	int64_t offset = 0;
+
+	if(jitterEnabled())
+	{
+		jitter(inputs, random.narrow(1, offset, 1));
+		offset += 1;
+	}
+
+	if(hasDropouts)
+	{
+		torch::Tensor value = random.narrow(1, offset, width)*parameters.dropRange + parameters.dropMin;
+		torch::Tensor blended = torch::lerp(inputs, value, parameters.dropStrength.expand_as(inputs));
+		inputs = torch::where(parameters.dropMask, blended, inputs);
+		offset += width;
+	}
+
+	if(options.replaceProbability > 0)
+	{
+		torch::Tensor replace = random.narrow(1, offset, width) < options.replaceProbability;
+		torch::Tensor value = random.narrow(1, offset + width, width)*parameters.columnRange + parameters.columnMin;
+		inputs = torch::where(replace, value, inputs);
+		offset += width*2;
+	}
+
+	if(options.noise > 0)
+		inputs.add_(random.narrow(1, offset, width)*(parameters.columnStd*options.noise));
+}
+
+void BatchAugmentation::apply(torch::Tensor& inputs, c10::ArrayRef<size_t> indices, uint64_t epoch) const
+{
+	apply(inputs, draw(indices, epoch));
+}
+
+void BatchAugmentation::apply(torch::Tensor& inputs) const
+{
+	std::vector<size_t> rows(inputs.size(0));
+	for(size_t i = 0; i < rows.size(); ++i)
+		rows[i] = i;
+	apply(inputs, draw(rows, rd::uid()));
+}
+
+const AugmentationOptions& BatchAugmentation::getOptions() const
+{
+	return options;
+}
@@ -0,0 +1,139 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <torch/torch.h>
+#include <vector>
+
+#include "data/datasetstats.h"
+#include "randomgen.h"
+
+struct DropDesc
+{
+	bool dropout;
+	float max;
+	float min;
+	float strength;
+};
+
+struct AugmentationOptions
+{
+	// per input column, blends the value with a uniform random value in [min, max]
+	std::vector<DropDesc> dropouts;
+	// probability of replacing a input value with a uniform random value from the range of its column
+	float replaceProbability = 0;
+	// standard deviation of additive gaussian noise, relative to the standard deviation of each column
+	float noise = 0;
+	// largest shift of the spectra along the frequency axis, in frequency points
+	float frequencyJitter = 0;
+
+	bool empty() const;
+	bool needsStats() const;
+};
+
+/**
+ * @brief Augments whole batches of inputs with tensor operations on the device the batch is on.
+ *
+ * The inputs are expected in the layout the loaders produce: the real parts of all points,
+ * then the imaginary parts, followed by any extra inputs. The frequency jitter shifts each spectrum
+ * by a random fraction of points and linearly interpolates between the neighbouring points.
+ * All per column parameters are copied to a device the first time a batch on it is augmented.
+ *
+ * The random values are drawn on the cpu by draw with a counter based generator keyed by the seed,
+ * the epoch and the sample index of each row, so a sample is augmented the same way no matter
+ * which worker loaded it or which batch it ended up in. Nothing is shared between calls, so any number
+ * of threads may draw and apply concurrently.
+ */
+class BatchAugmentation
+{
+private:
+	struct Parameters
+	{
+		torch::Tensor dropMask;
+		torch::Tensor dropMin;
+		torch::Tensor dropRange;
+		torch::Tensor dropStrength;
+		torch::Tensor columnMin;
+		torch::Tensor columnRange;
+		torch::Tensor columnStd;
+	};
+
+	// every kind of random value has its own part of the stream of a sample
+	enum Stream : uint64_t
+	{
+		STREAM_JITTER = 0,
+		STREAM_DROPOUT,
+		STREAM_REPLACE_MASK,
+		STREAM_REPLACE_VALUE,
+		STREAM_NOISE,
+	};
+
+	AugmentationOptions options;
+	size_t columns;
+	size_t pointCount;
+	bool hasDropouts = false;
+	uint64_t seed;
+	Parameters cpuParameters;
+	mutable std::map<std::string, Parameters> deviceParameters;
+	mutable std::mutex mutex;
+
+	const Parameters& parametersFor(const torch::Device& device) const;
+	bool jitterEnabled() const;
+	void jitter(torch::Tensor& inputs, const torch::Tensor& random) const;
+
+public:
+	/**
+	 * @brief Prepares the augmentation of batches with columns input columns
+	 * @param pointCount the number of points in each spectrum, the frequency jitter is skipped if this is 0
+	 * @param stats statistics of the dataset, only required if options.needsStats() is true
+	 * @param seed key of the random values, together with the epoch and the sample index
+	 */
+	BatchAugmentation(const AugmentationOptions& options, size_t columns, size_t pointCount, const DatasetStats* stats = nullptr,
+		uint64_t seed = rd::getSeed());
+
+	/**
+	 * @brief Number of random values draw produces per row
+	 */
+	size_t randomWidth() const;
+
+	/**
+	 * @brief Draws the random values for a batch of the samples at indices as a [batch, randomWidth()] cpu tensor
+	 */
+	torch::Tensor draw(c10::ArrayRef<size_t> indices, uint64_t epoch) const;
+
+	/**
+	 * @brief Augments the batch of inputs of shape [batch, columns] on the device it is on, inputs may be replaced by a new tensor
+	 * @param random the values returned by draw for the samples of this batch, on any device
+	 */
+	void apply(torch::Tensor& inputs, const torch::Tensor& random) const;
+
+	void apply(torch::Tensor& inputs, c10::ArrayRef<size_t> indices, uint64_t epoch) const;
+
+	/**
+	 * @brief Augments inputs with random values from a freshly chosen stream, not reproducible
+	 */
+	void apply(torch::Tensor& inputs) const;
+
+	const AugmentationOptions& getOptions() const;
+};
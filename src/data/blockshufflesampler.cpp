@@ -0,0 +1,63 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "blockshufflesampler.h"
+
+#include <algorithm>
+#include <numeric>
+
+BlockShuffleSampler::BlockShuffleSampler(size_t blockSizeI, size_t bufferSizeI):
+blockSize(std::max<size_t>(blockSizeI, 1)), bufferSize(std::max<size_t>(bufferSizeI, 1))
+{
+}
+
+void BlockShuffleSampler::shuffle(std::vector<size_t>& order, std::mt19937_64& engine) const
+{
+	const size_t count = order.size();
+	if(count == 0)
+		return;
+
+	std::vector<size_t> blocks((count + blockSize - 1)/blockSize);
+	std::iota(blocks.begin(), blocks.end(), 0);
+	std::shuffle(blocks.begin(), blocks.end(), engine);
+
+	std::vector<size_t> buffer;
+	buffer.reserve(std::min(bufferSize, count));
+	size_t out = 0;
+	for(size_t block : blocks)
+	{
+		size_t end = std::min(count, (block + 1)*blockSize);
+		for(size_t index = block*blockSize; index < end; ++index)
+		{
+			if(buffer.size() < bufferSize)
+			{
+				buffer.push_back(index);
+				continue;
+			}
+			size_t slot = std::uniform_int_distribution<size_t>(0, buffer.size() - 1)(engine);
+			order[out++] = buffer[slot];
+			buffer[slot] = index;
+		}
+	}
+
+	std::shuffle(buffer.begin(), buffer.end(), engine);
+	for(size_t index : buffer)
+		order[out++] = index;
+}
@@ -0,0 +1,47 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstddef>
+#include <random>
+#include <vector>
+
+/**
+ * @brief Produces an epoch ordering that keeps reads close to sequential.
+ *
+ * The indices are divided into contiguous blocks of blockSize which are visited in random order.
+ * The resulting stream is then passed through a shuffle buffer of bufferSize entries, every output
+ * is drawn at random from the buffer and replaced by the next index of the stream.
+ * Consecutive reads thus stay within a window of about bufferSize/blockSize blocks.
+ */
+class BlockShuffleSampler
+{
+private:
+	size_t blockSize;
+	size_t bufferSize;
+
+public:
+	BlockShuffleSampler(size_t blockSize, size_t bufferSize);
+
+	/**
+	 * @brief Fills order with a new permutation of the indices [0, order.size())
+	 */
+	void shuffle(std::vector<size_t>& order, std::mt19937_64& engine) const;
+};
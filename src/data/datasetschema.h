@@ -0,0 +1,41 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <torch/torch.h>
+
+/**
+ * @brief Properties shared by all examples of a dataset, determined once when first needed.
+ */
+struct DatasetSchema
+{
+	size_t inputSize = 0;
+	size_t targetSize = 0;
+	torch::ScalarType targetType = torch::kFloat32;
+	c10::optional<torch::Tensor> frequencies;
+	std::vector<std::string> labelNames;
+	std::vector<std::pair<std::string, int64_t>> extraInputs;
+	std::string targetModel;
+};
@@ -0,0 +1,82 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "datasetstats.h"
+
+#include <cassert>
+
+ColumnStats::ColumnStats(size_t columns):
+min(columns, std::numeric_limits<double>::max()),
+max(columns, std::numeric_limits<double>::lowest()),
+mean(columns, 0),
+m2(columns, 0)
+{
+}
+
+size_t ColumnStats::columns() const
+{
+	return mean.size();
+}
+
+void ColumnStats::merge(const ColumnStats& other)
+{
+	assert(other.columns() == columns());
+	if(other.count == 0)
+		return;
+	if(count == 0)
+	{
+		*this = other;
+		return;
+	}
+
+	double total = static_cast<double>(count + other.count);
+	double otherShare = other.count/total;
+	for(size_t column = 0; column < columns(); ++column)
+	{
+		double delta = other.mean[column] - mean[column];
+		mean[column] += delta*otherShare;
+		m2[column] += other.m2[column] + delta*delta*count*otherShare;
+		min[column] = std::min(min[column], other.min[column]);
+		max[column] = std::max(max[column], other.max[column]);
+	}
+	count += other.count;
+}
+
+std::vector<double> ColumnStats::variance() const
+{
+	std::vector<double> out(columns(), 0);
+	if(count > 1)
+	{
+		for(size_t column = 0; column < columns(); ++column)
+			out[column] = m2[column]/(count - 1);
+	}
+	return out;
+}
+
+DatasetStats::DatasetStats(size_t inputColumns, size_t targetColumns):
+inputs(inputColumns), targets(targetColumns)
+{
+}
+
+void DatasetStats::merge(const DatasetStats& other)
+{
+	inputs.merge(other.inputs);
+	targets.merge(other.targets);
+}
@@ -0,0 +1,101 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/**
+ * @brief Per column count, min, max, mean and variance of a table of values.
+ *
+ * Values are added in blocks of rows, whose statistics are computed in two passes over the block
+ * and then merged into the running totals with the pairwise update of Chan et al., so blocks computed
+ * by different threads can be merged in any order.
+ */
+struct ColumnStats
+{
+	uint64_t count = 0;
+	std::vector<double> min;
+	std::vector<double> max;
+	std::vector<double> mean;
+	std::vector<double> m2; // sum of squared deviations from the mean
+
+	explicit ColumnStats(size_t columns = 0);
+
+	size_t columns() const;
+
+	/**
+	 * @brief Adds rows rows of columns() values each, stored row major
+	 */
+	template <typename T>
+	void add(const T* data, size_t rows);
+
+	void merge(const ColumnStats& other);
+	std::vector<double> variance() const;
+};
+
+struct DatasetStats
+{
+	ColumnStats inputs;
+	ColumnStats targets;
+
+	DatasetStats() = default;
+	DatasetStats(size_t inputColumns, size_t targetColumns);
+	void merge(const DatasetStats& other);
+};
+
+template <typename T>
+void ColumnStats::add(const T* data, size_t rows)
+{
+	if(rows == 0)
+		return;
+
+	ColumnStats block(columns());
+	block.count = rows;
+	for(size_t row = 0; row < rows; ++row)
+	{
+		const T* rowData = data + row*columns();
+		for(size_t column = 0; column < columns(); ++column)
+		{
+			double value = static_cast<double>(rowData[column]);
+			block.min[column] = std::min(block.min[column], value);
+			block.max[column] = std::max(block.max[column], value);
+			block.mean[column] += value;
+		}
+	}
+
+	for(double& mean : block.mean)
+		mean /= rows;
+
+	for(size_t row = 0; row < rows; ++row)
+	{
+		const T* rowData = data + row*columns();
+		for(size_t column = 0; column < columns(); ++column)
+		{
+			double deviation = static_cast<double>(rowData[column]) - block.mean[column];
+			block.m2[column] += deviation*deviation;
+		}
+	}
+
+	merge(block);
+}
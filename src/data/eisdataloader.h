@@ -0,0 +1,415 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "data/eisdataset.h"
+#include "data/blockshufflesampler.h"
+#include "boundedqueue.h"
+#include "randomgen.h"
+#include "globals.h"
+
+struct EisDataLoaderOptions
+{
+	size_t batchSize = 256;
+	// 0 uses one worker per hardware thread
+	size_t workers = 0;
+	// number of decoded batches that may wait for the trainer
+	size_t prefetch = 8;
+	bool shuffle = true;
+	// when not 0 shuffle with a BlockShuffleSampler using blocks of this many examples
+	size_t shuffleBlock = 0;
+	size_t shuffleBuffer = 0;
+	// when set, batches are moved to this device by the consumer before they are yielded
+	c10::optional<torch::Device> device;
+	// when set, applied to the inputs of every batch after it was moved to the device
+	std::shared_ptr<const BatchAugmentation> augmentation;
+	// together with the epoch determines the order of the examples
+	uint64_t seed = 0;
+
+	static EisDataLoaderOptions fromGlobals(size_t batchSize, bool shuffle = true)
+	{
+		EisDataLoaderOptions options;
+		options.batchSize = batchSize;
+		options.workers = data_workers;
+		options.prefetch = prefetch_depth;
+		options.shuffle = shuffle;
+		options.shuffleBlock = shuffle_block;
+		options.shuffleBuffer = shuffle_buffer;
+		options.seed = rd::getSeed();
+		return options;
+	}
+};
+
+/**
+ * @brief Multi threaded loader that assembles batches from a EisDataset via EisDataset::getBatch.
+ *
+ * The batches of an epoch are split into contiguous ranges, one per worker. A worker that runs out
+ * of batches steals half of the remaining range of another worker, so slow examples on one thread
+ * do not stall the epoch. Finished batches are handed to the trainer through a bounded lock free queue
+ * whose size limits how far the workers run ahead. Batches are yielded in the order they
+ * are finished, not in the order of the sampled indices.
+ * Augmentation is applied to whole batches in the consumer thread, after the batch was moved to the
+ * device, so that it runs on the same device as the model. The random values it uses are drawn by the
+ * workers, keyed by epoch and sample index, so the shuffle order and the augmentation of every example
+ * only depend on the seed and the epoch, not on the number of workers or the order batches finish in.
+ *
+ * Iterating the loader starts a new epoch, only one iteration may be active at a time.
+ */
+template <typename DataSelf>
+class EisDataLoader
+{
+public:
+	typedef torch::data::Example<torch::Tensor, torch::Tensor> Batch;
+
+	class Iterator
+	{
+	private:
+		EisDataLoader* loader;
+
+	public:
+		explicit Iterator(EisDataLoader* loaderIn = nullptr): loader(loaderIn)
+		{}
+
+		Batch& operator*()
+		{
+			return loader->current;
+		}
+
+		Batch* operator->()
+		{
+			return &loader->current;
+		}
+
+		Iterator& operator++()
+		{
+			if(!loader->next())
+				loader = nullptr;
+			return *this;
+		}
+
+		bool operator!=(const Iterator& other) const
+		{
+			return loader != other.loader;
+		}
+
+		bool operator==(const Iterator& other) const
+		{
+			return loader == other.loader;
+		}
+	};
+
+private:
+	struct Pending
+	{
+		Batch batch;
+		torch::Tensor random;
+		std::vector<size_t> indices;
+	};
+
+	// begin and end batch number of a workers remaining range packed into one word, so that it can be stolen with a single CAS
+	struct alignas(64) WorkRange
+	{
+		std::atomic<uint64_t> range{0};
+	};
+
+	EisDataset<DataSelf>* dataset;
+	EisDataLoaderOptions options;
+	std::vector<size_t> order;
+	size_t batchCount = 0;
+	size_t delivered = 0;
+	std::unique_ptr<WorkRange[]> ranges;
+	BoundedQueue<Pending> queue;
+	std::vector<std::thread> threads;
+	std::atomic<bool> stopRequested{false};
+	std::atomic<bool> failed{false};
+	std::exception_ptr error;
+	std::mutex errorMutex;
+	Batch current;
+	std::vector<size_t> currentIndices;
+	Pending pending;
+	uint64_t epoch = 0;
+	std::chrono::steady_clock::duration waited{0};
+	std::mt19937_64 shuffleEngine;
+
+	static uint64_t packRange(uint64_t begin, uint64_t end)
+	{
+		return begin << 32 | end;
+	}
+
+	static void backoff(unsigned& spins)
+	{
+		if(spins < 64)
+		{
+			++spins;
+			std::this_thread::yield();
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	}
+
+	bool takeOwn(size_t worker, size_t& batch)
+	{
+		std::atomic<uint64_t>& range = ranges[worker].range;
+		uint64_t value = range.load(std::memory_order_acquire);
+		while(true)
+		{
+			uint64_t begin = value >> 32;
+			uint64_t end = value & 0xffffffff;
+			if(begin >= end)
+				return false;
+			if(range.compare_exchange_weak(value, packRange(begin + 1, end), std::memory_order_acq_rel))
+			{
+				batch = begin;
+				return true;
+			}
+		}
+	}
+
+	bool steal(size_t worker)
+	{
+		for(size_t i = 1; i < options.workers; ++i)
+		{
+			std::atomic<uint64_t>& victim = ranges[(worker + i) % options.workers].range;
+			uint64_t value = victim.load(std::memory_order_acquire);
+			while(true)
+			{
+				uint64_t begin = value >> 32;
+				uint64_t end = value & 0xffffffff;
+				if(begin >= end)
+					break;
+				uint64_t split = end - (end - begin + 1)/2;
+				if(victim.compare_exchange_weak(value, packRange(begin, split), std::memory_order_acq_rel))
+				{
+					// our own range is empty so no other thread can change it concurrently
+					ranges[worker].range.store(packRange(split, end), std::memory_order_release);
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	void work(size_t worker)
+	{
+		try
+		{
+			std::vector<size_t> indices;
+			size_t batch;
+			while(!stopRequested.load(std::memory_order_relaxed))
+			{
+				if(!takeOwn(worker, batch))
+				{
+					if(!steal(worker))
+						return;
+					continue;
+				}
+
+				size_t begin = batch*options.batchSize;
+				size_t count = std::min(options.batchSize, order.size() - begin);
+				// reading the examples of a batch in ascending order keeps the access pattern forward only
+				indices.assign(order.begin() + begin, order.begin() + begin + count);
+				std::sort(indices.begin(), indices.end());
+				Pending example;
+				example.batch = dataset->getBatch(indices);
+				if(options.augmentation)
+					example.random = options.augmentation->draw(indices, epoch);
+				example.indices = indices;
+
+				unsigned spins = 0;
+				while(!queue.tryPush(example))
+				{
+					if(stopRequested.load(std::memory_order_relaxed))
+						return;
+					backoff(spins);
+				}
+			}
+		}
+		catch(...)
+		{
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if(!error)
+				error = std::current_exception();
+			failed.store(true, std::memory_order_release);
+		}
+	}
+
+	void startEpoch()
+	{
+		stopEpoch();
+		++epoch;
+
+		std::array<uint32_t, 4> shuffleKey = rd::Philox(options.seed, epoch).block(UINT64_MAX, 0);
+		std::seed_seq shuffleSeed(shuffleKey.begin(), shuffleKey.end());
+		shuffleEngine.seed(shuffleSeed);
+		if(options.shuffle && options.shuffleBlock > 0)
+			BlockShuffleSampler(options.shuffleBlock, options.shuffleBuffer).shuffle(order, shuffleEngine);
+		else if(options.shuffle)
+			std::shuffle(order.begin(), order.end(), shuffleEngine);
+
+		const size_t workers = options.workers;
+		for(size_t i = 0; i < workers; ++i)
+			ranges[i].range.store(packRange(batchCount*i/workers, batchCount*(i+1)/workers), std::memory_order_relaxed);
+
+		delivered = 0;
+		waited = std::chrono::steady_clock::duration::zero();
+		stopRequested.store(false);
+		failed.store(false);
+		error = nullptr;
+		for(size_t i = 0; i < workers; ++i)
+			threads.emplace_back(&EisDataLoader::work, this, i);
+	}
+
+	void stopEpoch()
+	{
+		stopRequested.store(true);
+		for(std::thread& thread : threads)
+			thread.join();
+		threads.clear();
+
+		Pending discard;
+		while(queue.tryPop(discard));
+		current = Batch();
+		currentIndices.clear();
+		pending = Pending();
+	}
+
+	bool next()
+	{
+		if(delivered >= batchCount)
+		{
+			stopEpoch();
+			return false;
+		}
+
+		unsigned spins = 0;
+		std::chrono::steady_clock::time_point start;
+		bool blocked = false;
+		while(!queue.tryPop(pending))
+		{
+			if(failed.load(std::memory_order_acquire))
+			{
+				stopEpoch();
+				std::rethrow_exception(error);
+			}
+			if(!blocked)
+			{
+				start = std::chrono::steady_clock::now();
+				blocked = true;
+			}
+			backoff(spins);
+		}
+		if(blocked)
+			waited += std::chrono::steady_clock::now() - start;
+
+		current = std::move(pending.batch);
+		currentIndices = std::move(pending.indices);
+		if(options.device)
+		{
+			current.data = current.data.to(*options.device);
+			current.target = current.target.to(*options.device);
+		}
+		if(options.augmentation)
+			options.augmentation->apply(current.data, pending.random);
+		pending.random = torch::Tensor();
+
+		++delivered;
+		return true;
+	}
+
+public:
+	EisDataLoader(EisDataset<DataSelf>* datasetIn, const EisDataLoaderOptions& optionsIn):
+	dataset(datasetIn), options(optionsIn), queue(std::max<size_t>(optionsIn.prefetch, 1))
+	{
+		assert(options.batchSize > 0);
+		if(options.workers == 0)
+			options.workers = std::max(std::thread::hardware_concurrency(), 1u);
+
+		order.resize(dataset->size().value());
+		std::iota(order.begin(), order.end(), 0);
+		batchCount = (order.size() + options.batchSize - 1)/options.batchSize;
+		assert(batchCount <= 0xffffffff);
+
+		options.workers = std::max<size_t>(std::min(options.workers, batchCount), 1);
+		ranges.reset(new WorkRange[options.workers]);
+		threads.reserve(options.workers);
+	}
+
+	EisDataLoader(const EisDataLoader&) = delete;
+	EisDataLoader& operator=(const EisDataLoader&) = delete;
+
+	~EisDataLoader()
+	{
+		stopEpoch();
+	}
+
+	Iterator begin()
+	{
+		startEpoch();
+		Iterator it(this);
+		return ++it;
+	}
+
+	Iterator end()
+	{
+		return Iterator();
+	}
+
+	/**
+	 * @brief Time the consumer spent waiting for a batch during the current or last epoch
+	 */
+	double waitSeconds() const
+	{
+		return std::chrono::duration<double>(waited).count();
+	}
+
+	/**
+	 * @brief The dataset indices of the rows of the current batch
+	 */
+	const std::vector<size_t>& indices() const
+	{
+		return currentIndices;
+	}
+
+	size_t batches() const
+	{
+		return batchCount;
+	}
+
+	size_t workers() const
+	{
+		return options.workers;
+	}
+};
@@ -20,44 +20,122 @@
 
 #pragma once
 #include <cstdint>
+#include <filesystem>
 #include <limits>
 #include <string>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
 
 #include "net.h"
+#include "globals.h"
 #include "tensoroptions.h"
 #include "indicators.hpp"
 #include "randomgen.h"
-
-struct DropDesc
-{
-	bool dropout;
-	float max;
-	float min;
-	float strength;
-};
+#include "parallelfor.h"
+#include "data/batchaugmentation.h"
+#include "data/datasetschema.h"
+#include "data/datasetstats.h"
+#include "data/samplecache.h"
+#include "data/loaders/datasetindex.h"
 
 template <typename DataSelf>
 class EisDataset:
 public torch::data::datasets::Dataset<DataSelf, torch::data::Example<torch::Tensor, torch::Tensor>>
 {
 private:
+	struct SchemaState
+	{
+		std::once_flag once;
+		DatasetSchema schema;
+	};
+
 	std::map<int64_t, int64_t> labelMap;
-	std::vector<DropDesc> dropouts;
+	std::shared_ptr<const BatchAugmentation> augmentation;
+	// shared between copies of the dataset so that the schema is only ever computed once
+	std::shared_ptr<SchemaState> schemaState = std::make_shared<SchemaState>();
+	std::shared_ptr<SampleCache> cache;
+	std::shared_ptr<const DatasetStats> stats;
+
+	// decodes the examples at indices into batch tensors, without applying the label map
+	torch::data::Example<torch::Tensor, torch::Tensor> loadBatch(c10::ArrayRef<size_t> indices);
+
+	// forwards to the getImpl and getImplToRow of its shards
+	template <typename ShardType>
+	friend class ShardedDataset;
 
 protected:
 	virtual torch::data::Example<torch::Tensor, torch::Tensor> getImpl(size_t index) = 0;
 	virtual torch::Tensor getTargetImpl(size_t index);
+	virtual DatasetSchema loadSchema();
+
+	/**
+	 * @brief Writes example index into row row of the preallocated batch tensors inputs and targets.
+	 *
+	 * The default implementation copies the example returned by getImpl, loaders should override this
+	 * to write directly into the batch.
+	 */
+	virtual void getImplToRow(size_t index, torch::Tensor& inputs, torch::Tensor& targets, int64_t row);
+
+	/**
+	 * @brief Called by getBatch with the examples it is about to read through getImplToRow on the same thread.
+	 *
+	 * Loaders can use this to issue the reads of a whole batch at once, the default implementation dose nothing.
+	 */
+	virtual void prefetchBatch(const std::vector<size_t>& indices)
+	{}
+
+	/**
+	 * @brief Computes the statistics returned by getStats, the default implementation makes one parallel pass over the dataset
+	 */
+	virtual DatasetStats computeStats();
+
+	/**
+	 * @brief Computes the statistics of the first count examples in one parallel pass, without applying the label map
+	 */
+	DatasetStats statsOfFirst(size_t count);
+
+	/**
+	 * @brief The file or directory the dataset was loaded from, used to cache data next to it.
+	 *
+	 * Datasets that are not backed by a file return an empty path.
+	 */
+	virtual std::filesystem::path sourcePath() const
+	{
+		return std::filesystem::path();
+	}
 
 public:
 	torch::data::Example<torch::Tensor, torch::Tensor> get(size_t index) override;
+	torch::data::Example<torch::Tensor, torch::Tensor> getBatch(c10::ArrayRef<size_t> indices);
 	torch::Tensor getTarget(size_t index);
+	const DatasetSchema& getSchema();
 	virtual size_t outputSize() const = 0;
 	virtual std::string outputName(size_t output);
 	virtual c10::optional<size_t> size() const override = 0;
 	virtual bool isMulticlass();
 	bool createLabelMap(const ann::Net& net);
 	void setDropouts(const std::vector<DropDesc>& dropouts);
+	/**
+	 * @brief Sets the augmentation applied by get, by augment and by loaders that are given getAugmentation().
+	 *
+	 * getBatch dose not augment, so that batches can be augmented on the device the network runs on after collation.
+	 */
+	void setAugmentation(const AugmentationOptions& options);
+	std::shared_ptr<const BatchAugmentation> getAugmentation() const;
+	/**
+	 * @brief Applies the augmentation of this dataset to a batch of inputs, on the device they are on
+	 */
+	void augment(torch::Tensor& inputs) const;
+	/**
+	 * @brief Caches decoded examples returned by getBatch so that only the first epoch has to decode them.
+	 *
+	 * Examples are cached before label mapping and augmentation are applied, so these stay random per epoch.
+	 * Up to ramBudget bytes are kept in memory, the rest is spilled to a scratch file in spillDir.
+	 */
+	void enableCache(size_t ramBudget, const std::filesystem::path& spillDir = std::filesystem::temp_directory_path());
+	std::shared_ptr<const SampleCache> getCache() const;
 	const std::vector<DropDesc>& getDropouts();
 
 	virtual torch::Tensor classCounts();
@@ -68,6 +146,13 @@ public:
 	virtual std::vector<std::pair<std::string, int64_t>> extraInputs();
 	virtual std::pair<torch::Tensor, torch::Tensor> inputRanges();
 
+	/**
+	 * @brief Per column statistics of the inputs and targets before label mapping and augmentation.
+	 *
+	 * These are computed on first use and cached next to the dataset if it has a sourcePath().
+	 */
+	const DatasetStats& getStats();
+
 	virtual ~EisDataset() = default;
 };
 
@@ -147,19 +232,89 @@ torch::data::Example<torch::Tensor, torch::Tensor> EisDataset<DataSelf>::get(siz
 			data.target[0] = search->second;
 	}
 
-	if(!dropouts.empty())
+	if(augmentation)
+	{
+		// getImpl may return a view of read only memory
+		torch::Tensor inputs = data.data.reshape({1, -1}).clone();
+		augmentation->apply(inputs);
+		data.data = inputs.reshape(data.data.sizes());
+	}
+
+	return data;
+}
+
+template <typename DataSelf>
+void EisDataset<DataSelf>::getImplToRow(size_t index, torch::Tensor& inputs, torch::Tensor& targets, int64_t row)
+{
+	torch::data::Example<torch::Tensor, torch::Tensor> example = getImpl(index);
+	inputs[row].copy_(example.data.reshape({-1}));
+	targets[row].copy_(example.target.reshape({-1}));
+}
+
+template <typename DataSelf>
+torch::data::Example<torch::Tensor, torch::Tensor> EisDataset<DataSelf>::loadBatch(c10::ArrayRef<size_t> indices)
+{
+	const DatasetSchema& schema = getSchema();
+	const int64_t batchSize = indices.size();
+	const int64_t width = inputSize();
+	const int64_t targetWidth = schema.targetSize;
+
+	torch::Tensor inputs = torch::empty({batchSize, width}, tensorOptCpu<float>(false));
+	torch::Tensor targets = torch::empty({batchSize, targetWidth}, tensorOptCpu<float>(false).dtype(schema.targetType));
+	if(cache)
 	{
-		for(size_t i = 0; i < dropouts.size(); ++i)
+		float* inputPtr = inputs.data_ptr<float>();
+		char* targetPtr = static_cast<char*>(targets.data_ptr());
+		const size_t targetBytes = targetWidth*targets.element_size();
+		std::vector<int64_t> missingRows;
+		std::vector<size_t> missing;
+		for(int64_t row = 0; row < batchSize; ++row)
 		{
-			if(dropouts[i].dropout)
+			if(!cache->load(indices[row], inputPtr + row*width, targetPtr + row*targetBytes))
 			{
-				float random = rd::rand(dropouts[i].min, dropouts[i].max);
-				data.data[i] = data.data[i]*(1-dropouts[i].strength) + random*dropouts[i].strength;
+				missingRows.push_back(row);
+				missing.push_back(indices[row]);
 			}
 		}
+
+		if(!missing.empty())
+			prefetchBatch(missing);
+		for(int64_t row : missingRows)
+		{
+			getImplToRow(indices[row], inputs, targets, row);
+			cache->store(indices[row], inputPtr + row*width, targetPtr + row*targetBytes);
+		}
+	}
+	else
+	{
+		prefetchBatch(indices.vec());
+		for(int64_t row = 0; row < batchSize; ++row)
+			getImplToRow(indices[row], inputs, targets, row);
 	}
 
-	return data;
+	return torch::data::Example<torch::Tensor, torch::Tensor>(inputs, targets);
+}
+
+template <typename DataSelf>
+torch::data::Example<torch::Tensor, torch::Tensor> EisDataset<DataSelf>::getBatch(c10::ArrayRef<size_t> indices)
+{
+	torch::data::Example<torch::Tensor, torch::Tensor> batch = loadBatch(indices);
+	torch::Tensor& targets = batch.target;
+	const int64_t batchSize = indices.size();
+	const int64_t targetWidth = targets.size(1);
+
+	if(!isMulticlass() && !labelMap.empty())
+	{
+		int64_t* targetPtr = targets.data_ptr<int64_t>();
+		for(int64_t row = 0; row < batchSize; ++row)
+		{
+			auto search = labelMap.find(targetPtr[row*targetWidth]);
+			if(search != labelMap.end())
+				targetPtr[row*targetWidth] = search->second;
+		}
+	}
+
+	return batch;
 }
 
 template <typename DataSelf>
@@ -184,23 +339,43 @@ torch::Tensor EisDataset<DataSelf>::classWeights()
 	return output;
 }
 
+template <typename DataSelf>
+DatasetSchema EisDataset<DataSelf>::loadSchema()
+{
+	DatasetSchema schema;
+	if(size().value_or(0) > 0)
+	{
+		torch::data::Example<torch::Tensor, torch::Tensor> example = getImpl(0);
+		schema.inputSize = example.data.numel();
+		schema.targetSize = example.target.numel();
+		schema.targetType = example.target.scalar_type();
+	}
+	return schema;
+}
+
+template <typename DataSelf>
+const DatasetSchema& EisDataset<DataSelf>::getSchema()
+{
+	std::call_once(schemaState->once, [this](){schemaState->schema = loadSchema();});
+	return schemaState->schema;
+}
+
 template <typename DataSelf>
 c10::optional<torch::Tensor> EisDataset<DataSelf>::frequencies()
 {
-	return c10::optional<torch::Tensor>();
+	return getSchema().frequencies;
 }
 
 template <typename DataSelf>
 size_t EisDataset<DataSelf>::inputSize()
 {
-	torch::data::Example<torch::Tensor, torch::Tensor> example = getImpl(0);
-	return example.data.numel();
+	return getSchema().inputSize;
 }
 
 template <typename DataSelf>
 std::vector<std::pair<std::string, int64_t>> EisDataset<DataSelf>::extraInputs()
 {
-	return std::vector<std::pair<std::string, int64_t>>();
+	return getSchema().extraInputs;
 }
 
 class dataset_error: public std::exception
@@ -215,49 +390,165 @@ public:
 	}
 };
 
+/**
+ * @brief Presents a EisDataset to torch::data::make_data_loader as a BatchDataset.
+ *
+ * Batches are assembled by EisDataset::getBatch, avoiding the per example tensors and the
+ * torch::data::transforms::Stack<> collation. The wrapped dataset is not owned and must outlive the loader.
+ */
+template <typename DataSelf>
+class EisBatchDataset:
+public torch::data::datasets::BatchDataset<EisBatchDataset<DataSelf>, torch::data::Example<torch::Tensor, torch::Tensor>>
+{
+private:
+	EisDataset<DataSelf>* dataset;
+
+public:
+	explicit EisBatchDataset(EisDataset<DataSelf>* datasetIn): dataset(datasetIn)
+	{}
+
+	torch::data::Example<torch::Tensor, torch::Tensor> get_batch(c10::ArrayRef<size_t> indices) override
+	{
+		torch::data::Example<torch::Tensor, torch::Tensor> batch = dataset->getBatch(indices);
+		dataset->augment(batch.data);
+		return batch;
+	}
+
+	c10::optional<size_t> size() const override
+	{
+		return dataset->size();
+	}
+};
+
 template <typename DataSelf>
 std::pair<torch::Tensor, torch::Tensor> EisDataset<DataSelf>::inputRanges()
 {
-	torch::Tensor min = torch::full({static_cast<int64_t>(inputSize())}, std::numeric_limits<float>::max(), tensorOptCpu<float>());
-	torch::Tensor max = torch::full({static_cast<int64_t>(inputSize())}, std::numeric_limits<float>::lowest(), tensorOptCpu<float>());
+	const ColumnStats& inputs = getStats().inputs;
+	return {torch::tensor(inputs.max, tensorOptCpu<float>()), torch::tensor(inputs.min, tensorOptCpu<float>())};
+}
 
-	torch::data::DataLoaderOptions options;
-	options = options.batch_size(batch_size).workers(16);
-	auto dataLoader = torch::data::make_data_loader(this->map(torch::data::transforms::Stack<>()), options);
+template <typename DataSelf>
+DatasetStats EisDataset<DataSelf>::computeStats()
+{
+	return statsOfFirst(size().value());
+}
+
+template <typename DataSelf>
+DatasetStats EisDataset<DataSelf>::statsOfFirst(size_t count)
+{
+	const size_t chunkSize = std::max<size_t>(batch_size, 1);
+	const size_t chunks = (count + chunkSize - 1)/chunkSize;
+
+	DatasetStats total(inputSize(), getSchema().targetSize);
+	std::mutex mutex;
 
 	indicators::BlockProgressBar bar(
 		indicators::option::BarWidth(50),
-		indicators::option::PrefixText("Computing dataset ranges: "),
+		indicators::option::PrefixText("Computing dataset statistics: "),
 		indicators::option::ShowElapsedTime(true),
 		indicators::option::ShowRemainingTime(true),
-		indicators::option::MaxProgress(size().value()/batch_size)
+		indicators::option::MaxProgress(chunks)
 	);
 
 	indicators::show_console_cursor(false);
 
-	for(const auto& batch : *dataLoader)
+	parallelFor(chunks, [this, count, chunkSize, &total, &mutex, &bar](size_t chunk)
 	{
-		bar.tick();
+		std::vector<size_t> indices(std::min(chunkSize, count - chunk*chunkSize));
+		std::iota(indices.begin(), indices.end(), chunk*chunkSize);
+		torch::data::Example<torch::Tensor, torch::Tensor> batch = loadBatch(indices);
 
-		torch::Tensor inputs = batch.data;
-		max = torch::maximum(std::get<0>(inputs.max(0)), max);
-		min = torch::minimum(std::get<0>(inputs.min(0)), min);
-	}
+		DatasetStats part(total.inputs.columns(), total.targets.columns());
+		part.inputs.add(batch.data.data_ptr<float>(), indices.size());
+		torch::Tensor targets = batch.target.to(torch::kFloat64).contiguous();
+		part.targets.add(targets.data_ptr<double>(), indices.size());
+
+		std::lock_guard<std::mutex> lock(mutex);
+		total.merge(part);
+		bar.tick();
+	}, data_workers);
 
 	bar.mark_as_completed();
 	indicators::show_console_cursor(true);
-	return {max, min};
+	return total;
+}
+
+template <typename DataSelf>
+const DatasetStats& EisDataset<DataSelf>::getStats()
+{
+	if(stats)
+		return *stats;
+
+	std::filesystem::path path = sourcePath();
+	std::shared_ptr<DatasetStats> loaded = std::make_shared<DatasetStats>();
+	if(!path.empty() && DatasetIndex::loadStats(path, *loaded) && loaded->inputs.count == size().value() &&
+		loaded->inputs.columns() == inputSize() && loaded->targets.columns() == getSchema().targetSize)
+	{
+		Log(Log::DEBUG)<<"Using cached statistics of "<<path;
+		stats = loaded;
+		return *stats;
+	}
+
+	stats = std::make_shared<DatasetStats>(computeStats());
+	if(!path.empty())
+		DatasetIndex::saveStats(path, *stats);
+	return *stats;
 }
 
 template <typename DataSelf>
 void EisDataset<DataSelf>::setDropouts(const std::vector<DropDesc>& dropouts)
 {
 	assert(dropouts.size() == inputSize());
-	this->dropouts = dropouts;
+	AugmentationOptions options;
+	options.dropouts = dropouts;
+	setAugmentation(options);
+}
+
+template <typename DataSelf>
+void EisDataset<DataSelf>::setAugmentation(const AugmentationOptions& options)
+{
+	if(options.empty())
+	{
+		augmentation.reset();
+		return;
+	}
+
+	const DatasetSchema& schema = getSchema();
+	size_t pointCount = schema.frequencies.has_value() ? schema.frequencies->numel() : 0;
+	const DatasetStats* stats = options.needsStats() ? &getStats() : nullptr;
+	augmentation = std::make_shared<const BatchAugmentation>(options, inputSize(), pointCount, stats);
+}
+
+template <typename DataSelf>
+std::shared_ptr<const BatchAugmentation> EisDataset<DataSelf>::getAugmentation() const
+{
+	return augmentation;
+}
+
+template <typename DataSelf>
+void EisDataset<DataSelf>::augment(torch::Tensor& inputs) const
+{
+	if(augmentation)
+		augmentation->apply(inputs);
+}
+
+template <typename DataSelf>
+void EisDataset<DataSelf>::enableCache(size_t ramBudget, const std::filesystem::path& spillDir)
+{
+	const DatasetSchema& schema = getSchema();
+	size_t targetBytes = schema.targetSize*c10::elementSize(schema.targetType);
+	cache = std::make_shared<SampleCache>(size().value(), inputSize(), targetBytes, ramBudget, spillDir);
+}
+
+template <typename DataSelf>
+std::shared_ptr<const SampleCache> EisDataset<DataSelf>::getCache() const
+{
+	return cache;
 }
 
 template <typename DataSelf>
-const std::vector<DropDesc >& EisDataset<DataSelf>::getDropouts()
+const std::vector<DropDesc>& EisDataset<DataSelf>::getDropouts()
 {
-	return dropouts;
+	static const std::vector<DropDesc> none;
+	return augmentation ? augmentation->getOptions().dropouts : none;
 }
@@ -75,7 +75,6 @@ public:
 	virtual bool isMulticlass() override;
 	virtual std::string dataLabel() const override;
 	virtual c10::optional<torch::Tensor> freqRange() override;
-	virtual std::pair<torch::Tensor, torch::Tensor> getTargetScalesAndBias() override;
 	virtual size_t outputSize() const override = 0;
 	virtual size_t classForIndex(size_t index) override;
 };
@@ -271,17 +270,3 @@ c10::optional<torch::Tensor> CoinCellHellLoader<DataSelf>::freqRange()
 	return out;
 }
 
-template <typename DataSelf>
-std::pair<torch::Tensor, torch::Tensor> CoinCellHellLoader<DataSelf>::getTargetScalesAndBias()
-{
-	torch::Tensor max = torch::zeros({static_cast<int>(outputSize())}, tensorOptCpu<fvalue>(false));
-	torch::Tensor min = torch::full({static_cast<int>(outputSize())}, std::numeric_limits<fvalue>::max(),  tensorOptCpu<fvalue>(false));
-
-	for(size_t i = 0; i < size().value(); ++i)
-	{
-		torch::Tensor targets = getImpl(i).target;
-		max = torch::maximum(targets, max);
-		min = torch::minimum(targets, min);
-	}
-	return {(max-min), min};
-}
@@ -0,0 +1,381 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "datasetindex.h"
+
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sys/stat.h>
+
+#include "log.h"
+
+static constexpr char INDEX_MAGIC[8] = {'E', 'I', 'S', 'I', 'D', 'X', '\0', '\0'};
+static constexpr char STATS_MAGIC[8] = {'E', 'I', 'S', 'S', 'T', 'A', 'T', '\0'};
+
+struct SourceStamp
+{
+	uint64_t size;
+	int64_t mtimeSec;
+	int64_t mtimeNsec;
+
+	bool operator==(const SourceStamp& in) const
+	{
+		return size == in.size && mtimeSec == in.mtimeSec && mtimeNsec == in.mtimeNsec;
+	}
+};
+
+static bool getStamp(const std::filesystem::path& path, SourceStamp& stamp)
+{
+	struct stat st;
+	if(stat(path.c_str(), &st) != 0)
+		return false;
+	stamp.size = st.st_size;
+	stamp.mtimeSec = st.st_mtim.tv_sec;
+	stamp.mtimeNsec = st.st_mtim.tv_nsec;
+	return true;
+}
+
+template <typename T>
+static void writeValue(std::ostream& stream, const T& value)
+{
+	stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+static bool readValue(std::istream& stream, T& value)
+{
+	return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+// checks that the rest of stream could hold count elements of at least elementSize bytes,
+// so that a corrupt count is rejected before anything is allocated for it
+static bool countFits(std::istream& stream, uint64_t count, size_t elementSize)
+{
+	std::streampos pos = stream.tellg();
+	if(pos < 0)
+		return false;
+	stream.seekg(0, std::ios_base::end);
+	std::streampos end = stream.tellg();
+	stream.seekg(pos);
+	return end >= pos && count <= static_cast<uint64_t>(end - pos)/elementSize;
+}
+
+static void writeString(std::ostream& stream, const std::string& str)
+{
+	writeValue<uint32_t>(stream, str.size());
+	stream.write(str.data(), str.size());
+}
+
+static bool readString(std::istream& stream, std::string& str)
+{
+	uint32_t length;
+	if(!readValue(stream, length) || !countFits(stream, length, 1))
+		return false;
+	str.resize(length);
+	return static_cast<bool>(stream.read(str.data(), length));
+}
+
+static void writeStrings(std::ostream& stream, const std::vector<std::string>& strings)
+{
+	writeValue<uint64_t>(stream, strings.size());
+	for(const std::string& str : strings)
+		writeString(stream, str);
+}
+
+static bool readStrings(std::istream& stream, std::vector<std::string>& strings)
+{
+	uint64_t count;
+	if(!readValue(stream, count) || !countFits(stream, count, sizeof(uint32_t)))
+		return false;
+	strings.resize(count);
+	for(std::string& str : strings)
+	{
+		if(!readString(stream, str))
+			return false;
+	}
+	return true;
+}
+
+std::filesystem::path DatasetIndex::sidecarPath(const std::filesystem::path& dataset)
+{
+	std::filesystem::path path = dataset;
+	if(!path.has_filename())
+		path = path.parent_path();
+	path += ".idx";
+	return path;
+}
+
+std::filesystem::path DatasetIndex::statsPath(const std::filesystem::path& dataset)
+{
+	std::filesystem::path path = sidecarPath(dataset);
+	path.replace_extension(".stats");
+	return path;
+}
+
+// opens the sidecar at path and positions file after the header if the sidecar is valid for dataset
+static bool openSidecar(const std::filesystem::path& dataset, const std::filesystem::path& path,
+	const char (&expectedMagic)[8], uint32_t expectedVersion, std::ifstream& file)
+{
+	SourceStamp stamp;
+	if(!getStamp(dataset, stamp))
+		return false;
+
+	file.open(path, std::ios_base::in | std::ios_base::binary);
+	if(!file.is_open())
+		return false;
+
+	char magic[sizeof(INDEX_MAGIC)];
+	uint32_t version;
+	SourceStamp recorded;
+	if(!file.read(magic, sizeof(magic)) || std::memcmp(magic, expectedMagic, sizeof(magic)) != 0 ||
+		!readValue(file, version) || version != expectedVersion)
+	{
+		Log(Log::INFO)<<path<<" is not of a compatible version, it will be rebuilt";
+		return false;
+	}
+
+	if(!readValue(file, recorded) || !(recorded == stamp))
+	{
+		Log(Log::INFO)<<dataset<<" has changed since "<<path<<" was created, it will be rebuilt";
+		return false;
+	}
+	return true;
+}
+
+// writes a sidecar for dataset to a temporary file that replaces path once it is complete
+static bool writeSidecar(const std::filesystem::path& dataset, const std::filesystem::path& path,
+	const char (&magic)[8], uint32_t version, const std::function<void(std::ofstream&)>& write)
+{
+	SourceStamp stamp;
+	if(!getStamp(dataset, stamp))
+		return false;
+
+	std::filesystem::path tmpPath = path;
+	tmpPath += ".tmp";
+
+	{
+		std::ofstream file(tmpPath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+		if(!file.is_open())
+		{
+			Log(Log::WARN)<<"Unable to create "<<path<<", it will be computed again on next use";
+			return false;
+		}
+
+		file.write(magic, sizeof(magic));
+		writeValue(file, version);
+		writeValue(file, stamp);
+		write(file);
+
+		if(file.fail())
+		{
+			Log(Log::WARN)<<"Unable to write to "<<path;
+			file.close();
+			std::filesystem::remove(tmpPath);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, path, ec);
+	if(ec)
+	{
+		Log(Log::WARN)<<"Unable to create "<<path<<": "<<ec.message();
+		std::filesystem::remove(tmpPath, ec);
+		return false;
+	}
+	return true;
+}
+
+bool DatasetIndex::load(const std::filesystem::path& dataset)
+{
+	clear();
+
+	std::filesystem::path path = sidecarPath(dataset);
+	std::ifstream file;
+	if(!openSidecar(dataset, path, INDEX_MAGIC, VERSION, file))
+		return false;
+
+	uint64_t count;
+	bool valid = readValue(file, count) && countFits(file, count, sizeof(uint32_t) + 2*sizeof(uint64_t));
+	if(valid)
+		entries->resize(count);
+	for(size_t i = 0; i < count && valid; ++i)
+	{
+		Entry& entry = (*entries)[i];
+		uint64_t pos;
+		uint64_t size;
+		valid = readString(file, entry.path) && readValue(file, pos) && readValue(file, size);
+		entry.pos = pos;
+		entry.size = size;
+	}
+
+	uint64_t classIdCount;
+	valid = valid && readValue(file, classIdCount) && countFits(file, classIdCount, sizeof(uint32_t));
+	if(valid)
+	{
+		classIds.resize(classIdCount);
+		valid = static_cast<bool>(file.read(reinterpret_cast<char*>(classIds.data()), classIdCount*sizeof(uint32_t)));
+	}
+	valid = valid && readStrings(file, classNames) && readStrings(file, labelNames) && readString(file, model);
+
+	uint64_t frameCount;
+	valid = valid && readValue(file, frameCount) && countFits(file, frameCount, sizeof(CompressedArchive::Frame));
+	if(valid)
+	{
+		frames.resize(frameCount);
+		valid = static_cast<bool>(file.read(reinterpret_cast<char*>(frames.data()), frameCount*sizeof(CompressedArchive::Frame)));
+	}
+
+	if(!valid)
+	{
+		Log(Log::WARN)<<path<<" is corrupt, it will be rebuilt";
+		clear();
+		return false;
+	}
+
+	Log(Log::DEBUG)<<"Using index "<<path<<" with "<<entries->size()<<" entries";
+	return true;
+}
+
+bool DatasetIndex::loadSummary(const std::filesystem::path& dataset, Summary& summary)
+{
+	std::filesystem::path path = sidecarPath(dataset);
+	std::ifstream file;
+	if(!openSidecar(dataset, path, INDEX_MAGIC, VERSION, file))
+		return false;
+
+	uint64_t count;
+	bool valid = readValue(file, count);
+	for(size_t i = 0; i < count && valid; ++i)
+	{
+		uint32_t length;
+		valid = readValue(file, length) && file.seekg(length + 2*sizeof(uint64_t), std::ios_base::cur);
+	}
+
+	uint64_t classIdCount;
+	std::vector<uint32_t> classIds;
+	valid = valid && readValue(file, classIdCount) && countFits(file, classIdCount, sizeof(uint32_t));
+	if(valid)
+	{
+		classIds.resize(classIdCount);
+		valid = static_cast<bool>(file.read(reinterpret_cast<char*>(classIds.data()), classIdCount*sizeof(uint32_t)));
+	}
+	valid = valid && readStrings(file, summary.classNames) && readStrings(file, summary.labelNames);
+	if(!valid)
+		return false;
+
+	summary.count = count;
+	summary.classCounts.assign(summary.classNames.size(), 0);
+	for(uint32_t id : classIds)
+	{
+		if(id >= summary.classCounts.size())
+			summary.classCounts.resize(id + 1, 0);
+		++summary.classCounts[id];
+	}
+	return true;
+}
+
+bool DatasetIndex::save(const std::filesystem::path& dataset) const
+{
+	return writeSidecar(dataset, sidecarPath(dataset), INDEX_MAGIC, VERSION, [this](std::ofstream& file)
+	{
+		writeValue<uint64_t>(file, entries->size());
+		for(const Entry& entry : *entries)
+		{
+			writeString(file, entry.path);
+			writeValue<uint64_t>(file, entry.pos);
+			writeValue<uint64_t>(file, entry.size);
+		}
+
+		writeValue<uint64_t>(file, classIds.size());
+		file.write(reinterpret_cast<const char*>(classIds.data()), classIds.size()*sizeof(uint32_t));
+		writeStrings(file, classNames);
+		writeStrings(file, labelNames);
+		writeString(file, model);
+
+		writeValue<uint64_t>(file, frames.size());
+		file.write(reinterpret_cast<const char*>(frames.data()), frames.size()*sizeof(CompressedArchive::Frame));
+	});
+}
+
+static void writeColumnStats(std::ostream& stream, const ColumnStats& stats)
+{
+	writeValue<uint64_t>(stream, stats.count);
+	writeValue<uint64_t>(stream, stats.columns());
+	for(const std::vector<double>* values : {&stats.min, &stats.max, &stats.mean, &stats.m2})
+		stream.write(reinterpret_cast<const char*>(values->data()), values->size()*sizeof(double));
+}
+
+static bool readColumnStats(std::istream& stream, ColumnStats& stats)
+{
+	uint64_t count;
+	uint64_t columns;
+	if(!readValue(stream, count) || !readValue(stream, columns) || !countFits(stream, columns, 4*sizeof(double)))
+		return false;
+	stats = ColumnStats(columns);
+	stats.count = count;
+	for(std::vector<double>* values : {&stats.min, &stats.max, &stats.mean, &stats.m2})
+	{
+		if(!stream.read(reinterpret_cast<char*>(values->data()), values->size()*sizeof(double)))
+			return false;
+	}
+	return true;
+}
+
+bool DatasetIndex::loadStats(const std::filesystem::path& dataset, DatasetStats& stats)
+{
+	std::filesystem::path path = statsPath(dataset);
+	std::ifstream file;
+	if(!openSidecar(dataset, path, STATS_MAGIC, STATS_VERSION, file))
+		return false;
+
+	if(!readColumnStats(file, stats.inputs) || !readColumnStats(file, stats.targets))
+	{
+		Log(Log::WARN)<<path<<" is corrupt, it will be rebuilt";
+		stats = DatasetStats();
+		return false;
+	}
+	return true;
+}
+
+bool DatasetIndex::saveStats(const std::filesystem::path& dataset, const DatasetStats& stats)
+{
+	return writeSidecar(dataset, statsPath(dataset), STATS_MAGIC, STATS_VERSION, [&stats](std::ofstream& file)
+	{
+		writeColumnStats(file, stats.inputs);
+		writeColumnStats(file, stats.targets);
+	});
+}
+
+bool DatasetIndex::hasClasses() const
+{
+	return !entries->empty() && classIds.size() == entries->size();
+}
+
+void DatasetIndex::clear()
+{
+	entries = std::make_shared<std::vector<Entry>>();
+	classIds.clear();
+	classNames.clear();
+	labelNames.clear();
+	model.clear();
+	frames.clear();
+}
@@ -0,0 +1,101 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "compressedarchive.h"
+#include "data/datasetstats.h"
+
+/**
+ * @brief Sidecar index stored next to a tar or directory dataset.
+ *
+ * The index holds everything the loaders would otherwise have to collect by scanning
+ * the whole dataset at startup. It is only used if the size and modification time
+ * of the dataset still match the values recorded when the index was written.
+ */
+class DatasetIndex
+{
+public:
+	static constexpr uint32_t VERSION = 2;
+	static constexpr uint32_t STATS_VERSION = 1;
+
+	struct Entry
+	{
+		std::string path; // path of the file in the archive or relative to the directory
+		uint64_t pos; // offset of the file data in the archive
+		uint64_t size;
+	};
+
+	// what is needed to place a dataset in a larger dataset without loading its entries
+	struct Summary
+	{
+		size_t count = 0;
+		std::vector<std::string> classNames;
+		std::vector<size_t> classCounts;
+		std::vector<std::string> labelNames;
+	};
+
+	std::shared_ptr<std::vector<Entry>> entries = std::make_shared<std::vector<Entry>>();
+	std::vector<uint32_t> classIds;
+	std::vector<std::string> classNames;
+	std::vector<std::string> labelNames;
+	std::string model;
+	// the frame index of compressed archives, empty otherwise
+	std::vector<CompressedArchive::Frame> frames;
+
+	static std::filesystem::path sidecarPath(const std::filesystem::path& dataset);
+	static std::filesystem::path statsPath(const std::filesystem::path& dataset);
+
+	/**
+	 * @brief Loads the index of the given dataset
+	 * @return true if a index was found that is valid for the dataset, otherwise the index is left empty
+	 */
+	bool load(const std::filesystem::path& dataset);
+
+	/**
+	 * @brief Loads only the summary of the index of the given dataset, skipping the entries
+	 * @return true if a index was found that is valid for the dataset
+	 */
+	static bool loadSummary(const std::filesystem::path& dataset, Summary& summary);
+
+	/**
+	 * @brief Saves the index next to the dataset, failure to do so is not fatal and only logged
+	 */
+	bool save(const std::filesystem::path& dataset) const;
+
+	/**
+	 * @brief Loads the column statistics of the given dataset, these are kept in a second sidecar as they are computed later than the index
+	 * @return true if statistics where found that are valid for the dataset
+	 */
+	static bool loadStats(const std::filesystem::path& dataset, DatasetStats& stats);
+
+	/**
+	 * @brief Saves the column statistics next to the dataset, failure to do so is not fatal and only logged
+	 */
+	static bool saveStats(const std::filesystem::path& dataset, const DatasetStats& stats);
+
+	bool hasClasses() const;
+	void clear();
+};
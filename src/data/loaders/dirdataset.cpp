@@ -22,46 +22,179 @@
 #include "dirdataset.h"
 #include "data/eisdataset.h"
 #include <vector>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
 
+#include "batchfilereader.h"
 #include "indicators.hpp"
+#include "parallelfor.h"
 
-void DirDataset::loadDir(const std::filesystem::path& path)
+// stat is bound by latency on network filesystems, so far more threads than cores pay off
+static constexpr size_t STAT_THREADS = 32;
+
+// the files read by the last call to readBatch on this thread, per dataset
+struct ReadBatch
+{
+	std::unordered_map<size_t, size_t> slots;
+	std::vector<BatchFileReader::Request> requests;
+	std::vector<std::string> paths;
+	std::vector<std::vector<char>> buffers;
+};
+static thread_local std::unordered_map<uint64_t, ReadBatch> readBatches;
+
+static std::atomic<uint64_t> nextId = 1;
+
+DirDataset::DirDataset(): id(nextId++)
 {
-	files.reset(new std::vector<File>);
+}
 
-	const std::filesystem::path directoryPath{path};
-	if(!std::filesystem::is_directory(directoryPath))
-		throw dataset_error(directoryPath.string() + " is not a valid directory");
+bool DirDataset::loadDir(const std::filesystem::path& path, DatasetIndex& index)
+{
+	directory = path;
+	if(!std::filesystem::is_directory(directory))
+		throw dataset_error(directory.string() + " is not a valid directory");
+
+	bool cached = index.load(path);
+	files = index.entries;
+	if(cached)
+		return true;
 
 	indicators::BlockProgressBar bar(
 		indicators::option::BarWidth(50),
 		indicators::option::PrefixText("Loading " + path.string() + ": "),
-		indicators::option::ShowElapsedTime(true),
-		indicators::option::MaxProgress(files->size())
+		indicators::option::ShowElapsedTime(true)
 	);
 
-	for(const std::filesystem::directory_entry& dirent : std::filesystem::directory_iterator{directoryPath})
+	// listing the directory is cheap as the file types come with the entries, the sizes are fetched in parallel afterwards
+	for(const std::filesystem::directory_entry& dirent : std::filesystem::directory_iterator{directory})
 	{
-		bar.tick();
+		if(files->size() % 100 == 0)
+			bar.tick();
 		if(!dirent.is_regular_file() || dirent.path().extension() != ".csv")
 			continue;
 		Log(Log::DEBUG)<<"Using: "<<dirent.path().filename();
-		files->push_back({dirent.path()});
+		files->push_back({.path = dirent.path().filename().string(), .pos = 0, .size = 0});
 	}
+
+	parallelFor(files->size(), [this](size_t i)
+	{
+		File& file = (*files)[i];
+		std::error_code ec;
+		std::uintmax_t size = std::filesystem::file_size(directory/file.path, ec);
+		file.size = ec ? 0 : size;
+	}, STAT_THREADS);
+	bar.mark_as_completed();
+
 	if(files->size() < 20)
-		Log(Log::WARN)<<"found few valid files in "<<directoryPath;
+		Log(Log::WARN)<<"found few valid files in "<<directory;
+
+	if(!files->empty())
+	{
+		eis::Spectra spectra = loadSpectraAtIndex(0);
+		index.labelNames = spectra.labelNames;
+		index.model = spectra.model;
+	}
+
+	return false;
 }
 
 eis::Spectra DirDataset::loadSpectraHeaderAtIndex(size_t index)
 {
 	if(!files || index >= files->size())
 		throw dataset_error("index " + std::to_string(index) + " is out of range for dataset");
-	return eis::Spectra::loadHeaderFromDisk((*files)[index].path);
+	return eis::Spectra::loadHeaderFromDisk(directory/(*files)[index].path);
 }
 
 eis::Spectra DirDataset::loadSpectraAtIndex(size_t index)
 {
 	if(!files ||index >= files->size())
 		throw dataset_error("index " + std::to_string(index) + " is out of range for dataset");
-	return eis::Spectra::loadFromDisk((*files)[index].path);
+	return eis::Spectra::loadFromDisk(directory/(*files)[index].path);
+}
+
+void DirDataset::readBatch(const std::vector<size_t>& indices)
+{
+	ReadBatch& batch = readBatches[id];
+	batch.slots.clear();
+	batch.requests.clear();
+	if(batch.buffers.size() < indices.size())
+	{
+		batch.buffers.resize(indices.size());
+		batch.paths.resize(indices.size());
+	}
+
+	for(size_t i = 0; i < indices.size(); ++i)
+	{
+		if(!files || indices[i] >= files->size())
+			continue;
+		const File& file = (*files)[indices[i]];
+		batch.paths[i].assign(directory.native());
+		batch.paths[i].push_back('/');
+		batch.paths[i].append(file.path);
+		batch.slots[indices[i]] = batch.requests.size();
+		batch.requests.push_back({.path = batch.paths[i].c_str(), .sizeHint = file.size, .buffer = &batch.buffers[i]});
+	}
+
+	BatchFileReader::read(batch.requests);
+}
+
+std::string_view DirDataset::loadRawSpectraAtIndex(size_t index)
+{
+	auto batch = readBatches.find(id);
+	if(batch != readBatches.end())
+	{
+		auto slot = batch->second.slots.find(index);
+		if(slot != batch->second.slots.end())
+		{
+			const BatchFileReader::Request& request = batch->second.requests[slot->second];
+			// failed reads are retried below, where the error is reported
+			if(request.error == 0)
+				return std::string_view(request.buffer->data(), request.size);
+		}
+	}
+
+	// reused by every load on this thread so that reading a file dose not allocate
+	static thread_local std::string pathBuffer;
+	static thread_local std::vector<char> buffer;
+
+	if(!files || index >= files->size())
+		throw dataset_error("index " + std::to_string(index) + " is out of range for dataset");
+
+	pathBuffer.assign(directory.native());
+	pathBuffer.push_back('/');
+	pathBuffer.append((*files)[index].path);
+
+	int fd = ::open(pathBuffer.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		throw dataset_error("Unable to open " + pathBuffer + ": " + std::strerror(errno));
+
+	struct stat st;
+	if(fstat(fd, &st) != 0)
+	{
+		int err = errno;
+		::close(fd);
+		throw dataset_error("Unable to stat " + pathBuffer + ": " + std::strerror(err));
+	}
+
+	if(buffer.size() < static_cast<size_t>(st.st_size))
+		buffer.resize(st.st_size);
+
+	size_t got = 0;
+	while(got < static_cast<size_t>(st.st_size))
+	{
+		ssize_t ret = ::read(fd, buffer.data() + got, st.st_size - got);
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			break;
+		got += ret;
+	}
+	::close(fd);
+
+	return std::string_view(buffer.data(), got);
 }
@@ -22,24 +22,42 @@
 #include <filesystem>
 #include <kisstype/spectra.h>
 #include <eisgenerator/translators.h>
+#include <cstdint>
 #include <memory>
+#include <string_view>
+#include <vector>
 
+#include "data/loaders/datasetindex.h"
 #include "data/loaders/eisspectradataset.h"
 
 class DirDataset: public EisSpectraDataset
 {
+private:
+	// identifies the batches read by readBatch, copies of a dataset share it as they share the files
+	uint64_t id;
+
 protected:
-	struct File
-	{
-		std::filesystem::path path;
-	};
+	typedef DatasetIndex::Entry File;
 
+	std::filesystem::path directory;
 	std::shared_ptr<std::vector<File>> files;
 
-	void loadDir(const std::filesystem::path& path);
+	/**
+	 * @brief Lists the directory, using the sidecar index if it is valid
+	 * @return true if the file list was loaded from the index and is allready saved
+	 */
+	bool loadDir(const std::filesystem::path& path, DatasetIndex& index);
+
+	/**
+	 * @brief Reads the files of the given indices at once, later loads of these indices on the same thread use the read data
+	 *
+	 * The data stays valid until the next call to readBatch on the same thread.
+	 */
+	void readBatch(const std::vector<size_t>& indices);
 	virtual eis::Spectra loadSpectraAtIndex(size_t index) override;
 	virtual eis::Spectra loadSpectraHeaderAtIndex(size_t index) override;
+	virtual std::string_view loadRawSpectraAtIndex(size_t index) override;
 
 public:
-	DirDataset() = default;
+	DirDataset();
 };
@@ -26,75 +26,64 @@
 #include <kisstype/type.h>
 #include <algorithm>
 
-#include <eisgenerator/translators.h>
 #include <torch/types.h>
 
 #include "log.h"
 #include "../eistotorch.h"
-#include "indicators.hpp"
+#include "tensoroptions.h"
 
 using namespace eis;
 
 EisDirDataset::EisDirDataset(const std::filesystem::path& path)
 {
-	loadDir(path);
+	DatasetIndex index;
+	bool cached = loadDir(path, index);
 
-	indicators::show_console_cursor(false);
-
-	indicators::BlockProgressBar bar(
-		indicators::option::BarWidth(50),
-		indicators::option::PrefixText("Loading classes: "),
-		indicators::option::ShowElapsedTime(true),
-		indicators::option::ShowRemainingTime(true),
-		indicators::option::MaxProgress(files->size())
-	);
-
-	for(size_t i = 0; i < files->size(); ++i)
+	if(!index.hasClasses())
 	{
-		eis::Spectra spectra = loadSpectraHeaderAtIndex(i);
-		purgeEisParamBrackets(spectra.model);
-
-		if(spectra.model.length() < 2 && spectra.model != "r" && spectra.model != "c" && spectra.model != "w" && spectra.model != "p" && spectra.model != "l")
-			spectra.model = "Union";
-		auto search = std::find(modelStrs.begin(), modelStrs.end(), spectra.model);
-		size_t index;
-		if(search == modelStrs.end())
-		{
-			index = modelStrs.size();
-			modelStrs.push_back(spectra.model);
-			Log(Log::DEBUG)<<"New model "<<index<<": "<<spectra.model;
-		}
-		else
-		{
-			index = search - modelStrs.begin();
-		}
-		classIndexes.push_back(index);
+		indexClasses(index);
+		cached = false;
 	}
 
-	bar.mark_as_completed();
-	indicators::show_console_cursor(true);
-}
+	if(!cached)
+		index.save(path);
 
-std::vector<std::pair<std::string, int64_t>> EisDirDataset::extraInputs()
-{
-	return DirDataset::extraInputs();
+	modelStrs = index.classNames;
+	classIndexes.assign(index.classIds.begin(), index.classIds.end());
+
+	getSchema();
 }
 
 torch::data::Example<torch::Tensor, torch::Tensor> EisDirDataset::getImpl(size_t index)
 {
-	eis::Spectra data = loadSpectraAtIndex(index);
-
 	torch::TensorOptions options;
 	options = options.layout(torch::kStrided);
 	options = options.device(torch::kCPU);
 	options = options.dtype(torch::kInt64);
-	torch::Tensor output = torch::zeros({1}, options);
-	output[0] = static_cast<float>(classIndexes[index]);
+	torch::Tensor output = torch::empty({1}, options);
+	output.data_ptr<int64_t>()[0] = classIndexes[index];
 
-	torch::Tensor input = eisToTorch(data.data);
+	torch::Tensor input = torch::empty({static_cast<int64_t>(getSchema().inputSize)}, tensorOptCpu<float>(false));
+	fillSpectraAtIndex(index, input.data_ptr<float>(), nullptr, nullptr);
 	return torch::data::Example<torch::Tensor, torch::Tensor>(input, output);
 }
 
+void EisDirDataset::getImplToRow(size_t index, torch::Tensor& inputs, torch::Tensor& targets, int64_t row)
+{
+	fillSpectraAtIndex(index, inputs.data_ptr<float>() + row*inputs.size(1), nullptr, nullptr);
+	targets.data_ptr<int64_t>()[row] = classIndexes[index];
+}
+
+std::filesystem::path EisDirDataset::sourcePath() const
+{
+	return directory;
+}
+
+void EisDirDataset::prefetchBatch(const std::vector<size_t>& indices)
+{
+	readBatch(indices);
+}
+
 size_t EisDirDataset::outputSize() const
 {
 	return *std::max_element(classIndexes.begin(), classIndexes.end()) + 1;
@@ -144,7 +133,14 @@ torch::Tensor EisDirDataset::classCounts()
 	return out;
 }
 
-c10::optional<torch::Tensor> EisDirDataset::frequencies()
+DatasetSchema EisDirDataset::loadSchema()
 {
-	return EisSpectraDataset::frequencies();
+	DatasetSchema schema;
+	if(files->empty())
+		return schema;
+	loadSpectraSchema(schema);
+	schema.inputSize = columns.pointCount*2;
+	schema.targetSize = 1;
+	schema.targetType = torch::kInt64;
+	return schema;
 }
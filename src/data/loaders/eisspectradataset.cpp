@@ -22,6 +22,16 @@
 #include "eisspectradataset.h"
 #include "data/eistotorch.h"
 
+#include <atomic>
+#include <cmath>
+#include <unordered_map>
+#include <eisgenerator/translators.h>
+
+#include "indicators.hpp"
+#include "log.h"
+#include "parallelfor.h"
+#include "data/eisdataset.h"
+
 std::pair<std::vector<std::string>, std::vector<std::string>> EisSpectraDataset::getExtraInputsAndLabelNames(const eis::Spectra& spectra)
 {
 	std::vector<std::string> labelNames;
@@ -37,23 +47,108 @@ std::pair<std::vector<std::string>, std::vector<std::string>> EisSpectraDataset:
 	return {extraInputNames, labelNames};
 }
 
-std::vector<std::pair<std::string, int64_t>> EisSpectraDataset::extraInputs()
+void EisSpectraDataset::loadSpectraSchema(DatasetSchema& schema)
 {
 	eis::Spectra spectra = loadSpectraAtIndex(0);
-	std::vector<std::pair<std::string, int64_t>> out;
-	for(const std::string& name : getExtraInputsAndLabelNames(spectra).first)
+
+	std::vector<fvalue> omega(spectra.data.size());
+	for(size_t i = 0; i < spectra.data.size(); ++i)
+		omega[i] = spectra.data[i].omega;
+	schema.frequencies = fvalueVectorToTensor(omega).clone();
+
+	auto [extraInputNames, labelNames] = getExtraInputsAndLabelNames(spectra);
+	schema.labelNames = labelNames;
+	schema.extraInputs.clear();
+	for(const std::string& name : extraInputNames)
+		schema.extraInputs.push_back({name.substr(extraInputStr.length()), 1});
+	schema.targetModel = spectra.model;
+
+	columns = SpectraColumnMap();
+	columns.pointCount = spectra.data.size();
+	columns.labelCount = spectra.labels.size();
+	columns.targetColumns.assign(columns.labelCount, -1);
+	columns.extraColumns.assign(columns.labelCount, -1);
+	for(size_t i = 0; i < columns.labelCount && i < spectra.labelNames.size(); ++i)
 	{
-		out.push_back({name, 1});
-		out.back().first.erase(out.back().first.begin(), out.back().first.begin()+extraInputStr.length());
+		if(spectra.labelNames[i].find(extraInputStr) == 0)
+			columns.extraColumns[i] = columns.extraCount++;
+		else
+			columns.targetColumns[i] = columns.targetCount++;
 	}
-	return out;
+	columns.labelNameLine = spectraLabelNameLine(loadRawSpectraAtIndex(0));
 }
 
-torch::Tensor EisSpectraDataset::frequencies()
+void EisSpectraDataset::fillSpectraAtIndex(size_t index, float* input, float* extraInputs, float* target)
 {
-	eis::Spectra spectra = loadSpectraAtIndex(0);
-	std::vector<fvalue> omega(spectra.data.size());
-	for(size_t i = 0; i < spectra.data.size(); ++i)
-		omega[i] = spectra.data[i].omega;
-	return fvalueVectorToTensor(omega);
+	if(parseSpectra(loadRawSpectraAtIndex(index), columns, input, extraInputs, target))
+		return;
+
+	eis::Spectra spectra = loadSpectraAtIndex(index);
+	if(spectra.data.size() != columns.pointCount || spectra.labels.size() != columns.labelCount)
+		throw dataset_error("Spectra " + std::to_string(index) + " dose not have the same shape as the first spectra in the dataset");
+
+	for(size_t i = 0; i < columns.pointCount; ++i)
+	{
+		float real = spectra.data[i].im.real();
+		float imag = spectra.data[i].im.imag();
+		input[i] = std::isfinite(real) ? real : 0;
+		input[i + columns.pointCount] = std::isfinite(imag) ? imag : 0;
+	}
+
+	for(size_t i = 0; i < columns.labelCount; ++i)
+	{
+		if(target && columns.targetColumns[i] >= 0)
+			target[columns.targetColumns[i]] = spectra.labels[i];
+		if(extraInputs && columns.extraColumns[i] >= 0)
+			extraInputs[columns.extraColumns[i]] = spectra.labels[i];
+	}
+}
+
+void EisSpectraDataset::indexClasses(DatasetIndex& index)
+{
+	index.classIds.clear();
+	index.classNames.clear();
+	index.classIds.reserve(index.entries->size());
+
+	std::unordered_map<std::string, uint32_t> lookup;
+
+	indicators::show_console_cursor(false);
+
+	indicators::BlockProgressBar bar(
+		indicators::option::BarWidth(50),
+		indicators::option::PrefixText("Loading classes: "),
+		indicators::option::ShowElapsedTime(true),
+		indicators::option::ShowRemainingTime(true),
+		indicators::option::MaxProgress(index.entries->size()/100)
+	);
+
+	// parsing the headers is spread over threads, assigning the class ids happens afterwards in file order so they stay stable
+	std::vector<std::string> models(index.entries->size());
+	std::atomic<size_t> parsed = 0;
+	parallelFor(models.size(), [this, &models, &parsed, &bar](size_t i)
+	{
+		eis::Spectra spectra = loadSpectraHeaderAtIndex(i);
+		eis::purgeEisParamBrackets(spectra.model);
+
+		if(spectra.model.length() < 2 && spectra.model != "r" && spectra.model != "c" && spectra.model != "w" && spectra.model != "p" && spectra.model != "l")
+			spectra.model = "Union";
+		models[i] = std::move(spectra.model);
+
+		if(++parsed % 100 == 0)
+			bar.tick();
+	});
+
+	for(const std::string& model : models)
+	{
+		auto [search, inserted] = lookup.try_emplace(model, index.classNames.size());
+		if(inserted)
+		{
+			index.classNames.push_back(model);
+			Log(Log::DEBUG)<<"New model "<<search->second<<": "<<model;
+		}
+		index.classIds.push_back(search->second);
+	}
+
+	bar.mark_as_completed();
+	indicators::show_console_cursor(true);
 }
@@ -20,15 +20,46 @@
 
 #pragma once
 #include <kisstype/spectra.h>
+#include <string_view>
+
+#include "data/datasetschema.h"
+#include "data/loaders/datasetindex.h"
+#include "data/spectraparser.h"
 
 class EisSpectraDataset
 {
 	inline static const std::string extraInputStr = "exip_";
 
 protected:
+	SpectraColumnMap columns;
+
 	static std::pair<std::vector<std::string>, std::vector<std::string>> getExtraInputsAndLabelNames(const eis::Spectra& spectra);
 	virtual eis::Spectra loadSpectraAtIndex(size_t index) = 0;
 	virtual eis::Spectra loadSpectraHeaderAtIndex(size_t index) = 0;
-	virtual std::vector<std::pair<std::string, int64_t>> extraInputs();
-	torch::Tensor frequencies();
+
+	/**
+	 * @brief Returns the unparsed contents of the spectra file at index
+	 *
+	 * The returned view is valid until the next call from the same thread.
+	 */
+	virtual std::string_view loadRawSpectraAtIndex(size_t index) = 0;
+
+	/**
+	 * @brief Assigns every entry a class by its model, the headers are parsed in parallel so loadSpectraHeaderAtIndex must be thread safe
+	 */
+	void indexClasses(DatasetIndex& index);
+
+	/**
+	 * @brief Fills the schema from the first spectra and resolves the column map
+	 *
+	 * This must happen before the dataset is copied, as the copies do not share the column map.
+	 */
+	void loadSpectraSchema(DatasetSchema& schema);
+
+	/**
+	 * @brief Writes the spectra at index to preallocated memory, see parseSpectra for the layout
+	 *
+	 * This uses the in place parser and falls back to eis::Spectra only for files it dose not handle.
+	 */
+	void fillSpectraAtIndex(size_t index, float* input, float* extraInputs, float* target);
 };
@@ -0,0 +1,204 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "packeddataset.h"
+
+#include <cstring>
+#include <fstream>
+
+#include "log.h"
+#include "tensoroptions.h"
+
+static bool readString(const char*& pos, const char* end, std::string& out)
+{
+	uint32_t length;
+	if(static_cast<size_t>(end - pos) < sizeof(length))
+		return false;
+	std::memcpy(&length, pos, sizeof(length));
+	pos += sizeof(length);
+	if(static_cast<size_t>(end - pos) < length)
+		return false;
+	out.assign(pos, length);
+	pos += length;
+	return true;
+}
+
+EisPackedDataset::EisPackedDataset(const std::filesystem::path& path)
+{
+	try
+	{
+		file = std::make_shared<const MappedFile>(path, MappedFile::ACCESS_RANDOM);
+	}
+	catch(const MappedFile::mmap_error& err)
+	{
+		throw dataset_error(err.what());
+	}
+
+	if(file->size() < sizeof(header))
+		throw dataset_error(path.string() + " is not a packed spectra file");
+	std::memcpy(&header, file->begin(), sizeof(header));
+	if(!packedHeaderValid(header))
+		throw dataset_error(path.string() + " is not a packed spectra file or was created by a incompatible version");
+	if(header.dataOffset > file->size() || (file->size() - header.dataOffset)/header.rowStride < header.count)
+		throw dataset_error(path.string() + " is truncated");
+
+	const char* pos = file->begin() + sizeof(header);
+	const char* end = file->begin() + header.dataOffset;
+
+	// the counts are checked against the remaining space before anything is allocated for them,
+	// every output takes at least a string length and a class count, every extra input a string length and a width
+	if(header.frequencyCount > static_cast<size_t>(end - pos)/sizeof(float))
+		throw dataset_error(path.string() + " has a corrupt header");
+	const size_t remaining = static_cast<size_t>(end - pos) - header.frequencyCount*sizeof(float);
+	if(header.outputCount > remaining/(sizeof(uint32_t) + sizeof(double)) ||
+		header.extraInputCount > remaining/(sizeof(uint32_t) + sizeof(int64_t)))
+		throw dataset_error(path.string() + " has a corrupt header");
+	if(header.frequencyCount > 0)
+	{
+		frequencyTensor = torch::empty({static_cast<int64_t>(header.frequencyCount)}, tensorOptCpu<float>(false));
+		std::memcpy(frequencyTensor.data_ptr<float>(), pos, header.frequencyCount*sizeof(float));
+		pos += header.frequencyCount*sizeof(float);
+	}
+
+	bool valid = true;
+	outputNames.resize(header.outputCount);
+	for(size_t i = 0; i < header.outputCount && valid; ++i)
+		valid = readString(pos, end, outputNames[i]);
+	extraInputList.resize(header.extraInputCount);
+	for(size_t i = 0; i < header.extraInputCount && valid; ++i)
+	{
+		valid = readString(pos, end, extraInputList[i].first) && static_cast<size_t>(end - pos) >= sizeof(int64_t);
+		if(valid)
+		{
+			std::memcpy(&extraInputList[i].second, pos, sizeof(int64_t));
+			pos += sizeof(int64_t);
+		}
+	}
+	valid = valid && readString(pos, end, targetModel);
+	valid = valid && static_cast<size_t>(end - pos) >= header.outputCount*sizeof(double);
+	if(!valid)
+		throw dataset_error(path.string() + " has a corrupt header");
+	classCountList.resize(header.outputCount);
+	std::memcpy(classCountList.data(), pos, header.outputCount*sizeof(double));
+
+	Log(Log::DEBUG)<<"Loaded packed dataset "<<path<<" with "<<header.count<<" examples of width "<<header.inputSize;
+}
+
+bool EisPackedDataset::isRegressionFile(const std::filesystem::path& path)
+{
+	PackedHeader header;
+	std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+	if(!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		return false;
+	return packedHeaderValid(header) && header.flags & PACKED_FLAG_REGRESSION;
+}
+
+const float* EisPackedDataset::row(size_t index) const
+{
+	if(index >= header.count)
+		throw dataset_error("index " + std::to_string(index) + " is out of range for dataset");
+	return reinterpret_cast<const float*>(file->begin() + header.dataOffset + index*header.rowStride);
+}
+
+torch::data::Example<torch::Tensor, torch::Tensor> EisPackedDataset::getImpl(size_t index)
+{
+	// the rows are copied out of the mapping, as it is read only and callers may modify the returned tensors in place
+	const float* data = row(index);
+	torch::Tensor input = torch::empty({static_cast<int64_t>(header.inputSize)}, tensorOptCpu<float>(false));
+	std::memcpy(input.data_ptr<float>(), data, header.inputSize*sizeof(float));
+
+	torch::Tensor target;
+	if(isMulticlass())
+	{
+		target = torch::empty({static_cast<int64_t>(header.targetSize)}, tensorOptCpu<float>(false));
+		std::memcpy(target.data_ptr<float>(), data + header.inputSize, header.targetSize*sizeof(float));
+	}
+	else
+	{
+		target = torch::empty({1}, tensorOptCpu<long>(false));
+		target.data_ptr<int64_t>()[0] = static_cast<int64_t>(data[header.inputSize]);
+	}
+
+	return torch::data::Example<torch::Tensor, torch::Tensor>(input, target);
+}
+
+void EisPackedDataset::getImplToRow(size_t index, torch::Tensor& inputs, torch::Tensor& targets, int64_t batchRow)
+{
+	const float* data = row(index);
+	std::memcpy(inputs.data_ptr<float>() + batchRow*header.inputSize, data, header.inputSize*sizeof(float));
+	if(isMulticlass())
+		std::memcpy(targets.data_ptr<float>() + batchRow*header.targetSize, data + header.inputSize, header.targetSize*sizeof(float));
+	else
+		targets.data_ptr<int64_t>()[batchRow] = static_cast<int64_t>(data[header.inputSize]);
+}
+
+c10::optional<size_t> EisPackedDataset::size() const
+{
+	return header.count;
+}
+
+size_t EisPackedDataset::outputSize() const
+{
+	return header.outputCount;
+}
+
+std::string EisPackedDataset::outputName(size_t output)
+{
+	if(output >= outputNames.size())
+		return "invalid";
+	return outputNames[output];
+}
+
+bool EisPackedDataset::isMulticlass()
+{
+	return header.flags & PACKED_FLAG_MULTICLASS;
+}
+
+torch::Tensor EisPackedDataset::classCounts()
+{
+	torch::Tensor out = torch::empty({static_cast<int64_t>(classCountList.size())}, tensorOptCpu<long>(false));
+	for(size_t i = 0; i < classCountList.size(); ++i)
+		out[i] = static_cast<int64_t>(classCountList[i]);
+	return out;
+}
+
+size_t EisPackedDataset::inputSize()
+{
+	return header.inputSize;
+}
+
+std::vector<std::pair<std::string, int64_t>> EisPackedDataset::extraInputs()
+{
+	return extraInputList;
+}
+
+c10::optional<torch::Tensor> EisPackedDataset::frequencies()
+{
+	if(!frequencyTensor.defined())
+		return c10::optional<torch::Tensor>();
+	return frequencyTensor;
+}
+
+const std::string EisPackedDataset::targetName()
+{
+	if(targetModel.empty())
+		return "Unkown";
+	return targetModel;
+}
@@ -0,0 +1,70 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "mappedfile.h"
+#include "data/packedformat.h"
+#include "data/regressiondataset.h"
+
+/**
+ * @brief Dataset backed by a file in the packed spectra format created by torchkissann_pack.
+ *
+ * Examples are returned as tensors that directly view the mapped file, no parsing is done at load time.
+ */
+class EisPackedDataset : public RegressionDataset<EisPackedDataset>
+{
+private:
+	std::shared_ptr<const MappedFile> file;
+	PackedHeader header;
+	torch::Tensor frequencyTensor;
+	std::vector<std::string> outputNames;
+	std::vector<std::pair<std::string, int64_t>> extraInputList;
+	std::string targetModel;
+	std::vector<double> classCountList;
+
+	const float* row(size_t index) const;
+
+protected:
+	virtual torch::data::Example<torch::Tensor, torch::Tensor> getImpl(size_t index) override;
+	virtual void getImplToRow(size_t index, torch::Tensor& inputs, torch::Tensor& targets, int64_t batchRow) override;
+
+public:
+	explicit EisPackedDataset(const std::filesystem::path& path);
+	EisPackedDataset(const EisPackedDataset& in) = default;
+
+	static bool isRegressionFile(const std::filesystem::path& path);
+
+	virtual c10::optional<size_t> size() const override;
+	virtual size_t outputSize() const override;
+	virtual std::string outputName(size_t output) override;
+	virtual bool isMulticlass() override;
+	virtual torch::Tensor classCounts() override;
+	virtual size_t inputSize() override;
+	virtual std::vector<std::pair<std::string, int64_t>> extraInputs() override;
+	virtual c10::optional<torch::Tensor> frequencies() override;
+	virtual const std::string targetName() override;
+};
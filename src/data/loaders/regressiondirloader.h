@@ -32,6 +32,10 @@ public DirDataset, public RegressionDataset<RegressionLoaderDir>
 {
 protected:
 	virtual torch::data::Example<torch::Tensor, torch::Tensor> getImpl(size_t index) override;
+	virtual DatasetSchema loadSchema() override;
+	virtual void getImplToRow(size_t index, torch::Tensor& inputs, torch::Tensor& targets, int64_t row) override;
+	virtual std::filesystem::path sourcePath() const override;
+	virtual void prefetchBatch(const std::vector<size_t>& indices) override;
 
 	size_t outputCount;
 
@@ -42,7 +46,4 @@ public:
 	virtual std::string outputName(size_t output) override;
 	virtual c10::optional<size_t> size() const override;
 	virtual bool isMulticlass() override;
-	virtual std::vector<std::pair<std::string, int64_t>> extraInputs() override;
-	virtual const std::string targetName() override;
-	virtual c10::optional<torch::Tensor> frequencies() override;
 };
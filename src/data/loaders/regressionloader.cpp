@@ -31,49 +31,33 @@
 
 RegressionLoaderTar::RegressionLoaderTar(const std::filesystem::path& pathI)
 {
-	loadTar(pathI);
+	DatasetIndex index;
+	if(!loadTar(pathI, index))
+		index.save(pathI);
 
-	outputCount = getExtraInputsAndLabelNames(loadSpectraAtIndex(0)).second.size();
-
-	if(files->size() > 0)
-		getImpl(0);
+	outputCount = getSchema().labelNames.size();
 }
 
 torch::data::Example<torch::Tensor, torch::Tensor> RegressionLoaderTar::getImpl(size_t index)
 {
-	eis::Spectra spectra = loadSpectraAtIndex(index);
-	auto pair = getExtraInputsAndLabelNames(spectra);
-	std::vector<std::string> labelNames = pair.second;
-	std::vector<std::string> extraInputNames = pair.first;
+	torch::Tensor input = torch::empty({static_cast<int64_t>(getSchema().inputSize)}, tensorOptCpu<float>(false));
+	torch::Tensor output = torch::empty({static_cast<int64_t>(outputCount)}, tensorOptCpu<float>(false));
 
-	torch::Tensor input;
-	if(extraInputNames.empty())
-	{
-		 input = eisToTorch(spectra.data);
-	}
-	else
-	{
-		std::vector<fvalue> extraInputs;
-		for(const std::string& name : labelNames)
-			extraInputs.push_back(spectra.getLabel(name));
-		input = eisToTorchExtra(spectra.data, extraInputs);
-	}
+	float* inputPtr = input.data_ptr<float>();
+	fillSpectraAtIndex(index, inputPtr, inputPtr + columns.pointCount*2, output.data_ptr<float>());
 
-	torch::TensorOptions options;
-	options = options.layout(torch::kStrided);
-	options = options.device(torch::kCPU);
-	options = options.dtype(torch::kFloat32);
-	torch::Tensor output = torch::empty({static_cast<int64_t>(labelNames.size())}, options);
+	return torch::data::Example<torch::Tensor, torch::Tensor>(input, output);
+}
 
-	size_t i = 0;
-	auto tensorAccessor = output.accessor<float, 1>();
-	for(const std::string& labelNames : labelNames)
-	{
-		tensorAccessor[i] = spectra.getLabel(labelNames);
-		++i;
-	}
+void RegressionLoaderTar::getImplToRow(size_t index, torch::Tensor& inputs, torch::Tensor& targets, int64_t row)
+{
+	float* inputPtr = inputs.data_ptr<float>() + row*inputs.size(1);
+	fillSpectraAtIndex(index, inputPtr, inputPtr + columns.pointCount*2, targets.data_ptr<float>() + row*targets.size(1));
+}
 
-	return torch::data::Example<torch::Tensor, torch::Tensor>(input, output);
+std::filesystem::path RegressionLoaderTar::sourcePath() const
+{
+	return getPath();
 }
 
 size_t RegressionLoaderTar::outputSize() const
@@ -88,7 +72,9 @@ c10::optional<size_t> RegressionLoaderTar::size() const
 
 std::string RegressionLoaderTar::outputName(size_t output)
 {
-	std::vector<std::string> labelNames = getExtraInputsAndLabelNames(loadSpectraAtIndex(0)).second;
+	const std::vector<std::string>& labelNames = getSchema().labelNames;
+	if(output >= labelNames.size())
+		return "invalid";
 	return labelNames[output];
 }
 
@@ -97,20 +83,14 @@ bool RegressionLoaderTar::isMulticlass()
 	return true;
 }
 
-c10::optional<torch::Tensor> RegressionLoaderTar::frequencies()
-{
-	return EisSpectraDataset::frequencies();
-}
-
-std::vector<std::pair<std::string, int64_t>> RegressionLoaderTar::extraInputs()
-{
-	return TarDataset::extraInputs();
-}
-
-const std::string RegressionLoaderTar::targetName()
+DatasetSchema RegressionLoaderTar::loadSchema()
 {
-	eis::Spectra spectra = loadSpectraAtIndex(0);
-	if(spectra.model.empty())
-		return "Unkown";
-	return spectra.model;
+	DatasetSchema schema;
+	if(files->empty())
+		return schema;
+	loadSpectraSchema(schema);
+	schema.inputSize = columns.pointCount*2 + columns.extraCount;
+	schema.targetSize = schema.labelNames.size();
+	schema.targetType = torch::kFloat32;
+	return schema;
 }
@@ -0,0 +1,470 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "syntheticdataset.h"
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <eisgenerator/model.h>
+#include <eisgenerator/translators.h>
+
+#include "log.h"
+#include "modelscript.h"
+#include "randomgen.h"
+#include "tensoroptions.h"
+
+// the statistics are estimated from this many examples, as the dataset can be arbitrarily large
+static constexpr size_t STATS_SAMPLES = 1 << 16;
+
+// the examples generated by the last call to generateBatch on this thread, per dataset
+struct GeneratedBatch
+{
+	std::unordered_map<size_t, size_t> slots;
+	std::vector<float> inputs;
+	std::vector<float> parameters;
+};
+static thread_local std::unordered_map<uint64_t, GeneratedBatch> generatedBatches;
+
+static std::atomic<uint64_t> nextId = 1;
+
+static SyntheticSource::ParameterRange parseRange(const std::string& token)
+{
+	std::istringstream stream(token);
+	std::string start;
+	std::string end;
+	std::string scale;
+	std::getline(stream, start, '~');
+	std::getline(stream, end, '~');
+	std::getline(stream, scale, '~');
+	if(start.empty() || end.empty() || (!scale.empty() && scale != "log"))
+		throw dataset_error("\"" + token + "\" is not a valid parameter range, expected <start>~<end>[~log]");
+
+	SyntheticSource::ParameterRange range = {std::stod(start), std::stod(end), scale == "log"};
+	if(range.log && (range.start <= 0 || range.end <= 0))
+		throw dataset_error("log spaced parameter range \"" + token + "\" must be positive");
+	return range;
+}
+
+SyntheticSource::SyntheticSource(const std::filesystem::path& pathIn): id(nextId++), path(pathIn)
+{
+	loadSpec(path);
+}
+
+void SyntheticSource::loadSpec(const std::filesystem::path& path)
+{
+	std::ifstream file(path);
+	if(!file.is_open())
+		throw dataset_error("Unable to open synthetic dataset description " + path.string());
+
+	std::shared_ptr<std::vector<Model>> loaded = std::make_shared<std::vector<Model>>();
+	models = loaded;
+	double omegaStart = 1;
+	double omegaEnd = 1e6;
+	int64_t omegaCount = 50;
+
+	std::string line;
+	size_t lineNumber = 0;
+	std::vector<std::pair<std::string, std::vector<std::string>>> modelLines;
+	while(std::getline(file, line))
+	{
+		++lineNumber;
+		std::istringstream stream(line);
+		std::string directive;
+		if(!(stream>>directive) || directive[0] == '#')
+			continue;
+
+		std::vector<std::string> arguments;
+		std::string argument;
+		while(stream>>argument)
+			arguments.push_back(argument);
+
+		try
+		{
+			if(directive == "frequencies" && arguments.size() == 3)
+			{
+				omegaStart = std::stod(arguments[0]);
+				omegaEnd = std::stod(arguments[1]);
+				omegaCount = std::stol(arguments[2]);
+			}
+			else if(directive == "size" && arguments.size() == 1)
+			{
+				exampleCount = std::stoull(arguments[0]);
+			}
+			else if(directive == "seed" && arguments.size() == 1)
+			{
+				seed = std::stoull(arguments[0]);
+			}
+			else if(directive == "model" && !arguments.empty())
+			{
+				modelLines.push_back({arguments[0], std::vector<std::string>(arguments.begin() + 1, arguments.end())});
+			}
+			else
+			{
+				throw dataset_error("invalid directive \"" + line + "\"");
+			}
+		}
+		catch(const std::logic_error&)
+		{
+			throw dataset_error(path.string() + ":" + std::to_string(lineNumber) + ": invalid number in \"" + line + "\"");
+		}
+		catch(const dataset_error& err)
+		{
+			throw dataset_error(path.string() + ":" + std::to_string(lineNumber) + ": " + err.what());
+		}
+	}
+
+	if(omegaStart <= 0 || omegaEnd <= 0 || omegaCount < 2)
+		throw dataset_error(path.string() + ": the frequencies must be positive and at least 2 points are required");
+	omegas = torch::logspace(std::log10(omegaStart), std::log10(omegaEnd), omegaCount, 10, tensorOptCpu<fvalue>(false));
+
+	std::vector<std::string> modelStrs;
+	for(const std::pair<std::string, std::vector<std::string>>& modelLine : modelLines)
+	{
+		addModel(*loaded, modelLine.first, modelLine.second);
+		modelStrs.push_back(modelLine.first);
+	}
+
+	if(loaded->empty())
+		throw dataset_error(path.string() + " does not list any models");
+	simulator = std::make_shared<const CircuitSimulator>(modelStrs);
+
+	Log(Log::INFO)<<"Generating "<<exampleCount<<" examples from "<<loaded->size()<<" models";
+}
+
+void SyntheticSource::addModel(std::vector<Model>& loaded, const std::string& modelStr, const std::vector<std::string>& rangeTokens) const
+{
+	Model model;
+	model.modelStr = modelStr;
+
+	try
+	{
+		eis::Model eisModel(modelStr);
+
+		size_t count = eisModel.getParameterCount();
+		if(rangeTokens.empty())
+		{
+			for(const eis::Range& range : eisModel.getDefaultParameters())
+				model.ranges.push_back({range.start, range.end, range.log && range.start > 0 && range.end > 0});
+		}
+		else
+		{
+			for(const std::string& token : rangeTokens)
+				model.ranges.push_back(parseRange(token));
+		}
+
+		if(model.ranges.size() != count)
+		{
+			throw dataset_error("model " + modelStr + " has " + std::to_string(count) + " parameters but " +
+				std::to_string(model.ranges.size()) + " ranges were given");
+		}
+	}
+	catch(const dataset_error&)
+	{
+		throw;
+	}
+	catch(const std::exception& err)
+	{
+		throw dataset_error("unable to load model " + modelStr + ": " + err.what());
+	}
+
+	model.className = modelStr;
+	eis::purgeEisParamBrackets(model.className);
+
+	// additive recurrence with the generalized golden ratio of the dimension, see Roberts 2018
+	const size_t dimensions = model.ranges.size();
+	double phi = 2;
+	for(int i = 0; i < 32; ++i)
+		phi = std::pow(1 + phi, 1.0/(dimensions + 1));
+
+	std::vector<float> offset(dimensions);
+	rd::Philox(seed, loaded.size()).uniform(offset.data(), offset.size(), 0);
+	for(size_t i = 0; i < dimensions; ++i)
+	{
+		model.step.push_back(std::fmod(std::pow(1/phi, i + 1), 1.0));
+		model.offset.push_back(offset[i]);
+	}
+
+	loaded.push_back(std::move(model));
+}
+
+size_t SyntheticSource::modelForIndex(size_t index) const
+{
+	return index % models->size();
+}
+
+size_t SyntheticSource::parameterCount() const
+{
+	size_t count = 0;
+	for(const Model& model : *models)
+		count = std::max(count, model.ranges.size());
+	return count;
+}
+
+void SyntheticSource::sampleParameters(size_t index, float* parameters) const
+{
+	const Model& model = (*models)[modelForIndex(index)];
+	const double point = static_cast<double>(index/models->size());
+	for(size_t i = 0; i < model.ranges.size(); ++i)
+	{
+		double value = model.offset[i] + point*model.step[i];
+		value -= std::floor(value);
+
+		const ParameterRange& range = model.ranges[i];
+		if(range.log)
+			parameters[i] = std::exp(std::log(range.start) + value*(std::log(range.end) - std::log(range.start)));
+		else
+			parameters[i] = range.start + value*(range.end - range.start);
+	}
+}
+
+void SyntheticSource::generate(const std::vector<size_t>& indices, float* inputs, float* parameters, size_t parameterStride) const
+{
+	torch::NoGradGuard noGrad;
+	const int64_t points = omegas.numel();
+	const int64_t rows = indices.size();
+	const int64_t width = simulator->getParameterCount();
+
+	// rows of models with fewer parameters are padded at the end, the simulator ignores the padding
+	torch::Tensor parameterTensor = torch::zeros({rows, width}, tensorOptCpu<fvalue>(false));
+	torch::Tensor modelIds = torch::empty({rows}, tensorOptCpu<int64_t>(false));
+	fvalue* parameterPtr = parameterTensor.data_ptr<fvalue>();
+	int64_t* modelIdPtr = modelIds.data_ptr<int64_t>();
+	for(int64_t row = 0; row < rows; ++row)
+	{
+		sampleParameters(indices[row], parameterPtr + row*width);
+		modelIdPtr[row] = modelForIndex(indices[row]);
+		if(parameters)
+			std::copy(parameterPtr + row*width, parameterPtr + (row + 1)*width, parameters + row*parameterStride);
+	}
+
+	torch::Tensor spectra = simulator->simulate(parameterTensor, modelIds, omegas);
+	torch::Tensor real = torch::real(spectra).to(torch::kFloat32).contiguous();
+	torch::Tensor imag = torch::imag(spectra).to(torch::kFloat32).contiguous();
+	const float* realPtr = real.data_ptr<float>();
+	const float* imagPtr = imag.data_ptr<float>();
+
+	for(int64_t row = 0; row < rows; ++row)
+	{
+		float* input = inputs + row*points*2;
+		for(int64_t i = 0; i < points; ++i)
+		{
+			float realValue = realPtr[row*points + i];
+			float imagValue = imagPtr[row*points + i];
+			input[i] = std::isfinite(realValue) ? realValue : 0;
+			input[i + points] = std::isfinite(imagValue) ? imagValue : 0;
+		}
+	}
+}
+
+void SyntheticSource::generateBatch(const std::vector<size_t>& indices)
+{
+	GeneratedBatch& batch = generatedBatches[id];
+	const size_t parameterStride = parameterCount();
+	batch.slots.clear();
+	batch.inputs.resize(indices.size()*omegas.numel()*2);
+	batch.parameters.resize(indices.size()*parameterStride);
+	for(size_t i = 0; i < indices.size(); ++i)
+		batch.slots[indices[i]] = i;
+
+	generate(indices, batch.inputs.data(), batch.parameters.data(), parameterStride);
+}
+
+void SyntheticSource::fillExample(size_t index, float* input, float* parameters) const
+{
+	if(index >= exampleCount)
+		throw dataset_error("index " + std::to_string(index) + " is out of range for dataset");
+
+	const size_t width = omegas.numel()*2;
+	const size_t parameterStride = parameterCount();
+	auto batch = generatedBatches.find(id);
+	if(batch != generatedBatches.end())
+	{
+		auto slot = batch->second.slots.find(index);
+		if(slot != batch->second.slots.end())
+		{
+			const float* generated = batch->second.inputs.data() + slot->second*width;
+			std::copy(generated, generated + width, input);
+			if(parameters)
+			{
+				const float* generatedParameters = batch->second.parameters.data() + slot->second*parameterStride;
+				std::copy(generatedParameters, generatedParameters + (*models)[modelForIndex(index)].ranges.size(), parameters);
+			}
+			return;
+		}
+	}
+
+	generate({index}, input, parameters, parameterStride);
+}
+
+void SyntheticSource::fillSchema(DatasetSchema& schema) const
+{
+	schema.frequencies = omegas.clone();
+	schema.inputSize = omegas.numel()*2;
+}
+
+EisSyntheticDataset::EisSyntheticDataset(const std::filesystem::path& path): SyntheticSource(path)
+{
+	getSchema();
+}
+
+torch::data::Example<torch::Tensor, torch::Tensor> EisSyntheticDataset::getImpl(size_t index)
+{
+	torch::Tensor input = torch::empty({static_cast<int64_t>(getSchema().inputSize)}, tensorOptCpu<float>(false));
+	fillExample(index, input.data_ptr<float>(), nullptr);
+	return torch::data::Example<torch::Tensor, torch::Tensor>(input, EisSyntheticDataset::getTargetImpl(index));
+}
+
+torch::Tensor EisSyntheticDataset::getTargetImpl(size_t index)
+{
+	torch::Tensor output = torch::empty({1}, tensorOptCpu<int64_t>(false));
+	output.data_ptr<int64_t>()[0] = modelForIndex(index);
+	return output;
+}
+
+void EisSyntheticDataset::getImplToRow(size_t index, torch::Tensor& inputs, torch::Tensor& targets, int64_t row)
+{
+	fillExample(index, inputs.data_ptr<float>() + row*inputs.size(1), nullptr);
+	targets.data_ptr<int64_t>()[row] = modelForIndex(index);
+}
+
+void EisSyntheticDataset::prefetchBatch(const std::vector<size_t>& indices)
+{
+	generateBatch(indices);
+}
+
+DatasetStats EisSyntheticDataset::computeStats()
+{
+	// the first examples already cover the parameter space evenly
+	return statsOfFirst(std::min(exampleCount, STATS_SAMPLES));
+}
+
+DatasetSchema EisSyntheticDataset::loadSchema()
+{
+	DatasetSchema schema;
+	fillSchema(schema);
+	schema.targetSize = 1;
+	schema.targetType = torch::kInt64;
+	return schema;
+}
+
+c10::optional<size_t> EisSyntheticDataset::size() const
+{
+	return exampleCount;
+}
+
+size_t EisSyntheticDataset::outputSize() const
+{
+	return models->size();
+}
+
+std::string EisSyntheticDataset::outputName(size_t output)
+{
+	if(output >= models->size())
+		return "invalid";
+	return (*models)[output].className;
+}
+
+torch::Tensor EisSyntheticDataset::classCounts()
+{
+	const int64_t classes = models->size();
+	torch::Tensor out = torch::full({classes}, static_cast<int64_t>(exampleCount/classes), tensorOptCpu<int64_t>(false));
+	out.narrow(0, 0, exampleCount % classes).add_(1);
+	return out;
+}
+
+RegressionLoaderSynthetic::RegressionLoaderSynthetic(const std::filesystem::path& path): SyntheticSource(path)
+{
+	if(models->size() != 1)
+		throw dataset_error("a synthetic regression dataset must use exactly one model, " + path.string() + " lists " + std::to_string(models->size()));
+	getSchema();
+}
+
+torch::data::Example<torch::Tensor, torch::Tensor> RegressionLoaderSynthetic::getImpl(size_t index)
+{
+	torch::Tensor input = torch::empty({static_cast<int64_t>(getSchema().inputSize)}, tensorOptCpu<float>(false));
+	torch::Tensor output = torch::empty({static_cast<int64_t>(outputSize())}, tensorOptCpu<float>(false));
+	fillExample(index, input.data_ptr<float>(), output.data_ptr<float>());
+	return torch::data::Example<torch::Tensor, torch::Tensor>(input, output);
+}
+
+void RegressionLoaderSynthetic::getImplToRow(size_t index, torch::Tensor& inputs, torch::Tensor& targets, int64_t row)
+{
+	fillExample(index, inputs.data_ptr<float>() + row*inputs.size(1), targets.data_ptr<float>() + row*targets.size(1));
+}
+
+void RegressionLoaderSynthetic::prefetchBatch(const std::vector<size_t>& indices)
+{
+	generateBatch(indices);
+}
+
+DatasetStats RegressionLoaderSynthetic::computeStats()
+{
+	// the first examples already cover the parameter space evenly
+	DatasetStats stats = statsOfFirst(std::min(exampleCount, STATS_SAMPLES));
+
+	// the target scales are derived from the range, which is known exactly
+	const std::vector<ParameterRange>& ranges = models->front().ranges;
+	for(size_t i = 0; i < ranges.size(); ++i)
+	{
+		stats.targets.min[i] = std::min(ranges[i].start, ranges[i].end);
+		stats.targets.max[i] = std::max(ranges[i].start, ranges[i].end);
+	}
+	return stats;
+}
+
+DatasetSchema RegressionLoaderSynthetic::loadSchema()
+{
+	DatasetSchema schema;
+	fillSchema(schema);
+	const Model& model = models->front();
+	for(size_t i = 0; i < model.ranges.size(); ++i)
+		schema.labelNames.push_back(model.className + "_" + std::to_string(i));
+	schema.targetSize = model.ranges.size();
+	schema.targetType = torch::kFloat32;
+	schema.targetModel = model.modelStr;
+	return schema;
+}
+
+size_t RegressionLoaderSynthetic::outputSize() const
+{
+	return models->front().ranges.size();
+}
+
+std::string RegressionLoaderSynthetic::outputName(size_t output)
+{
+	const std::vector<std::string>& labelNames = getSchema().labelNames;
+	if(output >= labelNames.size())
+		return "invalid";
+	return labelNames[output];
+}
+
+c10::optional<size_t> RegressionLoaderSynthetic::size() const
+{
+	return exampleCount;
+}
+
+bool RegressionLoaderSynthetic::isMulticlass()
+{
+	return true;
+}
@@ -0,0 +1,147 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+#include <torch/torch.h>
+
+#include "data/eisdataset.h"
+#include "data/regressiondataset.h"
+#include "modelscript.h"
+
+/**
+ * @brief Generates spectra on demand from a list of eisgenerator models instead of reading them from disk.
+ *
+ * The dataset is described by a text file with one directive per line, empty lines and lines starting with # are ignored:
+ *
+ *     frequencies <start> <end> <count>    log spaced angular frequencies the spectra are evaluated at, default: 1 1e6 50
+ *     size <count>                         number of examples, default: 1048576
+ *     seed <number>                        decorrelates the parameters of datasets with the same models, default: 0
+ *     model <model string> [<start>~<end>[~log] ...]
+ *
+ * Without explicit ranges the parameters of a model are drawn from its default parameter ranges.
+ * Example index i uses model i % models and the (i / models)th point of a quasi random
+ * (additive recurrence) sequence over the parameter ranges of that model, so examples are reproducible
+ * and any prefix of the dataset covers the ranges evenly. The spectra of a whole batch are computed at once
+ * by a CircuitSimulator.
+ */
+class SyntheticSource
+{
+public:
+	struct ParameterRange
+	{
+		double start;
+		double end;
+		bool log;
+	};
+
+	struct Model
+	{
+		std::string modelStr;
+		// the model without its parameters, used as class name
+		std::string className;
+		std::vector<ParameterRange> ranges;
+		// increment and random start of the quasi random sequence per parameter
+		std::vector<double> step;
+		std::vector<double> offset;
+	};
+
+private:
+	// identifies the batches generated by generateBatch, copies of a dataset share it as they share the models
+	uint64_t id;
+
+	void loadSpec(const std::filesystem::path& path);
+	void addModel(std::vector<Model>& loaded, const std::string& modelStr, const std::vector<std::string>& rangeTokens) const;
+	void generate(const std::vector<size_t>& indices, float* inputs, float* parameters, size_t parameterStride) const;
+
+protected:
+	std::filesystem::path path;
+	std::shared_ptr<const std::vector<Model>> models;
+	std::shared_ptr<const CircuitSimulator> simulator;
+	torch::Tensor omegas;
+	size_t exampleCount = 1 << 20;
+	uint64_t seed = 0;
+
+	explicit SyntheticSource(const std::filesystem::path& path);
+
+	size_t modelForIndex(size_t index) const;
+	void sampleParameters(size_t index, float* parameters) const;
+	size_t parameterCount() const;
+
+	/**
+	 * @brief Generates the examples of the given indices at once, later fills of these indices on the same thread use them
+	 *
+	 * The data stays valid until the next call to generateBatch on the same thread.
+	 */
+	void generateBatch(const std::vector<size_t>& indices);
+
+	/**
+	 * @brief Writes the spectra of example index to input and, if parameters is not null, the parameters it was generated with
+	 */
+	void fillExample(size_t index, float* input, float* parameters) const;
+
+	void fillSchema(DatasetSchema& schema) const;
+};
+
+class EisSyntheticDataset: public SyntheticSource, public EisDataset<EisSyntheticDataset>
+{
+private:
+	virtual torch::data::Example<torch::Tensor, torch::Tensor> getImpl(size_t index) override;
+	virtual torch::Tensor getTargetImpl(size_t index) override;
+	virtual DatasetSchema loadSchema() override;
+	virtual void getImplToRow(size_t index, torch::Tensor& inputs, torch::Tensor& targets, int64_t row) override;
+	virtual void prefetchBatch(const std::vector<size_t>& indices) override;
+	virtual DatasetStats computeStats() override;
+
+public:
+	explicit EisSyntheticDataset(const std::filesystem::path& path);
+	EisSyntheticDataset(const EisSyntheticDataset& in) = default;
+	virtual ~EisSyntheticDataset() = default;
+
+	virtual c10::optional<size_t> size() const override;
+	virtual size_t outputSize() const override;
+	virtual std::string outputName(size_t output) override;
+	virtual torch::Tensor classCounts() override;
+};
+
+/**
+ * @brief Synthetic dataset with a single model whose targets are the parameters the spectra were generated with
+ */
+class RegressionLoaderSynthetic: public SyntheticSource, public RegressionDataset<RegressionLoaderSynthetic>
+{
+protected:
+	virtual torch::data::Example<torch::Tensor, torch::Tensor> getImpl(size_t index) override;
+	virtual DatasetSchema loadSchema() override;
+	virtual void getImplToRow(size_t index, torch::Tensor& inputs, torch::Tensor& targets, int64_t row) override;
+	virtual void prefetchBatch(const std::vector<size_t>& indices) override;
+	virtual DatasetStats computeStats() override;
+
+public:
+	explicit RegressionLoaderSynthetic(const std::filesystem::path& path);
+
+	virtual size_t outputSize() const override;
+	virtual std::string outputName(size_t output) override;
+	virtual c10::optional<size_t> size() const override;
+	virtual bool isMulticlass() override;
+};
@@ -17,136 +17,165 @@
 //
 // You should have received a copy of the GNU General Public License
 // along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
-//
 
 #include "tardataset.h"
 #include "data/eisdataset.h"
 #include "indicators.hpp"
-#include "microtar.h"
+#include "memstream.h"
+#include "tarscan.h"
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
+#include <future>
 
-TarDataset::~TarDataset()
-{
-	if(open)
-		mtar_close(&tar);
-}
-
-TarDataset::TarDataset(const TarDataset& in)
-{
-	operator=(in);
-}
-
-TarDataset& TarDataset::operator=(const TarDataset& in)
+static void scanTar(const std::filesystem::path& path, const CompressedArchive* compressed, std::vector<DatasetIndex::Entry>& files)
 {
-	files = in.files;
-	path = in.path;
-	if(open)
-		mtar_close(&tar);
-	if(in.open)
+	try
 	{
-		int ret = mtar_open(&tar, path.c_str(), "r");
-		if(ret != 0)
-			throw dataset_error("Unable to reopen tar file at " + path.string());
-		open = true;
-	}
+		std::unique_ptr<TarScanner> scannerPtr;
+		if(compressed)
+		{
+			// the scanning threads each decompress the frames of their own range
+			scannerPtr = std::make_unique<TarScanner>([compressed](char* buffer, size_t size, uint64_t offset)
+			{
+				return compressed->read(buffer, size, offset);
+			}, compressed->size(), path.string());
+		}
+		else
+		{
+			scannerPtr = std::make_unique<TarScanner>(path);
+		}
+		TarScanner& scanner = *scannerPtr;
 
-	return *this;
-}
+		indicators::BlockProgressBar bar(
+			indicators::option::BarWidth(50),
+			indicators::option::PrefixText("Loading " + path.string() + ": "),
+			indicators::option::ShowElapsedTime(true),
+			indicators::option::ShowRemainingTime(true)
+		);
 
-void TarDataset::loadTar(const std::filesystem::path& path)
-{
-	files.reset(new std::vector<File>);
+		indicators::show_console_cursor(false);
 
-	int ret = mtar_open(&tar, path.c_str(), "r");
-	if(ret != 0)
-		throw dataset_error(path.string() + " is not a valid tar archive");
+		std::future<std::vector<TarScanner::Member>> future = std::async(std::launch::async, [&scanner]()
+		{
+			return scanner.scan();
+		});
 
-	this->path = path;
-	open = true;
+		double tarSize = static_cast<double>(std::max<uint64_t>(scanner.size(), 1));
+		while(future.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready)
+			bar.set_progress(std::min(static_cast<float>(scanner.bytesScanned()/tarSize*100), 100.0f));
 
-	mtar_header_t header;
+		bar.mark_as_completed();
+		indicators::show_console_cursor(true);
 
-	indicators::BlockProgressBar bar(
-		indicators::option::BarWidth(50),
-		indicators::option::PrefixText("Loading " + path.string() + ": "),
-		indicators::option::ShowElapsedTime(true),
-		indicators::option::ShowRemainingTime(true)
-	);
+		std::vector<TarScanner::Member> members = future.get();
+		files.reserve(members.size());
+		for(TarScanner::Member& member : members)
+			files.push_back({.path = std::move(member.name), .pos = member.pos, .size = member.size});
+	}
+	catch(const TarScanner::scan_error& err)
+	{
+		indicators::show_console_cursor(true);
+		throw dataset_error(err.what());
+	}
+	catch(const CompressedArchive::archive_error& err)
+	{
+		indicators::show_console_cursor(true);
+		throw dataset_error(err.what());
+	}
+}
 
-	indicators::show_console_cursor(false);
+bool TarDataset::loadTar(const std::filesystem::path& path, DatasetIndex& index)
+{
+	this->path = path;
 
-	double tarSize = static_cast<double>(std::filesystem::file_size(path));
-	size_t progress = 0;
+	bool cached = index.load(path);
 
-	while((mtar_read_header(&tar, &header)) != MTAR_ENULLRECORD)
+	try
 	{
-		if(static_cast<size_t>((tar.pos/tarSize)*100) > progress)
+		if(CompressedArchive::detect(path) != CompressedArchive::FORMAT_NONE)
 		{
-			progress = static_cast<size_t>((tar.pos/tarSize)*100);
-			bar.set_progress(progress);
+			compressed = std::make_shared<const CompressedArchive>(path, index.frames);
+			index.frames = compressed->getFrames();
 		}
-		if(header.type == MTAR_TREG)
-			files->push_back({.path =  header.name, .pos = tar.pos, .size = header.size});
-		mtar_next(&tar);
+		else
+		{
+			archive = std::make_shared<const MappedFile>(path, MappedFile::ACCESS_RANDOM);
+		}
+	}
+	catch(const MappedFile::mmap_error& err)
+	{
+		throw dataset_error(err.what());
+	}
+	catch(const CompressedArchive::archive_error& err)
+	{
+		throw dataset_error(err.what());
 	}
 
-	bar.mark_as_completed();
-	indicators::show_console_cursor(true);
-}
+	if(!cached)
+		scanTar(path, compressed.get(), *index.entries);
+	files = index.entries;
 
-eis::Spectra TarDataset::loadSpectraHeaderAtCurrentPos(size_t size)
-{
-	char* filebuffer = new char[size+1];
-	filebuffer[size] = '\0';
-	int ret = mtar_read_data(&tar, filebuffer, size);
-	if(ret != 0)
+	// the labels are only ever read after this point, so loader threads can check against them without locking
+	if(cached)
 	{
-		Log(Log::ERROR)<<"Unable to read from tar archive";
-		assert(ret == 0);
+		labels = index.labelNames;
+	}
+	else if(!files->empty())
+	{
+		eis::Spectra spectra = loadSpectraAtIndex(0);
+		labels = spectra.labelNames;
+		index.labelNames = spectra.labelNames;
+		index.model = spectra.model;
 	}
-	std::stringstream ss(filebuffer);
 
-	eis::Spectra spectra = eis::Spectra::loadHeaderFromStream(ss);
-	delete[] filebuffer;
+	return cached;
+}
 
-	return spectra;
+const std::filesystem::path& TarDataset::getPath() const
+{
+	return path;
 }
 
-eis::Spectra TarDataset::loadSpectraHeaderAtIndex(size_t index)
+std::string_view TarDataset::fileView(size_t index) const
 {
 	if(!files || index >= files->size())
 		throw dataset_error("index " + std::to_string(index) + " is out of range for dataset");
-	mtar_seek(&tar, (*files)[index].pos);
-	return loadSpectraHeaderAtCurrentPos((*files)[index].size);
+	const File& file = (*files)[index];
+	try
+	{
+		if(compressed)
+			return compressed->view(file.pos, file.size);
+		return archive->view(file.pos, file.size);
+	}
+	catch(const MappedFile::mmap_error& err)
+	{
+		throw dataset_error(std::string("Unable to read from tar archive: ") + err.what());
+	}
+	catch(const CompressedArchive::archive_error& err)
+	{
+		throw dataset_error(std::string("Unable to read from tar archive: ") + err.what());
+	}
 }
 
-eis::Spectra TarDataset::loadSpectraAtCurrentPos(size_t size)
+eis::Spectra TarDataset::loadSpectraHeaderAtIndex(size_t index)
 {
-	char* filebuffer = new char[size+1];
-	filebuffer[size] = '\0';
-	int ret = mtar_read_data(&tar, filebuffer, size);
-	if(ret != 0)
-	{
-		Log(Log::ERROR)<<"Unable to read from tar archive";
-		assert(ret == 0);
-	}
-	std::stringstream ss(filebuffer);
+	MemoryIStream stream(fileView(index));
+	return eis::Spectra::loadHeaderFromStream(stream);
+}
 
-	eis::Spectra spectra = eis::Spectra::loadFromStream(ss);
-	delete[] filebuffer;
+eis::Spectra TarDataset::loadSpectraAtIndex(size_t index)
+{
+	MemoryIStream stream(fileView(index));
+	eis::Spectra spectra = eis::Spectra::loadFromStream(stream);
 
-	if(labels.empty())
-		labels = spectra.labelNames;
-	else if(!std::equal(labels.begin(), labels.end(), spectra.labelNames.begin(), spectra.labelNames.end()))
+	if(!labels.empty() && !std::equal(labels.begin(), labels.end(), spectra.labelNames.begin(), spectra.labelNames.end()))
 		throw dataset_error(std::string("Not all spectra in ") + path.string() + " have the same labels");
 
 	return spectra;
 }
 
-eis::Spectra TarDataset::loadSpectraAtIndex(size_t index)
+std::string_view TarDataset::loadRawSpectraAtIndex(size_t index)
 {
-	if(!files || index >= files->size())
-		throw dataset_error("index " + std::to_string(index) + " is out of range for dataset");
-	mtar_seek(&tar, (*files)[index].pos);
-	return loadSpectraAtCurrentPos((*files)[index].size);
+	return fileView(index);
 }
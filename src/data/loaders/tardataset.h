@@ -22,38 +22,42 @@
 #include <filesystem>
 #include <kisstype/spectra.h>
 #include <memory>
+#include <string_view>
 
-#include "microtar.h"
+#include "compressedarchive.h"
+#include "mappedfile.h"
+#include "data/loaders/datasetindex.h"
 #include "data/loaders/eisspectradataset.h"
 
 class TarDataset: public EisSpectraDataset
 {
 private:
 	std::filesystem::path path;
-	mtar_t tar;
-	bool open = false;
+	std::shared_ptr<const MappedFile> archive;
+	// set instead of archive if the tar is gzip or zstd compressed
+	std::shared_ptr<const CompressedArchive> compressed;
 	std::vector<std::string> labels;
 
 protected:
 
-	struct File
-	{
-		std::string path;
-		size_t pos;
-		size_t size;
-	};
+	typedef DatasetIndex::Entry File;
 	std::shared_ptr<std::vector<File>> files;
 
-	void loadTar(const std::filesystem::path& path);
-	eis::Spectra loadSpectraHeaderAtCurrentPos(size_t size);
-	eis::Spectra loadSpectraAtCurrentPos(size_t size);
+	/**
+	 * @brief Opens the archive, using the sidecar index if it is valid
+	 * @return true if the file list was loaded from the index and is allready saved
+	 */
+	bool loadTar(const std::filesystem::path& path, DatasetIndex& index);
+	const std::filesystem::path& getPath() const;
+	/**
+	 * @brief Gets the contents of the file at index, for compressed archives the view is only valid until the next call from the same thread
+	 */
+	std::string_view fileView(size_t index) const;
 	virtual eis::Spectra loadSpectraHeaderAtIndex(size_t index) override;
 	virtual eis::Spectra loadSpectraAtIndex(size_t index) override;
+	virtual std::string_view loadRawSpectraAtIndex(size_t index) override;
 
 public:
 	TarDataset() = default;
-	TarDataset(const TarDataset& in);
-	virtual ~TarDataset();
-
-	virtual TarDataset& operator=(const TarDataset& in);
+	virtual ~TarDataset() = default;
 };
@@ -35,6 +35,9 @@ private:
 	std::vector<size_t> classIndexes;
 
 	virtual torch::data::Example<torch::Tensor, torch::Tensor> getImpl(size_t index) override;
+	virtual DatasetSchema loadSchema() override;
+	virtual void getImplToRow(size_t index, torch::Tensor& inputs, torch::Tensor& targets, int64_t row) override;
+	virtual std::filesystem::path sourcePath() const override;
 	virtual torch::Tensor getTargetImpl(size_t index) override;
 
 public:
@@ -49,6 +52,4 @@ public:
 	virtual size_t outputSize() const override;
 	virtual std::string outputName(size_t output) override;
 	virtual torch::Tensor classCounts() override;
-	virtual std::vector<std::pair<std::string, int64_t>> extraInputs() override;
-	virtual c10::optional<torch::Tensor> frequencies() override;
 };
@@ -0,0 +1,70 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+/*
+ * Layout of the packed spectra format, all values are in native byte order:
+ *
+ * PackedHeader
+ * float frequencies[frequencyCount]
+ * string table: for every entry a uint32_t length followed by the characters
+ *     outputCount output names (class names or regression label names)
+ *     extraInputCount extra input names, each followed by a int64_t width
+ *     the target model string
+ * double classCounts[outputCount]
+ * padding up to dataOffset
+ * count rows of rowStride bytes each: float input[inputSize], float target[targetSize]
+ */
+
+static constexpr char PACKED_MAGIC[8] = {'E', 'I', 'S', 'P', 'A', 'C', 'K', '\0'};
+static constexpr uint32_t PACKED_VERSION = 1;
+static constexpr uint64_t PACKED_ALIGNMENT = 64;
+
+typedef enum
+{
+	PACKED_FLAG_REGRESSION = 1 << 0,
+	PACKED_FLAG_MULTICLASS = 1 << 1
+} PackedFlags;
+
+struct PackedHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint64_t count;
+	uint64_t inputSize;
+	uint64_t targetSize;
+	uint64_t frequencyCount;
+	uint64_t outputCount;
+	uint64_t extraInputCount;
+	uint64_t dataOffset;
+	uint64_t rowStride;
+};
+
+static inline bool packedHeaderValid(const PackedHeader& header)
+{
+	return std::memcmp(header.magic, PACKED_MAGIC, sizeof(PACKED_MAGIC)) == 0 && header.version == PACKED_VERSION &&
+		header.inputSize > 0 && header.rowStride > 0 &&
+		header.inputSize <= header.rowStride/sizeof(float) && header.targetSize <= header.rowStride/sizeof(float) &&
+		header.rowStride == (header.inputSize + header.targetSize)*sizeof(float) && header.dataOffset % PACKED_ALIGNMENT == 0;
+}
@@ -0,0 +1,146 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "data/eisdataset.h"
+#include "data/packedformat.h"
+#include "data/regressiondataset.h"
+#include "indicators.hpp"
+#include "log.h"
+
+static inline void packWriteString(std::ofstream& file, const std::string& str)
+{
+	uint32_t length = str.size();
+	file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+	file.write(str.data(), length);
+}
+
+/**
+ * @brief Converts any dataset into the packed spectra format read by EisPackedDataset
+ *
+ * @param dataset the dataset to convert
+ * @param path the path of the packed file to create
+ * @param workers the number of threads to use to decode the source dataset
+ * @return true on sucess, false if the file could not be written
+ */
+template <typename DataSelf>
+bool packDataset(EisDataset<DataSelf>* dataset, const std::filesystem::path& path, size_t workers = 8)
+{
+	std::ofstream file(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	if(!file.is_open())
+	{
+		Log(Log::ERROR)<<"Could not open "<<path<<" for writeing";
+		return false;
+	}
+
+	RegressionDataset<DataSelf>* regressionDataset = dynamic_cast<RegressionDataset<DataSelf>*>(dataset);
+	torch::data::Example<torch::Tensor, torch::Tensor> first = dataset->get(0);
+
+	PackedHeader header = {};
+	std::memcpy(header.magic, PACKED_MAGIC, sizeof(PACKED_MAGIC));
+	header.version = PACKED_VERSION;
+	header.flags = (regressionDataset ? PACKED_FLAG_REGRESSION : 0) | (dataset->isMulticlass() ? PACKED_FLAG_MULTICLASS : 0);
+	header.count = dataset->size().value();
+	header.inputSize = first.data.numel();
+	header.targetSize = dataset->isMulticlass() ? first.target.numel() : 1;
+	header.rowStride = (header.inputSize + header.targetSize)*sizeof(float);
+	header.outputCount = dataset->outputSize();
+
+	c10::optional<torch::Tensor> frequencies = dataset->frequencies();
+	torch::Tensor frequencyTensor;
+	if(frequencies)
+	{
+		frequencyTensor = frequencies.value().to(torch::kFloat32).contiguous();
+		header.frequencyCount = frequencyTensor.numel();
+	}
+	std::vector<std::pair<std::string, int64_t>> extraInputs = dataset->extraInputs();
+	header.extraInputCount = extraInputs.size();
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	if(header.frequencyCount > 0)
+		file.write(reinterpret_cast<const char*>(frequencyTensor.data_ptr<float>()), header.frequencyCount*sizeof(float));
+	for(size_t i = 0; i < header.outputCount; ++i)
+		packWriteString(file, dataset->outputName(i));
+	for(const std::pair<std::string, int64_t>& extraInput : extraInputs)
+	{
+		packWriteString(file, extraInput.first);
+		file.write(reinterpret_cast<const char*>(&extraInput.second), sizeof(extraInput.second));
+	}
+	packWriteString(file, regressionDataset ? regressionDataset->targetName() : std::string());
+
+	torch::Tensor classCounts = dataset->classCounts().to(torch::kFloat64).contiguous();
+	file.write(reinterpret_cast<const char*>(classCounts.data_ptr<double>()), header.outputCount*sizeof(double));
+
+	header.dataOffset = file.tellp();
+	header.dataOffset = ((header.dataOffset + PACKED_ALIGNMENT - 1)/PACKED_ALIGNMENT)*PACKED_ALIGNMENT;
+	std::vector<char> padding(header.dataOffset - file.tellp(), 0);
+	file.write(padding.data(), padding.size());
+
+	torch::data::DataLoaderOptions options;
+	options = options.batch_size(256).workers(workers);
+	auto dataLoader = torch::data::make_data_loader<torch::data::samplers::SequentialSampler>(
+		EisBatchDataset<DataSelf>(dataset), options);
+
+	indicators::BlockProgressBar bar(
+		indicators::option::BarWidth(50),
+		indicators::option::PrefixText("Packing spectra: "),
+		indicators::option::ShowElapsedTime(true),
+		indicators::option::ShowRemainingTime(true),
+		indicators::option::MaxProgress(header.count)
+	);
+	indicators::show_console_cursor(false);
+
+	size_t packed = 0;
+	for(auto& batch : *dataLoader)
+	{
+		torch::Tensor inputs = batch.data.reshape({batch.data.size(0), -1});
+		torch::Tensor targets = batch.target.reshape({batch.target.size(0), -1});
+		if(inputs.size(1) != static_cast<int64_t>(header.inputSize) || targets.size(1) != static_cast<int64_t>(header.targetSize))
+		{
+			bar.mark_as_completed();
+			indicators::show_console_cursor(true);
+			Log(Log::ERROR)<<"Examples in dataset are not all of the same size, can not pack";
+			return false;
+		}
+		torch::Tensor rows = torch::cat({inputs.to(torch::kFloat32), targets.to(torch::kFloat32)}, 1).contiguous();
+		file.write(reinterpret_cast<const char*>(rows.data_ptr<float>()), rows.numel()*sizeof(float));
+		packed += rows.size(0);
+		bar.set_progress(static_cast<float>(packed));
+	}
+
+	bar.mark_as_completed();
+	indicators::show_console_cursor(true);
+
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.close();
+	if(file.fail())
+	{
+		Log(Log::ERROR)<<"Failed to write "<<path;
+		return false;
+	}
+	return true;
+}
@@ -35,20 +35,17 @@ public:
 template <typename DataSelf>
 std::pair<torch::Tensor, torch::Tensor> RegressionDataset<DataSelf>::getTargetScalesAndBias()
 {
-	torch::Tensor max = torch::zeros({static_cast<int>(this->outputSize())}, tensorOptCpu<fvalue>(false));
-	torch::Tensor min = torch::full({static_cast<int>(this->outputSize())}, std::numeric_limits<fvalue>::max(),  tensorOptCpu<fvalue>(false));
-
-	for(size_t i = 0; i < this->size().value(); ++i)
-	{
-		torch::Tensor targets = this->getImpl(i).target;
-		max = torch::maximum(targets, max);
-		min = torch::minimum(targets, min);
-	}
+	const ColumnStats& targets = this->getStats().targets;
+	torch::Tensor max = torch::tensor(targets.max, tensorOptCpu<fvalue>(false));
+	torch::Tensor min = torch::tensor(targets.min, tensorOptCpu<fvalue>(false));
 	return {(max-min), min};
 }
 
 template <typename DataSelf> const std::string RegressionDataset<DataSelf>::targetName()
 {
-	return "Unkown";
+	const std::string& model = this->getSchema().targetModel;
+	if(model.empty())
+		return "Unkown";
+	return model;
 }
 
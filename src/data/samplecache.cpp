@@ -0,0 +1,152 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "samplecache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "log.h"
+
+SampleCache::SampleCache(size_t countI, size_t inputSizeI, size_t targetBytesI, size_t ramBudget, const std::filesystem::path& spillDir):
+count(countI), inputSize(inputSizeI), targetBytes(targetBytesI)
+{
+	rowBytes = inputSize*sizeof(float) + targetBytes;
+	rowBytes = (rowBytes + alignof(std::max_align_t) - 1)/alignof(std::max_align_t)*alignof(std::max_align_t);
+	ramRows = rowBytes > 0 ? std::min(count, ramBudget/rowBytes) : count;
+
+	states.reset(new std::atomic<uint8_t>[count]);
+	for(size_t i = 0; i < count; ++i)
+		states[i].store(ROW_EMPTY, std::memory_order_relaxed);
+
+	arenaLength = ramRows*rowBytes;
+	if(arenaLength > 0)
+	{
+		void* ptr = mmap(nullptr, arenaLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if(ptr == MAP_FAILED)
+			throw cache_error(std::string("Unable to allocate cache arena: ") + std::strerror(errno));
+		arena = static_cast<char*>(ptr);
+	}
+
+	spillLength = (count - ramRows)*rowBytes;
+	// the destructor does not run if the constructor throws, so the arena has to be released here
+	try
+	{
+		if(spillLength > 0)
+		{
+			std::string pathTemplate = (spillDir/"torchkissann-cache-XXXXXX").string();
+			int fd = mkstemp(pathTemplate.data());
+			if(fd < 0)
+				throw cache_error("Unable to create cache file in " + spillDir.string() + ": " + std::strerror(errno));
+			// only the mapping is needed, the file is removed again when it is unmapped
+			unlink(pathTemplate.c_str());
+
+			if(ftruncate(fd, spillLength) != 0)
+			{
+				int err = errno;
+				::close(fd);
+				throw cache_error("Unable to size cache file in " + spillDir.string() + ": " + std::strerror(err));
+			}
+
+			void* ptr = mmap(nullptr, spillLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			int err = errno;
+			::close(fd);
+			if(ptr == MAP_FAILED)
+				throw cache_error(std::string("Unable to map cache file: ") + std::strerror(err));
+			spill = static_cast<char*>(ptr);
+			madvise(spill, spillLength, MADV_RANDOM);
+		}
+	}
+	catch(...)
+	{
+		if(arena)
+			munmap(arena, arenaLength);
+		throw;
+	}
+
+	Log(Log::DEBUG)<<"Caching "<<count<<" examples, "<<arenaLength/(1024*1024)<<"MiB in memory and "
+		<<spillLength/(1024*1024)<<"MiB spilled to "<<spillDir;
+}
+
+SampleCache::~SampleCache()
+{
+	if(arena)
+		munmap(arena, arenaLength);
+	if(spill)
+		munmap(spill, spillLength);
+}
+
+char* SampleCache::row(size_t index) const
+{
+	if(index < ramRows)
+		return arena + index*rowBytes;
+	return spill + (index - ramRows)*rowBytes;
+}
+
+bool SampleCache::load(size_t index, float* input, void* target) const
+{
+	if(index >= count || states[index].load(std::memory_order_acquire) != ROW_READY)
+		return false;
+
+	const char* data = row(index);
+	std::memcpy(input, data, inputSize*sizeof(float));
+	std::memcpy(target, data + inputSize*sizeof(float), targetBytes);
+	return true;
+}
+
+void SampleCache::store(size_t index, const float* input, const void* target)
+{
+	if(index >= count)
+		return;
+
+	uint8_t expected = ROW_EMPTY;
+	if(!states[index].compare_exchange_strong(expected, ROW_FILLING, std::memory_order_acquire))
+		return;
+
+	char* data = row(index);
+	std::memcpy(data, input, inputSize*sizeof(float));
+	std::memcpy(data + inputSize*sizeof(float), target, targetBytes);
+	states[index].store(ROW_READY, std::memory_order_release);
+	filledRows.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t SampleCache::size() const
+{
+	return count;
+}
+
+size_t SampleCache::filled() const
+{
+	return filledRows.load(std::memory_order_relaxed);
+}
+
+size_t SampleCache::ramBytes() const
+{
+	return arenaLength;
+}
+
+size_t SampleCache::spillBytes() const
+{
+	return spillLength;
+}
@@ -0,0 +1,96 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+/**
+ * @brief Fixed size row cache for decoded examples.
+ *
+ * Each example occupies one row of inputSize floats followed by targetBytes of target data.
+ * The first rows live in an anonymous memory arena limited by the ram budget, the rest in a scratch
+ * file that is mapped into memory and removed from the file system as soon as it is created.
+ * Rows are filled on first access and never evicted, all methods are thread safe.
+ */
+class SampleCache
+{
+public:
+	class cache_error: public std::exception
+	{
+		std::string whatStr;
+	public:
+		cache_error(const std::string& whatIn): whatStr(whatIn)
+		{}
+		virtual const char* what() const noexcept override
+		{
+			return whatStr.c_str();
+		}
+	};
+
+private:
+	enum : uint8_t
+	{
+		ROW_EMPTY = 0,
+		ROW_FILLING,
+		ROW_READY
+	};
+
+	size_t count;
+	size_t inputSize;
+	size_t targetBytes;
+	size_t rowBytes;
+	size_t ramRows;
+	char* arena = nullptr;
+	size_t arenaLength = 0;
+	char* spill = nullptr;
+	size_t spillLength = 0;
+	std::unique_ptr<std::atomic<uint8_t>[]> states;
+	std::atomic<size_t> filledRows{0};
+
+	char* row(size_t index) const;
+
+public:
+	SampleCache(size_t count, size_t inputSize, size_t targetBytes, size_t ramBudget,
+		const std::filesystem::path& spillDir = std::filesystem::temp_directory_path());
+	SampleCache(const SampleCache&) = delete;
+	SampleCache& operator=(const SampleCache&) = delete;
+	~SampleCache();
+
+	/**
+	 * @brief Copies the cached example index into input and target
+	 * @return false if the example is not cached (yet)
+	 */
+	bool load(size_t index, float* input, void* target) const;
+
+	/**
+	 * @brief Stores example index, does nothing if it is already cached or being cached by another thread
+	 */
+	void store(size_t index, const float* input, const void* target);
+
+	size_t size() const;
+	size_t filled() const;
+	size_t ramBytes() const;
+	size_t spillBytes() const;
+};
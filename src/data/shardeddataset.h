@@ -0,0 +1,282 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "data/regressiondataset.h"
+#include "data/loaders/datasetindex.h"
+#include "shardlist.h"
+#include "log.h"
+
+/**
+ * @brief Presents several datasets of type ShardType, for instance the tar files of one generator run, as one dataset.
+ *
+ * Shards are given as a glob or manifest, see expandShards. Only the first shard is opened up front,
+ * the size and classes of the others are taken from their sidecar indices and the shard itself is opened
+ * on first access. The class tables of classification shards are merged into one table by class name.
+ * Shards are opened once and shared by all threads, the tar and directory loaders keep no per
+ * file read state, so workers can read from any number of shards in parallel.
+ */
+template <typename ShardType>
+class ShardedDataset : public RegressionDataset<ShardedDataset<ShardType>>
+{
+private:
+	struct Shard
+	{
+		std::filesystem::path path;
+		std::once_flag once;
+		std::unique_ptr<ShardType> dataset;
+		// maps the class ids of the shard to the merged class table
+		std::vector<int64_t> classMap;
+	};
+
+	struct ShardState
+	{
+		std::vector<std::unique_ptr<Shard>> shards;
+		// global index of the first example of each shard followed by the total size
+		std::vector<size_t> offsets;
+		std::vector<std::string> classNames;
+		std::vector<int64_t> classCounts;
+	};
+
+	std::shared_ptr<ShardState> state = std::make_shared<ShardState>();
+	bool classification = false;
+
+	EisDataset<ShardType>* shard(size_t shardIndex)
+	{
+		Shard& entry = *state->shards[shardIndex];
+		std::call_once(entry.once, [this, shardIndex, &entry]()
+		{
+			Log(Log::DEBUG)<<"Opening shard "<<entry.path;
+			entry.dataset = std::make_unique<ShardType>(entry.path);
+			if(state->offsets.size() > shardIndex + 1 &&
+				entry.dataset->size().value_or(0) != state->offsets[shardIndex + 1] - state->offsets[shardIndex])
+				throw dataset_error("Shard " + entry.path.string() + " no longer matches its index");
+			if(shardIndex > 0 && entry.dataset->inputSize() != this->inputSize())
+				throw dataset_error("Shard " + entry.path.string() + " has a diffrent input size than the first shard");
+		});
+		return entry.dataset.get();
+	}
+
+	std::pair<size_t, size_t> locate(size_t index) const
+	{
+		if(index >= state->offsets.back())
+			throw dataset_error("index " + std::to_string(index) + " is out of range for dataset");
+		size_t shardIndex = std::upper_bound(state->offsets.begin(), state->offsets.end(), index) - state->offsets.begin() - 1;
+		return {shardIndex, index - state->offsets[shardIndex]};
+	}
+
+	void mergeClasses(Shard& entry, const std::vector<std::string>& names, const std::vector<int64_t>& counts)
+	{
+		entry.classMap.resize(names.size());
+		for(size_t i = 0; i < names.size(); ++i)
+		{
+			auto search = std::find(state->classNames.begin(), state->classNames.end(), names[i]);
+			entry.classMap[i] = search - state->classNames.begin();
+			if(search == state->classNames.end())
+			{
+				state->classNames.push_back(names[i]);
+				state->classCounts.push_back(0);
+			}
+			if(i < counts.size())
+				state->classCounts[entry.classMap[i]] += counts[i];
+		}
+	}
+
+	void mergeClasses(Shard& entry, EisDataset<ShardType>* dataset)
+	{
+		std::vector<std::string> names(dataset->outputSize());
+		for(size_t i = 0; i < names.size(); ++i)
+			names[i] = dataset->outputName(i);
+		torch::Tensor counts = dataset->classCounts().to(torch::kInt64).contiguous();
+		mergeClasses(entry, names, std::vector<int64_t>(counts.data_ptr<int64_t>(), counts.data_ptr<int64_t>() + counts.numel()));
+	}
+
+protected:
+	virtual torch::data::Example<torch::Tensor, torch::Tensor> getImpl(size_t index) override
+	{
+		auto [shardIndex, local] = locate(index);
+		torch::data::Example<torch::Tensor, torch::Tensor> example = shard(shardIndex)->getImpl(local);
+		if(classification)
+		{
+			example.target = example.target.clone();
+			int64_t* target = example.target.template data_ptr<int64_t>();
+			target[0] = state->shards[shardIndex]->classMap[target[0]];
+		}
+		return example;
+	}
+
+	virtual void getImplToRow(size_t index, torch::Tensor& inputs, torch::Tensor& targets, int64_t row) override
+	{
+		auto [shardIndex, local] = locate(index);
+		shard(shardIndex)->getImplToRow(local, inputs, targets, row);
+		if(classification)
+		{
+			int64_t& target = targets.data_ptr<int64_t>()[row*targets.size(1)];
+			target = state->shards[shardIndex]->classMap[target];
+		}
+	}
+
+	virtual void prefetchBatch(const std::vector<size_t>& indices) override
+	{
+		std::vector<std::vector<size_t>> local(state->shards.size());
+		for(size_t index : indices)
+		{
+			auto [shardIndex, localIndex] = locate(index);
+			local[shardIndex].push_back(localIndex);
+		}
+		for(size_t i = 0; i < local.size(); ++i)
+		{
+			if(!local[i].empty())
+				shard(i)->prefetchBatch(local[i]);
+		}
+	}
+
+	// each shard caches its own statistics, so only new shards have to be passed over
+	virtual DatasetStats computeStats() override
+	{
+		DatasetStats total(this->inputSize(), this->getSchema().targetSize);
+		for(size_t i = 0; i < state->shards.size(); ++i)
+			total.merge(shard(i)->getStats());
+		return total;
+	}
+
+	virtual DatasetSchema loadSchema() override
+	{
+		return shard(0)->getSchema();
+	}
+
+public:
+	explicit ShardedDataset(const std::filesystem::path& spec)
+	{
+		std::vector<std::filesystem::path> paths = expandShards(spec);
+		if(paths.empty())
+			throw dataset_error("No shards found for " + spec.string());
+
+		for(const std::filesystem::path& path : paths)
+		{
+			state->shards.push_back(std::make_unique<Shard>());
+			state->shards.back()->path = path;
+		}
+
+		EisDataset<ShardType>* first = shard(0);
+		classification = !first->isMulticlass();
+		const std::vector<std::string>& labelNames = first->getSchema().labelNames;
+
+		std::vector<std::future<std::pair<bool, DatasetIndex::Summary>>> summaries;
+		for(size_t i = 1; i < paths.size(); ++i)
+		{
+			summaries.push_back(std::async(std::launch::async, [path = paths[i]]()
+			{
+				DatasetIndex::Summary summary;
+				bool valid = DatasetIndex::loadSummary(path, summary);
+				return std::pair<bool, DatasetIndex::Summary>(valid, summary);
+			}));
+		}
+
+		state->offsets.push_back(0);
+		state->offsets.push_back(first->size().value());
+		if(classification)
+			mergeClasses(*state->shards[0], first);
+
+		for(size_t i = 1; i < paths.size(); ++i)
+		{
+			auto [valid, summary] = summaries[i-1].get();
+			Shard& entry = *state->shards[i];
+			if(valid && summary.count > 0 && (!classification || !summary.classNames.empty()))
+			{
+				if(!classification && !summary.labelNames.empty() && summary.labelNames != labelNames)
+					throw dataset_error("Shard " + entry.path.string() + " has diffrent labels than " + paths[0].string());
+				state->offsets.push_back(state->offsets.back() + summary.count);
+				if(classification)
+					mergeClasses(entry, summary.classNames, std::vector<int64_t>(summary.classCounts.begin(), summary.classCounts.end()));
+			}
+			else
+			{
+				// without a usable index the shard has to be opened now, this also creates its index
+				EisDataset<ShardType>* dataset = shard(i);
+				state->offsets.push_back(state->offsets.back() + dataset->size().value());
+				if(classification)
+					mergeClasses(entry, dataset);
+				else if(dataset->getSchema().labelNames != labelNames)
+					throw dataset_error("Shard " + entry.path.string() + " has diffrent labels than " + paths[0].string());
+			}
+		}
+
+		Log(Log::INFO)<<"Using "<<paths.size()<<" shards with "<<state->offsets.back()<<" examples in total";
+	}
+
+	ShardedDataset(const ShardedDataset& in) = default;
+
+	virtual c10::optional<size_t> size() const override
+	{
+		return state->offsets.back();
+	}
+
+	virtual size_t outputSize() const override
+	{
+		if(classification)
+			return state->classNames.size();
+		return state->shards[0]->dataset->outputSize();
+	}
+
+	virtual std::string outputName(size_t output) override
+	{
+		if(!classification)
+			return shard(0)->outputName(output);
+		if(output >= state->classNames.size())
+			return "invalid";
+		return state->classNames[output];
+	}
+
+	virtual bool isMulticlass() override
+	{
+		return !classification;
+	}
+
+	virtual torch::Tensor classCounts() override
+	{
+		if(!classification)
+			return shard(0)->classCounts();
+		torch::Tensor out = torch::empty({static_cast<int64_t>(state->classCounts.size())}, tensorOptCpu<long>(false));
+		std::copy(state->classCounts.begin(), state->classCounts.end(), out.data_ptr<int64_t>());
+		return out;
+	}
+
+	virtual std::string dataLabel() const override
+	{
+		return state->shards[0]->dataset->dataLabel();
+	}
+
+	size_t shardCount() const
+	{
+		return state->shards.size();
+	}
+};
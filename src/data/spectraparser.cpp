@@ -0,0 +1,172 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "spectraparser.h"
+
+#include <charconv>
+#include <cmath>
+
+static bool nextLine(std::string_view& text, std::string_view& line)
+{
+	if(text.empty())
+		return false;
+	size_t end = text.find('\n');
+	if(end == std::string_view::npos)
+	{
+		line = text;
+		text = std::string_view();
+	}
+	else
+	{
+		line = text.substr(0, end);
+		text.remove_prefix(end + 1);
+	}
+	if(!line.empty() && line.back() == '\r')
+		line.remove_suffix(1);
+	return true;
+}
+
+static std::string_view trim(std::string_view str)
+{
+	while(!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+		str.remove_prefix(1);
+	while(!str.empty() && (str.back() == ' ' || str.back() == '\t'))
+		str.remove_suffix(1);
+	return str;
+}
+
+// parses the next comma seperated value in str
+static bool nextValue(std::string_view& str, float& value)
+{
+	size_t i = 0;
+	while(i < str.size() && (str[i] == ' ' || str[i] == '\t' || str[i] == ','))
+		++i;
+	if(i < str.size() && str[i] == '+')
+		++i;
+	if(i == str.size())
+		return false;
+
+	const char* begin = str.data() + i;
+	std::from_chars_result result = std::from_chars(begin, str.data() + str.size(), value);
+	if(result.ec == std::errc::result_out_of_range)
+		value = *begin == '-' ? -INFINITY : INFINITY;
+	else if(result.ec != std::errc())
+		return false;
+	str.remove_prefix(result.ptr - str.data());
+	return true;
+}
+
+static float finiteOrZero(float value)
+{
+	return std::isfinite(value) ? value : 0;
+}
+
+std::string_view spectraLabelNameLine(std::string_view text)
+{
+	// the model line is the first line starting with a quote, the label names are the second
+	std::string_view line;
+	bool seenModel = false;
+	while(nextLine(text, line))
+	{
+		std::string_view trimmed = trim(line);
+		if(trimmed.empty() || trimmed.front() != '"')
+			continue;
+		if(seenModel)
+			return line;
+		seenModel = true;
+	}
+	return std::string_view();
+}
+
+bool parseSpectra(std::string_view text, const SpectraColumnMap& map, float* input, float* extraInputs, float* target)
+{
+	std::string_view line;
+	bool seenModel = false;
+	bool seenLabels = map.labelCount == 0;
+	bool seenNames = map.labelNameLine.empty();
+
+	// header section
+	while(true)
+	{
+		if(!nextLine(text, line))
+			return false;
+		std::string_view trimmed = trim(line);
+
+		if(!trimmed.empty() && trimmed.front() == '"')
+		{
+			if(seenModel)
+			{
+				if(line != map.labelNameLine)
+					return false;
+				seenNames = true;
+			}
+			seenModel = true;
+		}
+		else if(trimmed == "labels")
+		{
+			if(!nextLine(text, line))
+				return false;
+			float value;
+			size_t column = 0;
+			while(nextValue(line, value))
+			{
+				if(column >= map.labelCount)
+					return false;
+				if(target && map.targetColumns[column] >= 0)
+					target[map.targetColumns[column]] = value;
+				if(extraInputs && map.extraColumns[column] >= 0)
+					extraInputs[map.extraColumns[column]] = value;
+				++column;
+			}
+			if(column != map.labelCount || !trim(line).empty())
+				return false;
+			seenLabels = true;
+		}
+		else if(trimmed.substr(0, 5) == "omega")
+		{
+			break;
+		}
+	}
+
+	if(!seenLabels || !seenNames)
+		return false;
+
+	// data section
+	size_t point = 0;
+	while(nextLine(text, line))
+	{
+		if(trim(line).empty())
+			continue;
+		if(point >= map.pointCount)
+			return false;
+
+		float omega;
+		float real;
+		float imag;
+		if(!nextValue(line, omega) || !nextValue(line, real) || !nextValue(line, imag) || !trim(line).empty())
+			return false;
+
+		input[point] = finiteOrZero(real);
+		input[point + map.pointCount] = finiteOrZero(imag);
+		++point;
+	}
+
+	return point == map.pointCount;
+}
@@ -0,0 +1,62 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Describes where the values of a spectra file go, resolved once from the dataset schema.
+ */
+struct SpectraColumnMap
+{
+	size_t pointCount = 0;
+	size_t labelCount = 0;
+	size_t targetCount = 0;
+	size_t extraCount = 0;
+	// for every label column the index in the target tensor it is written to or -1
+	std::vector<int64_t> targetColumns;
+	// for every label column the index in the extra inputs it is written to or -1
+	std::vector<int64_t> extraColumns;
+	// the raw label name line of the spectra the map was created from, all spectra parsed with the map must match it
+	std::string labelNameLine;
+};
+
+/**
+ * @brief Returns the line holding the label names of a spectra file or a empty view if there is none.
+ */
+std::string_view spectraLabelNameLine(std::string_view text);
+
+/**
+ * @brief Parses a spectra file in place without allocateing.
+ *
+ * The real parts of the spectra are written to input[0, pointCount), the imaginary parts to input[pointCount, 2*pointCount).
+ * Values that are not finite are replaced by zero.
+ *
+ * @param text the contents of the spectra file
+ * @param map the column map to use
+ * @param input where to write the spectra to, must have room for 2*map.pointCount values
+ * @param extraInputs where to write the extra inputs to, may be nullptr
+ * @param target where to write the regression targets to, may be nullptr
+ * @return false if the file dose not match the map or is in a format this parser dose not handle, the destination may then be partially written.
+ */
+bool parseSpectra(std::string_view text, const SpectraColumnMap& map, float* input, float* extraInputs, float* target);
@@ -40,6 +40,7 @@
 #include "data/loaders/tarloader.h"
 #include "log.h"
 #include "data/loaders/dirloader.h"
+#include "data/loaders/packeddataset.h"
 #include "data/eistotorch.h"
 #include "data/classextractordataset.h"
 #include "options.h"
@@ -223,6 +224,14 @@ int main(int argc, char** argv)
 				saveImages<RegressionLoaderDir>(&dataset, config.imageOutput);
 			break;
 		}
+		case DATASET_PACKED:
+		{
+			EisPackedDataset dataset(config.fileName);
+			report = generateReport<EisPackedDataset>(&dataset);
+			if(!config.imageOutput.empty())
+				saveImages<EisPackedDataset>(&dataset, config.imageOutput);
+			break;
+		}
 		default:
 			Log(Log::ERROR)<<"Dataset not implmented";
 			break;
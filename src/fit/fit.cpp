@@ -21,95 +21,202 @@
 
 #include "fit.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <cstdint>
+#include <limits>
+#include <stdexcept>
 #include <eisgenerator/model.h>
-#include <thread>
-#include <torch/optim.h>
-#include <torch/optim/adamw.h>
-#include <torch/optim/lbfgs.h>
+#include <torch/optim/adam.h>
 
+#include "ann/regression.h"
 #include "modelscript.h"
 #include "log.h"
+#include "net.h"
+#include "randomgen.h"
 #include "tensoroptions.h"
-#include "loss/eisdistanceloss.h"
-#include "utils/tensoroperators.h"
-#include "globals.h"
+#include "tokenize.h"
 
-std::pair<torch::Tensor, torch::Tensor> getTargetScalesAndBiases(eis::Model& model)
+// the parameters are optimized as unbounded latents that are mapped into the default range of every parameter
+struct ParameterMapping
 {
-	std::vector<eis::Range> defaultRanges = model.getDefaultParameters();
-	torch::Tensor scales = torch::empty({static_cast<int64_t>(defaultRanges.size())}, tensorOptCpu<double>(false));
-	torch::Tensor bias = torch::empty({static_cast<int64_t>(defaultRanges.size())}, tensorOptCpu<double>(false));
+	torch::Tensor low;
+	torch::Tensor span;
+	// parameters whose range is positive are mapped logarithmically, as they typically span several decades
+	torch::Tensor logarithmic;
 
-	for(size_t i = 0; i < defaultRanges.size(); ++i)
+	ParameterMapping(eis::Model& model, const torch::Device& device)
 	{
-		scales[i] = defaultRanges[i].end-defaultRanges[i].start;
-		assert(defaultRanges[i].end-defaultRanges[i].start != 0);
-		bias[i] = defaultRanges[i].start;
+		std::vector<eis::Range> ranges = model.getDefaultParameters();
+		const int64_t count = ranges.size();
+		low = torch::empty({count}, tensorOptCpu<float>(false));
+		span = torch::empty({count}, tensorOptCpu<float>(false));
+		logarithmic = torch::empty({count}, torch::TensorOptions().dtype(torch::kBool));
+
+		for(int64_t i = 0; i < count; ++i)
+		{
+			assert(ranges[i].end != ranges[i].start);
+			bool isLog = ranges[i].start > 0 && ranges[i].end > 0;
+			double start = isLog ? std::log(ranges[i].start) : ranges[i].start;
+			double end = isLog ? std::log(ranges[i].end) : ranges[i].end;
+			low[i] = std::min(start, end);
+			span[i] = std::abs(end - start);
+			logarithmic[i] = isLog;
+		}
+
+		low = low.to(device);
+		span = span.to(device);
+		logarithmic = logarithmic.to(device);
 	}
-	return {scales, bias};
-}
 
-static torch::Tensor guesParameters(eis::Model& model)
-{
-	torch::Tensor out = torch::empty({static_cast<int64_t>(model.getParameterCount())}, tensorOptCpu<fvalue>(false));
+	torch::Tensor toParameters(const torch::Tensor& latent) const
+	{
+		torch::Tensor value = low + span*torch::sigmoid(latent);
+		return torch::where(logarithmic, torch::exp(value), value);
+	}
 
-	std::vector<eis::Range> ranges = model.getDefaultParameters();
+	torch::Tensor toLatent(const torch::Tensor& parameters) const
+	{
+		torch::Tensor value = torch::where(logarithmic, torch::log(parameters.clamp_min(std::numeric_limits<float>::min())), parameters);
+		return torch::logit(((value - low)/span).clamp(1e-3, 1 - 1e-3));
+	}
+};
 
-	for(int64_t i = 0; i < out.size(0); ++i)
-		out[i] = ranges[i].center();
-	return out;
+static torch::Tensor relativeResiduals(const torch::Tensor& simulated, const torch::Tensor& spectra)
+{
+	return torch::mean(torch::abs(simulated - spectra).square()/(torch::abs(spectra).square() + 1e-12), 1);
 }
 
-std::pair<torch::Tensor, torch::Tensor> eisFit(torch::Tensor spectra, torch::Tensor omegas, const std::string& modelString, torch::Tensor startingParams)
+FitResult eisFitBatch(torch::Tensor spectra, torch::Tensor omegas, const std::string& modelString, const FitOptions& options,
+					  torch::Tensor startingParams, const std::vector<size_t>& indices)
 {
+	// checking if all starts converged synchronizes with the device, so it is only done every few iterations
+	static constexpr size_t CONVERGENCE_CHECK_INTERVAL = 16;
+
+	assert(spectra.dim() == 2);
+	assert(indices.empty() || indices.size() == static_cast<size_t>(spectra.size(0)));
+
 	eis::Model model(modelString);
+	CircuitModel circuit(model.getModelStr());
+	const torch::Device device = spectra.device();
+	const int64_t batch = spectra.size(0);
+	const int64_t starts = std::max<int64_t>(options.starts, 1);
+	const int64_t rows = batch*starts;
+	const int64_t parameterCount = circuit.getParameterCount();
+	ParameterMapping mapping(model, device);
+
+	omegas = omegas.reshape({-1}).to(device, torch::kFloat32);
+	// every start of a spectrum is a row of its own, the rows of a spectrum are consecutive
+	torch::Tensor targets = spectra.repeat_interleave(starts, 0);
+
+	torch::Tensor random = torch::empty({rows, parameterCount}, tensorOptCpu<float>(false));
+	float* randomPtr = random.data_ptr<float>();
+	rd::Philox philox(options.seed);
+	for(int64_t i = 0; i < batch; ++i)
+	{
+		uint64_t index = indices.empty() ? i : indices[i];
+		for(int64_t start = 0; start < starts; ++start)
+			philox.uniform(randomPtr + (i*starts + start)*parameterCount, parameterCount, index, start << 16);
+	}
+	torch::Tensor latent = torch::logit(random.clamp(0.01, 0.99)).to(device);
 
-	if(startingParams.numel() != 0 && startingParams.numel() != static_cast<int64_t>(model.getParameterCount()))
-		Log(Log::WARN)<<__func__<<" starting parameters given are not of the right size for the model given";
+	torch::Tensor firstStarts = torch::arange(0, rows, starts, torch::TensorOptions().dtype(torch::kInt64).device(device));
+	if(startingParams.defined() && startingParams.numel() == batch*parameterCount)
+		latent.index_copy_(0, firstStarts, mapping.toLatent(startingParams.reshape({batch, parameterCount}).to(device, torch::kFloat32)));
+	else
+		latent.index_fill_(0, firstStarts, 0);
+	latent.requires_grad_(true);
 
-	if(startingParams.numel() != static_cast<int64_t>(model.getParameterCount()))
-		startingParams = guesParameters(model);
+	torch::optim::Adam optimizer(std::vector<torch::Tensor>{latent}, torch::optim::AdamOptions(options.learningRate));
 
-	startingParams[0] = 200;
-	startingParams[1] = 10e-5;
-	omegas.requires_grad_(false);
-	EisDistanceLoss lossFn(model, omegas);
+	torch::Tensor bestResiduals = torch::full({rows}, std::numeric_limits<float>::infinity(), tensorOptCpu<float>(false).device(device));
+	torch::Tensor bestLatent = latent.detach().clone();
+	torch::Tensor stalled = torch::zeros({rows}, torch::TensorOptions().dtype(torch::kInt64).device(device));
+	torch::Tensor active = torch::ones({rows}, torch::TensorOptions().dtype(torch::kBool).device(device));
+	torch::Tensor iterations = torch::zeros({rows}, torch::TensorOptions().dtype(torch::kInt64).device(device));
 
-	torch::Tensor a = torch::zeros({2}, tensorOptCpu<double>(false));
-	a[0] = 100;
-	a[1] = 3e-6;
+	size_t iteration = 0;
+	for(; iteration < options.maxIterations; ++iteration)
+	{
+		torch::Tensor current = latent.detach().clone();
+		torch::Tensor residuals = relativeResiduals(circuit.simulate(mapping.toParameters(latent), omegas), targets);
 
-	std::pair<torch::Tensor, torch::Tensor> scaleAndBias = getTargetScalesAndBiases(model);
+		// converged starts are masked out of the loss, so they no longer receive gradients
+		optimizer.zero_grad();
+		torch::where(active, residuals, torch::zeros_like(residuals)).sum().backward();
+		optimizer.step();
+
+		torch::NoGradGuard noGrad;
+		residuals = torch::nan_to_num(residuals.detach(), std::numeric_limits<float>::infinity());
+		torch::Tensor improved = residuals < bestResiduals*(1 - options.tolerance);
+		torch::Tensor better = residuals < bestResiduals;
+		bestResiduals = torch::where(better, residuals, bestResiduals);
+		bestLatent = torch::where(better.unsqueeze(1), current, bestLatent);
+		stalled = torch::where(improved, torch::zeros_like(stalled), stalled + 1);
+		iterations = iterations + active;
+		active = active & (stalled < static_cast<int64_t>(options.patience));
+
+		if(iteration % CONVERGENCE_CHECK_INTERVAL == 0 && !active.any().item<bool>())
+			break;
+	}
+	Log(Log::DEBUG)<<__func__<<" stopped after "<<iteration<<" iterations";
+
+	torch::NoGradGuard noGrad;
+	auto [residuals, bestStart] = bestResiduals.reshape({batch, starts}).min(1);
+	torch::Tensor bestRows = torch::arange(batch, bestStart.options())*starts + bestStart;
+
+	FitResult result;
+	result.parameters = mapping.toParameters(bestLatent.index_select(0, bestRows));
+	result.residuals = residuals;
+	result.converged = active.logical_not().index_select(0, bestRows);
+	result.iterations = iterations.index_select(0, bestRows);
+	return result;
+}
+
+std::string regressionModelString(const ann::Net& net)
+{
+	std::vector<std::string> purposeTokens = tokenize(net.getPurpose(), ',');
+	if(purposeTokens.size() < 2 || purposeTokens[0] != "Regression")
+		return std::string();
+	return purposeTokens[1];
+}
+
+FitResult eisFitBatch(torch::Tensor inputs, torch::Tensor omegas, std::shared_ptr<ann::Net> net, const FitOptions& options,
+					  const std::vector<size_t>& indices)
+{
+	std::string modelString = regressionModelString(*net);
+	if(modelString.empty())
+		throw std::invalid_argument("The network with purpose " + net->getPurpose() + " is not a regression network");
+
+	const int64_t pointCount = omegas.numel();
+	assert(inputs.size(1) >= pointCount*2);
+	assert(inputs.size(1) == net->getInputSize());
 
-	std::cout<<"scale:\n"<<scaleAndBias.first<<'\n';
-	std::cout<<"bias:\n"<<scaleAndBias.second<<'\n';
+	torch::Tensor estimates = ann::regression::use(inputs, net);
+	if(estimates.size(1) != static_cast<int64_t>(eis::Model(modelString).getParameterCount()))
+		throw std::invalid_argument("The network has " + std::to_string(estimates.size(1)) + " outputs, but " + modelString + " has " +
+			std::to_string(eis::Model(modelString).getParameterCount()) + " parameters");
 
-	startingParams = (startingParams-scaleAndBias.second)/scaleAndBias.first;
-	startingParams.requires_grad_(true);
-	startingParams.to(torch::kFloat64);
+	torch::Tensor spectra = torch::complex(inputs.narrow(1, 0, pointCount), inputs.narrow(1, pointCount, pointCount));
+	return eisFitBatch(spectra, omegas, modelString, options, estimates, indices);
+}
 
-	std::vector<torch::Tensor> params;
-	params.push_back(startingParams);
-	torch::optim::LBFGS optimizer(params, torch::optim::LBFGSOptions(0.001).line_search_fn("strong_wolfe").history_size(1000).max_iter(1000));
+std::pair<torch::Tensor, torch::Tensor> eisFit(torch::Tensor spectra, torch::Tensor omegas, const std::string& modelString, torch::Tensor startingParams)
+{
+	eis::Model model(modelString);
 
-	for(size_t i = 0; i < 200000; ++i)
+	if(startingParams.numel() != 0 && startingParams.numel() != static_cast<int64_t>(model.getParameterCount()))
 	{
-		torch::Tensor loss = lossFn.forward(params[0]*scaleAndBias.first+scaleAndBias.second, a);
-		std::cout<<"loss:\n"<<loss<<'\n';
-		std::cout<<"params[0]:\n"<<params[0]<<'\n';
-		std::cout<<"params:\n"<<params[0]*scaleAndBias.first+scaleAndBias.second<<'\n';
-		optimizer.zero_grad();
-		loss.backward();
-		std::cout<<"grad:\n"<<params[0].grad()<<'\n';
-		optimizer.step([&lossFn, &a, parameters=params[0], &scaleAndBias]()->torch::Tensor{return lossFn.forward(parameters*scaleAndBias.first+scaleAndBias.second, a);});
-		if(loss.item().toDouble() < 0.0001)
-			break;
-		std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+		Log(Log::WARN)<<__func__<<" starting parameters given are not of the right size for the model given";
+		startingParams = torch::Tensor();
 	}
 
-	Log(Log::DEBUG)<<__func__<<" optimized to:\n"<<params[0]*scaleAndBias.first+scaleAndBias.second;
-	torch::Tensor loss = lossFn.distance(params[0]*scaleAndBias.first+scaleAndBias.second, spectra);
+	FitOptions options;
+	options.seed = rd::getSeed();
+	FitResult result = eisFitBatch(spectra.reshape({1, -1}), omegas, modelString, options,
+								   startingParams.numel() != 0 ? startingParams.reshape({1, -1}) : torch::Tensor());
 
-	return {params[0]*scaleAndBias.first+scaleAndBias.second, loss};
+	Log(Log::DEBUG)<<__func__<<" optimized to:\n"<<result.parameters[0];
+	return {result.parameters[0], result.residuals[0]};
 }
@@ -19,8 +19,82 @@
  */
 
 #pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "torchph.h"
 
+namespace ann
+{
+class Net;
+}
+
+struct FitOptions
+{
+	// random starts per spectrum, the first start uses the starting parameters or the center of the parameter ranges
+	size_t starts = 8;
+	size_t maxIterations = 2000;
+	double learningRate = 0.05;
+	// a start has converged once its residual did not improve by this relative amount for patience iterations
+	double tolerance = 1e-4;
+	size_t patience = 50;
+	// together with the sample index determines the random starts
+	uint64_t seed = 0;
+};
+
+struct FitResult
+{
+	// [batch, parameters] the best parameters found for every spectrum
+	torch::Tensor parameters;
+	// [batch] mean squared relative error of the spectra simulated from parameters
+	torch::Tensor residuals;
+	// [batch] if the start that produced parameters converged before maxIterations
+	torch::Tensor converged;
+	// [batch] number of iterations the start that produced parameters was optimized for
+	torch::Tensor iterations;
+};
+
+/**
+ * @brief Fits a batch of spectra to the given model as one vectorized problem
+ *
+ * Every spectrum is fitted from options.starts starting points at once, all starts of all spectra are optimized
+ * together with Adam in the bounded parameter space of the model's default ranges. Starts stop contributing to the loss
+ * once they converged and the fit ends when all starts converged or after options.maxIterations.
+ *
+ * @param spectra [batch, omegas] complex spectra to fit
+ * @param omegas the angular frequencies of the spectra
+ * @param modelString model to fit the spectra to
+ * @param options the options of the fit
+ * @param startingParams optional [batch, parameters] starting parameters
+ * @param indices optional index of every spectrum in its dataset, keys the random starts so that a fit does not depend on batching
+ * @return the fitted parameters, residuals and convergence of every spectrum
+ */
+FitResult eisFitBatch(torch::Tensor spectra, torch::Tensor omegas, const std::string& modelString, const FitOptions& options = FitOptions(),
+					  torch::Tensor startingParams = torch::Tensor(), const std::vector<size_t>& indices = {});
+
+/**
+ * @brief Fits a batch of spectra to the model a regression network was trained on, starting from the network's estimates
+ *
+ * The network is run over inputs with ann::regression::use and its predictions are used as the first start of
+ * every spectrum, the model to fit is taken from the network's purpose.
+ *
+ * @param inputs [batch, inputs] network inputs as produced by EisDataset, the first 2*omegas columns are the real and imaginary parts of the spectra
+ * @param omegas the angular frequencies of the spectra
+ * @param net a network trained by ann::regression::train
+ * @param options the options of the fit, as the network estimates are typically close a single start usually suffices
+ * @param indices optional index of every spectrum in its dataset, see eisFitBatch
+ * @return the fitted parameters, residuals and convergence of every spectrum
+ */
+FitResult eisFitBatch(torch::Tensor inputs, torch::Tensor omegas, std::shared_ptr<ann::Net> net, const FitOptions& options = FitOptions(),
+					  const std::vector<size_t>& indices = {});
+
+/**
+ * @brief Returns the model a regression network was trained on or an empty string if the network is not a regression network
+ */
+std::string regressionModelString(const ann::Net& net);
+
 /**
  * @brief Fits the given spectra to the given model
  *
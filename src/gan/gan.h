@@ -40,7 +40,7 @@ namespace gan
 		options = options.batch_size(100);
 		options = options.workers(16);
 		options = options.max_jobs(32);
-		auto dataLoader = torch::data::make_data_loader(trainDataset->map(torch::data::transforms::Stack<>()), options);
+		auto dataLoader = torch::data::make_data_loader(EisBatchDataset<DatasetType>(trainDataset), options);
 
 		size_t data_size = trainDataset->size().value();
 		int64_t loginterval = data_size/10000 ?: data_size/batch_size-1;
@@ -37,6 +37,12 @@
 torch::DeviceType offload_type;
 torch::Device* offload_device;
 int batch_size = 256;
+size_t data_workers = 0;
+size_t prefetch_depth = 8;
+size_t shuffle_block = 0;
+size_t shuffle_buffer = 0;
+size_t anomaly_check_interval = 64;
+size_t anomaly_snapshot_interval = 1024;
 
 static size_t print_device_proparties(size_t deviceIndex, bool newline = true)
 {
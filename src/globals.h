@@ -27,6 +27,12 @@ static constexpr int JOBS = 64;
 extern torch::DeviceType offload_type;
 extern torch::Device* offload_device;
 extern int batch_size;
+extern size_t data_workers;
+extern size_t prefetch_depth;
+extern size_t shuffle_block;
+extern size_t shuffle_buffer;
+extern size_t anomaly_check_interval;
+extern size_t anomaly_snapshot_interval;
 
 typedef enum
 {
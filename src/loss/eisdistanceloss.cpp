@@ -31,53 +31,57 @@
 #include "log.h"
 
 EisDistanceLoss::EisDistanceLoss(std::string modelString, torch::Tensor omegasIn, torch::Tensor targetScalarIn):
-omegas(omegasIn.reshape({omegasIn.numel(), -1})),
+circuit(std::make_shared<const CircuitModel>(modelString)),
+omegas(omegasIn.reshape({-1})),
 loss(torch::nn::MSELossOptions().reduction(torch::kMean)),
 targetScalar(targetScalarIn)
 {
-	model = std::shared_ptr<eis::Model>(new eis::Model(modelString));
-	modelScript = compileModel(*model);
 }
 
-
 EisDistanceLoss::EisDistanceLoss(const eis::Model& modelIn, torch::Tensor omegasIn, torch::Tensor targetScalarIn):
-omegas(omegasIn.reshape({omegasIn.numel(), -1})),
-loss(torch::nn::MSELossOptions().reduction(torch::kMean)),
-targetScalar(targetScalarIn)
+EisDistanceLoss(eis::Model(modelIn).getModelStr(), omegasIn, targetScalarIn)
 {
-	model = std::shared_ptr<eis::Model>(new eis::Model(modelIn));
-	modelScript = compileModel(*model);
 }
 
 torch::Tensor EisDistanceLoss::distance(torch::Tensor output, torch::Tensor targetSpectra)
 {
-	assert(model);
+	assert(circuit);
 	assert(omegas.numel() > 0);
-	assert(modelScript);
 
-	if(output.dim() > 1 && output.size(1) == static_cast<int64_t>(model->getParameterCount()))
-		output = output.t();
+	// output is either a single set of parameters or [batch, parameters]
+	torch::Tensor predictedSpectraCmplx = circuit->simulate(output, omegas);
 
-	torch::Tensor predictedSpectraCmplx = runScriptModel(*model, modelScript, output, omegas);
+	return torch::sum(torch::abs(torch::imag(predictedSpectraCmplx) - torch::imag(targetSpectra)));
+}
+
+torch::Tensor EisDistanceLoss::forward(torch::Tensor output, torch::Tensor targets)
+{
+	assert(targets.sizes() == output.sizes());
+
+	if(targetScalar.numel() != 0)
+	{
+		output = output/targetScalar;
+		targets = targets/targetScalar;
+	}
 
-	/*std::cout<<"targetSpectra:\n"<<torch::view_as_real(targetSpectra)<<'\n';
-	std::cout<<"predictedSpectraCmplx:\n"<<torch::view_as_real(predictedSpectraCmplx)<<'\n';*/
+	torch::Tensor targetSpectraCmplx = circuit->simulate(targets, omegas);
 
-	torch::Tensor out = /*torch::sum(torch::abs(torch::real(predictedSpectraCmplx) - torch::real(targetSpectra)))+*/
-		torch::sum(torch::abs(torch::imag(predictedSpectraCmplx) - torch::imag(targetSpectra)));
-/*	torch::Tensor targetSpectraExpanded = targetSpectra.expand({targetSpectra.size(0), targetSpectra.size(0)}).t();
-	torch::Tensor diff = torch::abs(targetSpectraExpanded - predictedSpectraCmplx);
-	std::cout<<"targetSpectraExpanded:\n"<<targetSpectraExpanded<<'\n';
-	std::cout<<"Diff:\n"<<diff<<'\n';
-	torch::Tensor sumA = torch::sum(std::get<0>(torch::min(diff, 1)));
-	torch::Tensor sumB = torch::sum(std::get<0>(torch::min(diff, 0)));*/
+	return distance(output, targetSpectraCmplx);
+}
 
-	return out;//+torch::sum(torch::abs((output-torch::abs(output))))+0.001;
+void EisDistanceLoss::enableTargetCache(size_t examples)
+{
+	targetCache = torch::Tensor();
+	targetCached.assign(examples, false);
 }
 
-torch::Tensor EisDistanceLoss::forward(torch::Tensor output, torch::Tensor targets)
+torch::Tensor EisDistanceLoss::forward(torch::Tensor output, torch::Tensor targets, const std::vector<size_t>& indices)
 {
+	if(targetCached.empty())
+		return forward(output, targets);
+
 	assert(targets.sizes() == output.sizes());
+	assert(targets.size(0) == static_cast<int64_t>(indices.size()));
 
 	if(targetScalar.numel() != 0)
 	{
@@ -85,10 +89,34 @@ torch::Tensor EisDistanceLoss::forward(torch::Tensor output, torch::Tensor targe
 		targets = targets/targetScalar;
 	}
 
-	if(targets.dim() > 1 && targets.size(1) == static_cast<int64_t>(model->getParameterCount()) )
-		targets = targets.t();
+	std::vector<int64_t> exampleIndices(indices.size());
+	std::vector<int64_t> missingRows;
+	for(size_t i = 0; i < indices.size(); ++i)
+	{
+		assert(indices[i] < targetCached.size());
+		exampleIndices[i] = indices[i];
+		if(!targetCached[indices[i]])
+			missingRows.push_back(i);
+	}
+	torch::Tensor exampleIndex = torch::tensor(exampleIndices, torch::TensorOptions().dtype(torch::kInt64)).to(targets.device());
 
-	torch::Tensor targetSpectraCmplx = runScriptModel(*model, modelScript, targets, omegas);
+	if(!missingRows.empty())
+	{
+		torch::NoGradGuard noGrad;
+		torch::Tensor rows = torch::tensor(missingRows, torch::TensorOptions().dtype(torch::kInt64)).to(targets.device());
+		torch::Tensor spectra = circuit->simulate(targets.index_select(0, rows), omegas);
+		if(!targetCache.defined())
+			targetCache = torch::empty({static_cast<int64_t>(targetCached.size()), spectra.size(1)}, spectra.options());
+		else if(targetCache.device() != spectra.device())
+			targetCache = targetCache.to(spectra.device());
+		targetCache.index_copy_(0, exampleIndex.index_select(0, rows), spectra);
+		for(int64_t row : missingRows)
+			targetCached[indices[row]] = true;
+	}
+	else if(targetCache.device() != targets.device())
+	{
+		targetCache = targetCache.to(targets.device());
+	}
 
-	return distance(output, targetSpectraCmplx);
+	return distance(output, targetCache.index_select(0, exampleIndex));
 }
@@ -23,25 +23,45 @@
 #include <eisgenerator/model.h>
 #include <unistd.h>
 #include <memory>
+#include <vector>
 
 #include "torchph.h"
+#include "modelscript.h"
 
 class EisDistanceLoss : public  torch::nn::Module
 {
-	std::shared_ptr<eis::Model> model;
+	std::shared_ptr<const CircuitModel> circuit;
 	torch::Tensor omegas;
-	std::shared_ptr<torch::CompilationUnit> modelScript;
 	torch::nn::MSELoss loss;
 	torch::Tensor targetScalar;
 
+	// [examples, frequencies] spectra of the targets, rows are valid once targetCached is set
+	torch::Tensor targetCache;
+	std::vector<bool> targetCached;
+
 	public:
 		EisDistanceLoss(std::string modelString, torch::Tensor omegas, torch::Tensor targetScalar = torch::Tensor());
 		EisDistanceLoss(const eis::Model& model, torch::Tensor omegas, torch::Tensor targetScalar = torch::Tensor());
 
+		/**
+		 * @brief Caches the spectra of the targets by example index, so that they are only simulated the first time
+		 * an example is seen by forward(output, targets, indices).
+		 *
+		 * Only valid if the targets of an example never change.
+		 *
+		 * @param examples the number of examples in the dataset.
+		 */
+		void enableTargetCache(size_t examples);
+
 		torch::Tensor forward(torch::Tensor output, torch::Tensor targets);
+		torch::Tensor forward(torch::Tensor output, torch::Tensor targets, const std::vector<size_t>& indices);
 		torch::Tensor distance(torch::Tensor output, torch::Tensor targetSpectra);
 		inline torch::Tensor operator()(torch::Tensor output, torch::Tensor targets)
 		{
 			return forward(output, targets);
 		}
+		inline torch::Tensor operator()(torch::Tensor output, torch::Tensor targets, const std::vector<size_t>& indices)
+		{
+			return forward(output, targets, indices);
+		}
 };
@@ -0,0 +1,96 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <filesystem>
+#include <iostream>
+#include <kisstype/type.h>
+#include <eisgenerator/log.h>
+
+#include "commonoptions.h"
+#include "data/loaders/regressionloader.h"
+#include "data/loaders/regressiondirloader.h"
+#include "data/loaders/tarloader.h"
+#include "data/loaders/dirloader.h"
+#include "data/packexport.h"
+#include "log.h"
+#include "options.h"
+
+template <typename DataSetType>
+int pack(const Config& config)
+{
+	try
+	{
+		DataSetType dataset(config.fileName);
+		if(dataset.size().value() == 0)
+		{
+			Log(Log::ERROR)<<"Failed to load dataset from "<<config.fileName;
+			return 2;
+		}
+
+		Log(Log::INFO)<<"Packing "<<dataset.size().value()<<" examples from "<<config.fileName<<" into "<<config.outFileName;
+		if(!packDataset<DataSetType>(&dataset, config.outFileName, config.workers))
+			return 1;
+	}
+	catch(const dataset_error& err)
+	{
+		Log(Log::ERROR)<<err.what();
+		return 2;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	Log::level = Log::INFO;
+	eis::Log::level = eis::Log::ERROR;
+
+	Config config;
+	argp_parse(&argp, argc, argv, 0, 0, &config);
+
+	if(config.datasetMode == DATASET_INVALID)
+	{
+		Log(Log::ERROR)<<"You must specify what dataset to use: -d " DATASET_LIST;
+		return -1;
+	}
+
+	if(config.fileName.empty() || config.outFileName.empty())
+	{
+		Log(Log::ERROR)<<"You must specify a dataset to convert via -f and a output file via -o";
+		return 2;
+	}
+
+	switch(config.datasetMode)
+	{
+		case DATASET_DIR:
+			return pack<EisDirDataset>(config);
+		case DATASET_TAR:
+			return pack<EisTarDataset>(config);
+		case DATASET_DIR_REGRESSION:
+			return pack<RegressionLoaderDir>(config);
+		case DATASET_TAR_REGRESSION:
+			return pack<RegressionLoaderTar>(config);
+		case DATASET_PACKED:
+			Log(Log::ERROR)<<"The dataset is allready packed";
+			return 1;
+		default:
+			Log(Log::ERROR)<<"Dataset not implmented";
+			return 1;
+	}
+}
@@ -28,6 +28,16 @@
 #include <torch/csrc/autograd/generated/variable_factories.h>
 #include <torch/optim.h>
 #include <filesystem>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <cstring>
+#include <array>
+#include <map>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <kisstype/spectra.h>
 
 #include "ann/scriptnet.h"
 #include "data/eistotorch.h"
@@ -40,6 +50,36 @@
 #include "modelscript.h"
 #include "fit/fit.h"
 #include "tokenize.h"
+#include "data/spectraparser.h"
+#include "data/samplecache.h"
+#include "data/datasetstats.h"
+#include "data/batchaugmentation.h"
+#include "data/shardeddataset.h"
+#include "tarscan.h"
+#include "microtar.h"
+#include "randomgen.h"
+
+// counts the allocations of each thread, so that allocations of other threads like the libtorch pool do not count against the test
+static thread_local size_t allocationCount = 0;
+
+void* operator new(size_t size)
+{
+	++allocationCount;
+	void* ptr = std::malloc(size);
+	if(!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
 
 template<typename Dataset>
 void testLoader(torch::data::datasets::Dataset<Dataset, torch::data::Example<torch::Tensor, torch::Tensor>>* data)
@@ -144,6 +184,32 @@ bool testEisScript()
 	return true;
 }
 
+bool testCircuitModel()
+{
+	for(const std::string modelStr : {"r{100}-r{50}c{1e-4}", "r{20}-r{100}p{1e-5, 0.8}-w{30}", "r{10}(r{100}-c{1e-6})l{1e-3}"})
+	{
+		eis::Model model(modelStr);
+		torch::Tensor omegas;
+		torch::Tensor expected = eisToComplexTensor(model.executeSweep(eis::Range(1e-2, 1e6, 20, true)), &omegas);
+
+		CircuitModel circuit(modelStr);
+		std::vector<fvalue> paramVect = model.getFlatParameters();
+		torch::Tensor parameters = fvalueVectorToTensor(paramVect).clone().repeat({3, 1}).set_requires_grad(true);
+		torch::Tensor spectra = circuit.simulate(parameters, omegas);
+		if(!circuit.isNative() || spectra.sizes() != torch::IntArrayRef({3, omegas.numel()}) ||
+			!torch::allclose(spectra[2], expected, 1e-3, 1e-6))
+		{
+			Log(Log::ERROR)<<__func__<<' '<<modelStr<<" does not match eisgenerator:\n"<<spectra[2]<<'\n'<<expected;
+			return false;
+		}
+
+		torch::abs(spectra).sum().backward();
+		if(!parameters.grad().defined() || !torch::isfinite(parameters.grad()).all().item().toBool())
+			return false;
+	}
+	return true;
+}
+
 bool testEisDistanceLoss()
 {
 	eis::Model model("r{100}-r{100}c{1e-4}");
@@ -194,21 +260,265 @@ bool testEisDistanceLoss()
 	return true;
 }
 
+bool testEisDistanceLossCache()
+{
+	eis::Model model("r{100}-r{100}c{1e-4}");
+	torch::Tensor omegas = torch::logspace(-2, 6, 5);
+	EisDistanceLoss uncached(model, omegas);
+	EisDistanceLoss cached(model, omegas);
+
+	constexpr int64_t examples = 8;
+	std::vector<fvalue> paramVect = model.getFlatParameters();
+	torch::Tensor base = fvalueVectorToTensor(paramVect).reshape({1, -1});
+	torch::Tensor factors = torch::linspace(0.5, 2, examples, tensorOptCpu<float>(false)).reshape({-1, 1});
+	torch::Tensor targets = base*factors;
+	torch::Tensor outputs = targets*1.1;
+	cached.enableTargetCache(examples);
+
+	// the first pass fills the cache, the second mixes cached and uncached examples and the third is fully cached
+	for(const std::vector<size_t>& indices : std::vector<std::vector<size_t>>{{0, 1, 2, 3}, {2, 5, 3, 4}, {0, 1, 2, 3}})
+	{
+		torch::Tensor rows = torch::tensor(std::vector<int64_t>(indices.begin(), indices.end()), torch::TensorOptions().dtype(torch::kInt64));
+		torch::Tensor output = outputs.index_select(0, rows);
+		torch::Tensor target = targets.index_select(0, rows);
+		torch::Tensor expected = uncached.forward(output, target);
+		torch::Tensor loss = cached.forward(output, target, indices);
+		if(loss.numel() != 1 || !torch::allclose(loss.cpu(), expected.cpu(), 1e-5, 1e-6))
+		{
+			Log(Log::ERROR)<<__func__<<" cached loss "<<loss<<" dose not match the uncached loss "<<expected;
+			return false;
+		}
+	}
+	return true;
+}
+
 bool testFit()
 {
 	const std::string modelString = "r{100}c{1e-5}";
 	eis::Model model(modelString);
 	torch::Tensor omegas;
-	torch::Tensor targetSpectra = eisToComplexTensor(model.executeSweep(eis::Range(1, 1e6, 5)), &omegas);
+	eisToComplexTensor(model.executeSweep(eis::Range(1e-2, 1e6, 20, true)), &omegas);
 
-	Log(Log::INFO)<<__func__<<"targetSpectra:\n"<<targetSpectra<<"\nomegas:\n"<<omegas;
+	// spectra of parameters spread over the default ranges the fit searches in
+	std::vector<eis::Range> ranges = model.getDefaultParameters();
+	const std::vector<double> fractions = {0.3, 0.5, 0.7};
+	torch::Tensor parameters = torch::empty({static_cast<int64_t>(fractions.size()), static_cast<int64_t>(ranges.size())}, tensorOptCpu<float>(false));
+	for(size_t i = 0; i < fractions.size(); ++i)
+	{
+		for(size_t j = 0; j < ranges.size(); ++j)
+		{
+			const eis::Range& range = ranges[j];
+			if(range.start > 0 && range.end > 0)
+				parameters[i][j] = std::exp(std::log(range.start) + fractions[i]*(std::log(range.end) - std::log(range.start)));
+			else
+				parameters[i][j] = range.start + fractions[i]*(range.end - range.start);
+		}
+	}
+	CircuitModel circuit(modelString);
+	torch::Tensor spectra = circuit.simulate(parameters, omegas).detach();
 
-	std::pair<torch::Tensor, torch::Tensor> fited = eisFit(targetSpectra, omegas, modelString);
+	FitOptions options;
+	options.maxIterations = 5000;
+	options.seed = 42;
+	FitResult result = eisFitBatch(spectra, omegas, modelString, options);
+
+	Log(Log::INFO)<<__func__<<" expected:\n"<<parameters<<"\nfitted:\n"<<result.parameters<<"\nresiduals:\n"<<result.residuals;
+
+	if(result.parameters.sizes() != parameters.sizes() || !torch::allclose(result.parameters.cpu(), parameters, 0.05, 0))
+	{
+		Log(Log::ERROR)<<__func__<<" the fitted parameters do not match the parameters the spectra were generated with";
+		return false;
+	}
+	if(!result.converged.defined() || result.converged.numel() != parameters.size(0) || !result.converged.all().item<bool>())
+	{
+		Log(Log::ERROR)<<__func__<<" the fit did not converge: "<<result.converged;
+		return false;
+	}
+	if(!result.iterations.defined() || result.iterations.numel() != parameters.size(0) ||
+		result.iterations.min().item<int64_t>() <= 0 || result.iterations.max().item<int64_t>() > static_cast<int64_t>(options.maxIterations))
+	{
+		Log(Log::ERROR)<<__func__<<" invalid iteration counts: "<<result.iterations;
+		return false;
+	}
 
-	Log(Log::INFO)<<__func__<<"Result:\n"<<fited.first<<"\nremaining loss:\n"<<fited.second;
+	std::pair<torch::Tensor, torch::Tensor> fitted = eisFit(spectra[1], omegas, modelString);
+	if(!torch::allclose(fitted.first.cpu(), parameters[1], 0.05, 0))
+	{
+		Log(Log::ERROR)<<__func__<<" eisFit returned "<<fitted.first<<" instead of "<<parameters[1];
+		return false;
+	}
 	return true;
 }
 
+bool testSpectraParser()
+{
+	const std::string text =
+		"EISF, 1.0.0\n"
+		"\"r-rc\", test spectra\n"
+		"labelsNames\n"
+		"\"r1\", \"exip_temperature\", \"c1\"\n"
+		"labels\n"
+		"1.000000e+02, 2.500000e+01, -1.000000e-04\n"
+		"omega, real, im\n"
+		"\n"
+		"1.000000e+00, 2.000000e+02, -1.000000e+00\n"
+		"1.000000e+01, 1.500000e+02, nan\n"
+		"1.000000e+02, 1.000000e+02, -3.000000e+00\n";
+
+	std::stringstream ss(text);
+	eis::Spectra spectra = eis::Spectra::loadFromStream(ss);
+
+	SpectraColumnMap map;
+	map.pointCount = spectra.data.size();
+	map.labelCount = spectra.labels.size();
+	map.targetColumns = {0, -1, 1};
+	map.extraColumns = {-1, 0, -1};
+	map.targetCount = 2;
+	map.extraCount = 1;
+	map.labelNameLine = spectraLabelNameLine(text);
+
+	std::vector<float> input(map.pointCount*2 + map.extraCount);
+	std::vector<float> target(map.targetCount);
+
+	size_t allocations = allocationCount;
+	for(size_t i = 0; i < 1000; ++i)
+	{
+		if(!parseSpectra(text, map, input.data(), input.data() + map.pointCount*2, target.data()))
+		{
+			Log(Log::ERROR)<<__func__<<" failed to parse spectra";
+			return false;
+		}
+	}
+	allocations = allocationCount - allocations;
+	if(allocations != 0)
+	{
+		Log(Log::ERROR)<<__func__<<" parser allocated "<<allocations<<" times";
+		return false;
+	}
+
+	torch::Tensor reference = eisToTorch(spectra.data);
+	torch::Tensor parsed = torch::from_blob(input.data(), {static_cast<int64_t>(map.pointCount*2)}, tensorOptCpu<float>(false));
+	if(!torch::allclose(reference, parsed))
+	{
+		Log(Log::ERROR)<<__func__<<" parsed spectra dose not match reference:\n"<<parsed<<'\n'<<reference;
+		return false;
+	}
+
+	if(!cmpDouble(target[0], spectra.labels[0]) || !cmpDouble(target[1], spectra.labels[2]) || !cmpDouble(input.back(), spectra.labels[1]))
+	{
+		Log(Log::ERROR)<<__func__<<" labels where not placed correctly";
+		return false;
+	}
+
+	return true;
+}
+
+bool testSampleCache()
+{
+	constexpr size_t count = 1000;
+	constexpr size_t width = 10;
+	// half of the rows end up in the spill file
+	SampleCache cache(count, width, sizeof(int64_t), count/2*(width*sizeof(float) + sizeof(int64_t)));
+	if(cache.spillBytes() == 0 || cache.ramBytes() == 0)
+	{
+		Log(Log::ERROR)<<__func__<<" expected the cache to be split between memory and disk";
+		return false;
+	}
+
+	std::vector<float> input(width);
+	int64_t target;
+	for(size_t i = 0; i < count; ++i)
+	{
+		if(cache.load(i, input.data(), &target))
+		{
+			Log(Log::ERROR)<<__func__<<" empty cache returned example "<<i;
+			return false;
+		}
+		for(size_t j = 0; j < width; ++j)
+			input[j] = i*width + j;
+		target = i;
+		cache.store(i, input.data(), &target);
+	}
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		if(!cache.load(i, input.data(), &target) || target != static_cast<int64_t>(i) || input[width-1] != i*width + width - 1)
+		{
+			Log(Log::ERROR)<<__func__<<" example "<<i<<" was not cached correctly";
+			return false;
+		}
+	}
+
+	return cache.filled() == count;
+}
+
+bool testColumnStats()
+{
+	constexpr size_t rows = 1000;
+	constexpr size_t width = 3;
+	std::vector<float> data(rows*width);
+	for(size_t i = 0; i < data.size(); ++i)
+		data[i] = std::sin(static_cast<float>(i))*(i % width + 1) + 100;
+
+	ColumnStats whole(width);
+	whole.add(data.data(), rows);
+
+	// merging unevenly sized blocks has to give the same result as a single pass
+	ColumnStats first(width);
+	ColumnStats second(width);
+	first.add(data.data(), 137);
+	second.add(data.data() + 137*width, rows - 137);
+	first.merge(second);
+
+	std::vector<double> variance = whole.variance();
+	std::vector<double> mergedVariance = first.variance();
+	for(size_t column = 0; column < width; ++column)
+	{
+		double mean = 0;
+		for(size_t row = 0; row < rows; ++row)
+			mean += data[row*width + column];
+		mean /= rows;
+		if(!cmpDouble(whole.mean[column], mean) || !cmpDouble(first.mean[column], mean) ||
+			!cmpDouble(variance[column], mergedVariance[column]) || whole.min[column] != first.min[column] ||
+			whole.max[column] != first.max[column])
+		{
+			Log(Log::ERROR)<<__func__<<" column "<<column<<" dose not match";
+			return false;
+		}
+	}
+
+	return first.count == rows;
+}
+
+bool testKeyedAugmentation()
+{
+	constexpr size_t columns = 8;
+	AugmentationOptions options;
+	options.dropouts.assign(columns, {true, 1, -1, 0.5});
+	options.frequencyJitter = 1.5;
+	BatchAugmentation augmentation(options, columns, columns/2, nullptr, 42);
+
+	// the random values of a sample must only depend on its index and the epoch, not on the rest of the batch
+	torch::Tensor batch = augmentation.draw(std::vector<size_t>{3, 7, 9}, 2);
+	torch::Tensor other = augmentation.draw(std::vector<size_t>{9, 3}, 2);
+	if(!torch::equal(batch[0], other[1]) || !torch::equal(batch[2], other[0]))
+	{
+		Log(Log::ERROR)<<__func__<<" random values depend on the batch";
+		return false;
+	}
+	if(torch::equal(batch, augmentation.draw(std::vector<size_t>{3, 7, 9}, 3)))
+	{
+		Log(Log::ERROR)<<__func__<<" random values do not change with the epoch";
+		return false;
+	}
+
+	torch::Tensor inputs = torch::rand({3, columns});
+	torch::Tensor first = inputs.clone();
+	torch::Tensor second = inputs.clone();
+	augmentation.apply(first, batch);
+	augmentation.apply(second, std::vector<size_t>{3, 7, 9}, 2);
+	return torch::equal(first, second) && !torch::equal(first, inputs);
+}
 
 bool testScriptnet()
 {
@@ -228,6 +538,368 @@ bool testScriptnet()
 	return true;
 }
 
+bool testPhilox()
+{
+	// known answer vectors of Philox4x32-10 from Random123
+	struct KnownAnswer
+	{
+		std::array<uint32_t, 4> counter;
+		std::array<uint32_t, 2> key;
+		std::array<uint32_t, 4> expected;
+	};
+	const std::vector<KnownAnswer> answers = {
+		{{0, 0, 0, 0}, {0, 0}, {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+		{{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff}, {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+		{{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}, {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}}
+	};
+
+	for(const KnownAnswer& answer : answers)
+	{
+		std::array<uint32_t, 4> values = rd::Philox::block(answer.counter, answer.key);
+		if(values != answer.expected)
+		{
+			Log(Log::ERROR)<<__func__<<" Philox4x32-10 dose not match the known answer for key "<<std::hex<<answer.key[0]<<' '<<answer.key[1]
+				<<": "<<values[0]<<' '<<values[1]<<' '<<values[2]<<' '<<values[3]<<std::dec;
+			return false;
+		}
+	}
+	return true;
+}
+
+static std::string tarHeader(const std::string& name, uint64_t size, char type, const std::string& prefix = "", bool base256 = false)
+{
+	std::string block(TarScanner::BLOCK_SIZE, '\0');
+	name.copy(block.data(), 100);
+	std::memcpy(block.data()+100, "0000644", 7);
+	std::memcpy(block.data()+108, "0001750", 7);
+	std::memcpy(block.data()+116, "0001750", 7);
+	if(base256)
+	{
+		block[124] = static_cast<char>(0x80);
+		for(size_t i = 0; i < 8; ++i)
+			block[135-i] = static_cast<char>((size >> (i*8)) & 0xff);
+	}
+	else
+	{
+		std::snprintf(block.data()+124, 12, "%011llo", static_cast<unsigned long long>(size));
+	}
+	std::memcpy(block.data()+136, "00000000000", 11);
+	block[156] = type;
+	std::memcpy(block.data()+257, "ustar\0" "00", 8);
+	prefix.copy(block.data()+345, 155);
+
+	// the checksum is calculated with the checksum field set to spaces
+	std::memset(block.data()+148, ' ', 8);
+	unsigned checksum = 0;
+	for(char c : block)
+		checksum += static_cast<unsigned char>(c);
+	std::snprintf(block.data()+148, 7, "%06o", checksum);
+	block[155] = ' ';
+	return block;
+}
+
+static std::string paxRecord(const std::string& key, const std::string& value)
+{
+	// the length of a record includes the digits of the length itself
+	const size_t base = key.size() + value.size() + 3;
+	size_t length = base;
+	while(base + std::to_string(length).size() != length)
+		length = base + std::to_string(length).size();
+	return std::to_string(length) + " " + key + "=" + value + "\n";
+}
+
+struct MemoryTar
+{
+	mtar_t tar;
+	const TarScanner::Reader* reader;
+};
+
+static bool checkTarMembers(const std::vector<TarScanner::Member>& members, const std::vector<TarScanner::Member>& expected, const std::string& source)
+{
+	if(members.size() != expected.size())
+	{
+		Log(Log::ERROR)<<__func__<<' '<<source<<" found "<<members.size()<<" files instead of "<<expected.size();
+		return false;
+	}
+	for(size_t i = 0; i < members.size(); ++i)
+	{
+		if(members[i].name != expected[i].name || members[i].pos != expected[i].pos || members[i].size != expected[i].size)
+		{
+			Log(Log::ERROR)<<__func__<<' '<<source<<" returned "<<members[i].name<<" at "<<members[i].pos<<" with size "<<members[i].size
+				<<" instead of "<<expected[i].name<<" at "<<expected[i].pos<<" with size "<<expected[i].size;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool testTarHeaders()
+{
+	constexpr uint64_t block = TarScanner::BLOCK_SIZE;
+	// a sparse archive that is just large enough to be split into two scan ranges
+	const uint64_t length = 2*TarScanner::MIN_RANGE_SIZE + 64*block;
+	const uint64_t boundary = (length/2 + block - 1)/block*block;
+	std::map<uint64_t, std::string> blocks;
+
+	const std::string paxName = "a/very/long/directory/name/that/does/not/fit/into/the/name/field/of/a/ustar/header/pax_member.bin";
+	const std::string paxData = paxRecord("path", paxName) + paxRecord("size", "1000");
+	blocks[0] = tarHeader("PaxHeaders/pax_member.bin", paxData.size(), 'x');
+	blocks[block] = paxData;
+	blocks[2*block] = tarHeader("pax_member.bin", 0, '0');
+
+	const std::string longName = "another/very/long/directory/name/that/does/not/fit/into/the/ustar/name/field/gnu_long_member.bin";
+	const uint64_t longSize = boundary - 9*block;
+	blocks[5*block] = tarHeader("././@LongLink", longName.size()+1, 'L');
+	blocks[6*block] = longName;
+	blocks[7*block] = tarHeader(longName.substr(0, 100), longSize, '0', "", true);
+
+	// the first range ends on this extension header, its data is the first block of the second range
+	const std::string boundaryData = paxRecord("path", "after/boundary/file.bin");
+	blocks[boundary-block] = tarHeader("PaxHeaders/file.bin", boundaryData.size(), 'x');
+	blocks[boundary] = boundaryData;
+	blocks[boundary+block] = tarHeader("file.bin", 10, '0');
+	blocks[boundary+3*block] = tarHeader("prefixed.txt", 5, '0', "some/prefix");
+	blocks[boundary+4*block] = "hello";
+
+	const std::vector<TarScanner::Member> expected = {
+		{paxName, 3*block, 1000},
+		{longName, 8*block, longSize},
+		{"after/boundary/file.bin", boundary+2*block, 10},
+		{"some/prefix/prefixed.txt", boundary+4*block, 5}
+	};
+
+	const TarScanner::Reader reader = [&blocks, length](char* buffer, size_t size, uint64_t offset) -> size_t
+	{
+		size = std::min<uint64_t>(size, length - std::min(offset, length));
+		std::memset(buffer, 0, size);
+		for(const std::pair<const uint64_t, std::string>& data : blocks)
+		{
+			uint64_t begin = std::max(data.first, offset);
+			uint64_t end = std::min(data.first + data.second.size(), offset + size);
+			if(begin < end)
+				std::memcpy(buffer + (begin - offset), data.second.data() + (begin - data.first), end - begin);
+		}
+		return size;
+	};
+
+	MemoryTar memory = {};
+	memory.reader = &reader;
+	memory.tar.read = [](mtar_t* tar, void* data, size_t size) -> int
+	{
+		const TarScanner::Reader& reader = *reinterpret_cast<MemoryTar*>(tar)->reader;
+		return reader(static_cast<char*>(data), size, tar->pos) == size ? MTAR_ESUCCESS : MTAR_EREADFAIL;
+	};
+	memory.tar.seek = [](mtar_t* tar, uint64_t pos) -> int {return MTAR_ESUCCESS;};
+	memory.tar.close = [](mtar_t* tar) -> int {return MTAR_ESUCCESS;};
+
+	// iterate the archive the same way CoinCellHellLoader does
+	std::vector<TarScanner::Member> members;
+	std::vector<mtar_header_t> headers;
+	mtar_header_t header;
+	int err;
+	while((err = mtar_read_header(&memory.tar, &header)) == MTAR_ESUCCESS)
+	{
+		if(header.type == MTAR_TREG)
+		{
+			members.push_back({header.name, memory.tar.data_pos, header.size});
+			headers.push_back(header);
+		}
+		err = mtar_next(&memory.tar);
+		if(err != MTAR_ESUCCESS)
+			break;
+	}
+	if(err != MTAR_ENULLRECORD)
+	{
+		Log(Log::ERROR)<<__func__<<" mtar_read_header failed with "<<mtar_strerror(err);
+		return false;
+	}
+	if(!checkTarMembers(members, expected, "mtar_read_header"))
+		return false;
+
+	char data[6] = {};
+	err = mtar_seek(&memory.tar, headers.back().pos);
+	if(err == MTAR_ESUCCESS)
+		err = mtar_read_data(&memory.tar, data, headers.back().size);
+	if(err != MTAR_ESUCCESS || std::string(data) != "hello")
+	{
+		Log(Log::ERROR)<<__func__<<" mtar_read_data returned "<<data<<" with "<<mtar_strerror(err);
+		return false;
+	}
+
+	try
+	{
+		TarScanner scanner(reader, length, "test archive");
+		if(!checkTarMembers(scanner.scan(2), expected, "TarScanner with two ranges"))
+			return false;
+		if(!checkTarMembers(scanner.scan(1), expected, "TarScanner with one range"))
+			return false;
+	}
+	catch(const TarScanner::scan_error& err)
+	{
+		Log(Log::ERROR)<<__func__<<" TarScanner failed with "<<err.what();
+		return false;
+	}
+
+	return true;
+}
+
+bool testTarWrite()
+{
+	const std::filesystem::path path = std::filesystem::temp_directory_path()/"torchkissann-tarwrite.tar";
+	const std::string name = "a/name/that/is/longer/than/the/one/hundred/bytes/of/the/ustar/name/field/and/needs/a/gnu/long/name/record.txt";
+	const std::string content = "hello";
+
+	mtar_t tar;
+	int err = mtar_open(&tar, path.c_str(), "w");
+	if(err != MTAR_ESUCCESS)
+	{
+		Log(Log::ERROR)<<__func__<<" could not create "<<path<<": "<<mtar_strerror(err);
+		return false;
+	}
+	if(mtar_write_file_header(&tar, std::string(MTAR_NAME_MAX, 'a').c_str(), 0) == MTAR_ESUCCESS)
+	{
+		Log(Log::ERROR)<<__func__<<" a name longer than MTAR_NAME_MAX was accepted";
+		mtar_close(&tar);
+		std::filesystem::remove(path);
+		return false;
+	}
+	mtar_write_file_header(&tar, name.c_str(), content.size());
+	mtar_write_data(&tar, content.data(), content.size());
+	mtar_finalize(&tar);
+	mtar_close(&tar);
+
+	mtar_header_t header;
+	char data[6] = {};
+	err = mtar_open(&tar, path.c_str(), "r");
+	if(err == MTAR_ESUCCESS)
+	{
+		err = mtar_read_header(&tar, &header);
+		if(err == MTAR_ESUCCESS)
+			err = mtar_read_data(&tar, data, content.size());
+		mtar_close(&tar);
+	}
+	std::filesystem::remove(path);
+
+	if(err != MTAR_ESUCCESS || header.name != name || data != content)
+	{
+		Log(Log::ERROR)<<__func__<<" read back "<<(err == MTAR_ESUCCESS ? header.name : mtar_strerror(err))<<" instead of "<<name;
+		return false;
+	}
+	return true;
+}
+
+static void writeTestSpectra(const std::filesystem::path& path, const std::string& model, double real)
+{
+	std::ofstream file(path, std::ios_base::out | std::ios_base::trunc);
+	file<<"EISF, 1.0.0\n"
+		<<"\""<<model<<"\", test spectra\n"
+		<<"labelsNames\n"
+		<<"\"r1\"\n"
+		<<"labels\n"
+		<<real<<"\n"
+		<<"omega, real, im\n"
+		<<"\n"
+		<<"1.000000e+00, "<<real<<", -1.000000e+00\n"
+		<<"1.000000e+01, "<<real/2<<", -2.000000e+00\n"
+		<<"1.000000e+02, "<<real/4<<", -3.000000e+00\n";
+}
+
+bool testShardedDataset()
+{
+	const std::filesystem::path dir = std::filesystem::temp_directory_path()/"torchkissann-shardtest";
+	std::filesystem::remove_all(dir);
+	const std::vector<std::vector<std::string>> shardModels = {{"r{100}c{1e-5}", "r{100}-c{1e-5}"}, {"r{10}l{1e-3}", "r{10}-l{1e-3}"}};
+	constexpr size_t filesPerShard = 6;
+
+	std::vector<std::filesystem::path> shardPaths;
+	std::ofstream manifest(dir/"shards.manifest");
+	for(size_t shard = 0; shard < shardModels.size(); ++shard)
+	{
+		shardPaths.push_back(dir/("shard_" + std::to_string(shard)));
+		std::filesystem::create_directories(shardPaths.back());
+		for(size_t i = 0; i < filesPerShard; ++i)
+		{
+			writeTestSpectra(shardPaths.back()/("spectra_" + std::to_string(i) + ".csv"),
+				shardModels[shard][i % shardModels[shard].size()], 100 + 10*shard + i);
+		}
+		manifest<<shardPaths.back().filename().string()<<'\n';
+	}
+	manifest.close();
+
+	bool ret = true;
+	try
+	{
+		// opening the shards on their own creates their indices and gives the reference examples
+		std::vector<std::unique_ptr<EisDirDataset>> shards;
+		for(const std::filesystem::path& path : shardPaths)
+			shards.push_back(std::make_unique<EisDirDataset>(path));
+
+		// with a valid index the second shard must not be opened before it is accessed, its first file is
+		// broken without touching the directory, so that opening the shard fails until the file is restored
+		DatasetIndex index;
+		index.load(shardPaths[1]);
+		const std::filesystem::path firstFile = shardPaths[1]/index.entries->front().path;
+		std::string firstContent;
+		{
+			std::ifstream file(firstFile);
+			firstContent.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+		std::ofstream(firstFile, std::ios_base::out | std::ios_base::trunc)<<"not a spectra";
+		try
+		{
+			ShardedDataset<EisDirDataset> lazy(dir/"shards.manifest");
+			if(lazy.size().value() != shardModels.size()*filesPerShard)
+			{
+				Log(Log::ERROR)<<__func__<<" the sharded dataset has "<<lazy.size().value()<<" examples";
+				ret = false;
+			}
+		}
+		catch(const std::exception& err)
+		{
+			Log(Log::ERROR)<<__func__<<" the second shard was opened before it was accessed: "<<err.what();
+			ret = false;
+		}
+		std::ofstream(firstFile, std::ios_base::out | std::ios_base::trunc)<<firstContent;
+
+		ShardedDataset<EisDirDataset> dataset(dir/"shards.manifest");
+		if(ret && dataset.outputSize() != 4)
+		{
+			Log(Log::ERROR)<<__func__<<" the merged class table has "<<dataset.outputSize()<<" classes instead of 4";
+			ret = false;
+		}
+
+		std::vector<size_t> indices(dataset.size().value());
+		std::iota(indices.begin(), indices.end(), 0);
+		torch::data::Example<torch::Tensor, torch::Tensor> batch = dataset.getBatch(indices);
+		for(size_t i = 0; i < indices.size() && ret; ++i)
+		{
+			EisDirDataset& shard = *shards[i/filesPerShard];
+			torch::data::Example<torch::Tensor, torch::Tensor> expected = shard.get(i % filesPerShard);
+			std::string expectedClass = shard.outputName(expected.target[0].item<int64_t>());
+
+			// both the single example and the batch path have to remap the shard's class ids
+			torch::data::Example<torch::Tensor, torch::Tensor> example = dataset.get(i);
+			std::string exampleClass = dataset.outputName(example.target[0].item<int64_t>());
+			std::string batchClass = dataset.outputName(batch.target[i].item<int64_t>());
+			if(!torch::equal(example.data, expected.data) || !torch::equal(batch.data[i], expected.data) ||
+				exampleClass != expectedClass || batchClass != expectedClass)
+			{
+				Log(Log::ERROR)<<__func__<<" example "<<i<<" is of class "<<exampleClass<<" and "<<batchClass<<" in a batch instead of "
+					<<expectedClass<<" or its data dose not match its shard";
+				ret = false;
+			}
+		}
+	}
+	catch(const std::exception& err)
+	{
+		Log(Log::ERROR)<<__func__<<" failed to load the shards: "<<err.what();
+		ret = false;
+	}
+
+	std::filesystem::remove_all(dir);
+	return ret;
+}
+
 int main(int argc, char** argv)
 {
 	Log::level = Log::DEBUG;
@@ -241,8 +913,29 @@ int main(int argc, char** argv)
 	//testParaDataset();
 	testEisScript();*/
 	//testEisDistanceLoss();
-	//testFit();
 	testScriptnet();
+	if(!testSpectraParser())
+		Log(Log::ERROR)<<"testSpectraParser failed";
+	if(!testSampleCache())
+		Log(Log::ERROR)<<"testSampleCache failed";
+	if(!testColumnStats())
+		Log(Log::ERROR)<<"testColumnStats failed";
+	if(!testKeyedAugmentation())
+		Log(Log::ERROR)<<"testKeyedAugmentation failed";
+	if(!testCircuitModel())
+		Log(Log::ERROR)<<"testCircuitModel failed";
+	if(!testEisDistanceLossCache())
+		Log(Log::ERROR)<<"testEisDistanceLossCache failed";
+	if(!testFit())
+		Log(Log::ERROR)<<"testFit failed";
+	if(!testTarHeaders())
+		Log(Log::ERROR)<<"testTarHeaders failed";
+	if(!testTarWrite())
+		Log(Log::ERROR)<<"testTarWrite failed";
+	if(!testPhilox())
+		Log(Log::ERROR)<<"testPhilox failed";
+	if(!testShardedDataset())
+		Log(Log::ERROR)<<"testShardedDataset failed";
 
 	free_device();
 	return 0;
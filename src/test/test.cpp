@@ -37,6 +37,8 @@
 #include "data/loaders/dirloader.h"
 #include "data/loaders/regressiondirloader.h"
 #include "data/loaders/regressionloader.h"
+#include "data/loaders/packeddataset.h"
+#include "data/loaders/syntheticdataset.h"
 #include "options.h"
 #include "globals.h"
 #include "tensoroperators.h"
@@ -47,14 +49,15 @@
 template <typename T>
 int inputImportance(std::shared_ptr<ann::Net> net, T* dataset, int64_t window, const Config& config)
 {
-	std::vector<double> losses(dataset->inputSize());
+	const size_t inputSize = dataset->inputSize();
+	std::vector<double> losses(inputSize);
 
 	std::pair<torch::Tensor, torch::Tensor> ranges = dataset->inputRanges();
 
-	for(size_t i = 0; i < dataset->inputSize(); ++i)
+	for(size_t i = 0; i < inputSize; ++i)
 	{
-		std::vector<DropDesc> desc(dataset->inputSize(), {0, 0, 0, 0});
-		for(size_t j = (static_cast<int64_t>(i) - window) > 0 ? static_cast<int64_t>(i) - window : 0; j <= i+window && j < dataset->inputSize(); ++j)
+		std::vector<DropDesc> desc(inputSize, {0, 0, 0, 0});
+		for(size_t j = (static_cast<int64_t>(i) - window) > 0 ? static_cast<int64_t>(i) - window : 0; j <= i+window && j < inputSize; ++j)
 		{
 			desc[j].dropout = true;
 			desc[j].max = ranges.first[j].item<float>();
@@ -66,13 +69,13 @@ int inputImportance(std::shared_ptr<ann::Net> net, T* dataset, int64_t window, c
 
 		torch::data::DataLoaderOptions options;
 		options = options.batch_size(batch_size).workers(16);
-		auto dataLoader = torch::data::make_data_loader(dataset->map(torch::data::transforms::Stack<>()), options);
+		auto dataLoader = torch::data::make_data_loader(EisBatchDataset<T>(dataset), options);
 		torch::Tensor weights =  torch::ones({static_cast<int64_t>(dataset->outputSize())}).to(*offload_device);
 		losses[i] = ann::classification::test(net, *dataLoader, dataset->size().value(), dataset->outputSize(), weights, dataset->isMulticlass()).loss;
 	}
 
-	std::vector<double> indecies(dataset->inputSize());
-	for(size_t i = 0; i < dataset->inputSize(); ++i)
+	std::vector<double> indecies(inputSize);
+	for(size_t i = 0; i < inputSize; ++i)
 		indecies[i] = i;
 
 	csv::save(config.outputDir/("loss_importance"+std::to_string(window)+".svg"), losses, "loss importance");
@@ -118,7 +121,7 @@ int test(const Config& config)
 
 	torch::data::DataLoaderOptions options;
 	options = options.batch_size(batch_size).workers(16);
-	auto dataLoader = torch::data::make_data_loader(dataset.map(torch::data::transforms::Stack<>()), options);
+	auto dataLoader = torch::data::make_data_loader(EisBatchDataset<T>(&dataset), options);
 
 	ann::classification::TestReturn testRet = ann::classification::test(net, *dataLoader, dataset.size().value(), dataset.outputSize(), dataset.classWeights(), dataset.isMulticlass());
 	Log(Log::INFO)<<"Test loss: "<<testRet.loss<<"\nAcc:\n"<<tensorToString(testRet.acc);
@@ -143,14 +146,15 @@ int test(const Config& config)
 template <typename T>
 int inputImportanceRegression(std::shared_ptr<ann::Net> net, T* dataset, int64_t window, const Config& config)
 {
-	std::vector<ann::regression::TestReturn> returns(dataset->inputSize());
+	const size_t inputSize = dataset->inputSize();
+	std::vector<ann::regression::TestReturn> returns(inputSize);
 
 	std::pair<torch::Tensor, torch::Tensor> ranges = dataset->inputRanges();
 
-	for(size_t i = 0; i < dataset->inputSize(); ++i)
+	for(size_t i = 0; i < inputSize; ++i)
 	{
-		std::vector<DropDesc> desc(dataset->inputSize(), {0, 0, 0, 0});
-		for(size_t j = (static_cast<int64_t>(i) - window) > 0 ? static_cast<int64_t>(i) - window : 0; j <= i+window && j < dataset->inputSize(); ++j)
+		std::vector<DropDesc> desc(inputSize, {0, 0, 0, 0});
+		for(size_t j = (static_cast<int64_t>(i) - window) > 0 ? static_cast<int64_t>(i) - window : 0; j <= i+window && j < inputSize; ++j)
 		{
 			desc[j].dropout = true;
 			desc[j].max = ranges.first[j].item<float>();
@@ -162,15 +166,15 @@ int inputImportanceRegression(std::shared_ptr<ann::Net> net, T* dataset, int64_t
 
 		torch::data::DataLoaderOptions options;
 		options = options.batch_size(batch_size).workers(16);
-		auto dataLoader = torch::data::make_data_loader(dataset->map(torch::data::transforms::Stack<>()), options);
+		auto dataLoader = torch::data::make_data_loader(EisBatchDataset<T>(dataset), options);
 		std::unique_ptr<torch::nn::MSELoss> lossMse(new torch::nn::MSELoss(torch::nn::MSELossOptions().reduction(torch::kMean)));
 		returns[i] = ann::regression::test(net, *dataLoader, *lossMse, dataset->size().value());
 	}
 
-	std::valarray<double> indecies(dataset->inputSize());
-	std::vector<torch::Tensor> r2s(dataset->inputSize());
-	std::valarray<double> loss(dataset->inputSize());
-	for(size_t i = 0; i < dataset->inputSize(); ++i)
+	std::valarray<double> indecies(inputSize);
+	std::vector<torch::Tensor> r2s(inputSize);
+	std::valarray<double> loss(inputSize);
+	for(size_t i = 0; i < inputSize; ++i)
 	{
 		indecies[i] = i;
 		ann::regression::TestReturn ret = returns[i];
@@ -180,8 +184,8 @@ int inputImportanceRegression(std::shared_ptr<ann::Net> net, T* dataset, int64_t
 
 	for(size_t i = 0; i < dataset->outputSize(); ++i)
 	{
-		std::valarray<double> r2(dataset->inputSize());
-		for(size_t j = 0; j < dataset->inputSize(); ++j)
+		std::valarray<double> r2(inputSize);
+		for(size_t j = 0; j < inputSize; ++j)
 			r2[j] = std::max(r2s[j][i].item<float>(), 0.0f);
 		csv::save(config.outputDir/("r2_"+std::to_string(i)+"_importance_"+std::to_string(window)+".csv"), r2, "r2");
 		save2dPlot(config.outputDir/("r2_"+std::to_string(i)+"_importance_"+std::to_string(window)+".svg"), "Input", "r2", indecies, r2, false, false, true);
@@ -270,7 +274,7 @@ int testRegression(const Config& config)
 
 	torch::data::DataLoaderOptions options;
 	options = options.batch_size(batch_size).workers(16);
-	auto dataLoader = torch::data::make_data_loader(dataset.map(torch::data::transforms::Stack<>()), options);
+	auto dataLoader = torch::data::make_data_loader(EisBatchDataset<T>(&dataset), options);
 
 	std::unique_ptr<torch::nn::MSELoss> lossMse(new torch::nn::MSELoss(torch::nn::MSELossOptions().reduction(torch::kMean)));
 	ann::regression::TestReturn ret = ann::regression::test(net, *dataLoader, *lossMse, dataset.size().value());
@@ -342,6 +346,14 @@ int main(int argc, char** argv)
 			return testRegression<RegressionLoaderDir>(config);
 		case DATASET_TAR_REGRESSION:
 			return testRegression<RegressionLoaderTar>(config);
+		case DATASET_PACKED:
+			if(EisPackedDataset::isRegressionFile(config.fileName))
+				return testRegression<EisPackedDataset>(config);
+			return test<EisPackedDataset>(config);
+		case DATASET_SYNTHETIC:
+			return test<EisSyntheticDataset>(config);
+		case DATASET_SYNTHETIC_REGRESSION:
+			return testRegression<RegressionLoaderSynthetic>(config);
 		case DATASET_INVALID:
 			Log(Log::ERROR)<<"You must specify a valid dataset to use: " DATASET_LIST;
 			break;
@@ -24,6 +24,8 @@
 #include <argp.h>
 #include <iostream>
 #include <filesystem>
+#include <optional>
+#include <cstdint>
 #include "utils/log.h"
 #include "commonoptions.h"
 
@@ -40,7 +42,7 @@ static struct argp_option options[] =
   {"quiet", 		'q', 0,				0,	"only output data" },
   {"model", 		'm', "[STRING]",	0,	"model to train: " MODE_LIST},
   {"dataset", 		'd', "[STRING]",	0,	"dataset type to use for training: " DATASET_LIST},
-  {"file", 			'f', "[STRING]",	0,	"filename for dataset"},
+  {"file", 			'f', "[STRING]",	0,	"filename for dataset, a glob or a .manifest file listing one file per line combines several shards"},
   {"test",			't', "[STRING]",	0,	"filename for the test dataset"},
   {"batch-size",	'b', "[NUMBER]",	0,	"size of the training batch"},
   {"epochs",		'i', "[NUMBER]",	0,	"maximum number of epochs to train, may exit earlier due to lack of progress"},
@@ -51,6 +53,18 @@ static struct argp_option options[] =
   {"network",		'n', "[PATH]",		0,	"torchScript network to train"},
   {"no-weights",	'g', 0,				0, 	"Don't use class weights"},
   {"latent-size",	'a', "[NUMBER]",	0, 	"Size of the latent vector for the autoencoder"},
+  {"workers",		'w', "[NUMBER]",	0, 	"number of threads decoding training data, default: number of cpu threads"},
+  {"cache",		'k', "[MiB]",		0, 	"cache decoded training data after the first epoch using up to this much memory per dataset, the rest is spilled to disk"},
+  {"cache-dir",		's', "[DIRECTORY]",	0, 	"directory for the cache spill file, default: the system temporary directory"},
+  {"shuffle-block",	'x', "[NUMBER]",	0, 	"shuffle blocks of this many consecutive examples instead of single examples, improves read locality of archives"},
+  {"shuffle-buffer",	'u', "[NUMBER]",	0, 	"size of the buffer the examples of shuffled blocks are mixed in, default: 64 blocks"},
+  {"prefetch",		'p', "[NUMBER]",	0, 	"number of decoded batches to keep ready for the trainer, default: 8"},
+  {"noise",			'z', "[NUMBER]",	0, 	"add gaussian noise to the training inputs with this standard deviation relative to each input"},
+  {"jitter",		'j', "[NUMBER]",	0, 	"randomly shift the training spectra along the frequency axis by up to this many points"},
+  {"replace",		'y', "[NUMBER]",	0, 	"probability of replacing a training input with a random value in the range of the input"},
+  {"seed",			'e', "[NUMBER]",	0, 	"seed for shuffling and augmentation, default: a random seed"},
+  {"check-interval",	'N', "[NUMBER]",	0, 	"check for NAN or INF values every this many training steps, default: 64"},
+  {"snapshot-interval",	'S', "[NUMBER]",	0, 	"keep a copy of the network at most this many steps old to write when a NAN or INF is detected, 0 only at the start of every epoch, default: 1024"},
   { 0 }
 };
 
@@ -126,8 +140,21 @@ struct Config
 	size_t epochs = 30;
 	size_t extraLayers = 3;
 	size_t latentSize = 10;
+	size_t workers = 0;
+	size_t prefetch = 8;
+	size_t shuffleBlock = 0;
+	size_t shuffleBuffer = 0;
+	bool cache = false;
+	size_t cacheBudget = 0;
+	std::filesystem::path cacheDir = std::filesystem::temp_directory_path();
 	bool noGpu = false;
 	bool noWeights = false;
+	float noise = 0;
+	float frequencyJitter = 0;
+	float replaceProbability = 0;
+	std::optional<uint64_t> seed;
+	size_t checkInterval = 64;
+	size_t snapshotInterval = 1024;
 };
 
 static error_t parse_opt (int key, char *arg, struct argp_state *state)
@@ -193,6 +220,43 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 		case 'a':
 			config->latentSize = std::stoul(std::string(arg));
 			break;
+		case 'w':
+			config->workers = std::stoul(std::string(arg));
+			break;
+		case 'k':
+			config->cache = true;
+			config->cacheBudget = std::stoul(std::string(arg))*1024*1024;
+			break;
+		case 's':
+			config->cacheDir.assign(arg);
+			break;
+		case 'x':
+			config->shuffleBlock = std::stoul(std::string(arg));
+			break;
+		case 'u':
+			config->shuffleBuffer = std::stoul(std::string(arg));
+			break;
+		case 'p':
+			config->prefetch = std::stoul(std::string(arg));
+			break;
+		case 'z':
+			config->noise = std::stof(std::string(arg));
+			break;
+		case 'j':
+			config->frequencyJitter = std::stof(std::string(arg));
+			break;
+		case 'y':
+			config->replaceProbability = std::stof(std::string(arg));
+			break;
+		case 'e':
+			config->seed = std::stoull(std::string(arg));
+			break;
+		case 'N':
+			config->checkInterval = std::stoul(std::string(arg));
+			break;
+		case 'S':
+			config->snapshotInterval = std::stoul(std::string(arg));
+			break;
 		default:
 			return ARGP_ERR_UNKNOWN;
 		}
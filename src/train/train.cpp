@@ -46,9 +46,14 @@
 #include "data/regressiondataset.h"
 #include "data/loaders/regressionloader.h"
 #include "data/loaders/dirloader.h"
+#include "data/loaders/packeddataset.h"
+#include "data/loaders/syntheticdataset.h"
+#include "data/shardeddataset.h"
 #include "options.h"
 #include "trainlog.h"
+#include "randomgen.h"
 #include "tokenize.h"
+#include "shardlist.h"
 
 template <typename DataSetType>
 int train(const Config& config);
@@ -60,7 +65,20 @@ template <typename DataSetType, typename TestDataSetType = DataSetType>
 void trainSwitch(const Config& config, EisDataset<DataSetType>* dataset, EisDataset<TestDataSetType>* testDataset);
 
 template <typename DataSetType>
-int train(const Config& config)
+static void enableCache(const Config& config, EisDataset<DataSetType>* dataset)
+{
+	try
+	{
+		dataset->enableCache(config.cacheBudget, config.cacheDir);
+	}
+	catch(const SampleCache::cache_error& err)
+	{
+		Log(Log::WARN)<<"Unable to cache dataset, continuing without cache: "<<err.what();
+	}
+}
+
+template <typename DataSetType>
+int loadAndTrain(const Config& config)
 {
 	if(config.fileName.empty())
 	{
@@ -89,6 +107,20 @@ int train(const Config& config)
 		}
 	}
 
+	if(config.cache)
+	{
+		enableCache(config, &dataset);
+		if(testDataset)
+			enableCache(config, testDataset);
+	}
+
+	AugmentationOptions augmentation;
+	augmentation.noise = config.noise;
+	augmentation.frequencyJitter = config.frequencyJitter;
+	augmentation.replaceProbability = config.replaceProbability;
+	if(!augmentation.empty())
+		dataset.setAugmentation(augmentation);
+
 	trainSwitch<DataSetType, DataSetType>(config, &dataset, testDataset);
 
 	if(testDataset)
@@ -96,6 +128,24 @@ int train(const Config& config)
 	return 0;
 }
 
+template <typename DataSetType>
+int train(const Config& config)
+{
+	if(isShardSpec(config.fileName) || isShardSpec(config.testFileName))
+	{
+		try
+		{
+			return loadAndTrain<ShardedDataset<DataSetType>>(config);
+		}
+		catch(const dataset_error& err)
+		{
+			Log(Log::ERROR)<<err.what();
+			return 2;
+		}
+	}
+	return loadAndTrain<DataSetType>(config);
+}
+
 template <typename DataSetType, typename TestDataSetType>
 void trainSwitch(const Config& config, EisDataset<DataSetType>* trainDataset, EisDataset<TestDataSetType>* testDataset)
 {
@@ -268,7 +318,9 @@ bool check_options(const Config& config)
 	}
 
 	if((config.datasetMode != DATASET_DIR_REGRESSION &&
-		config.datasetMode != DATASET_TAR_REGRESSION) &&
+		config.datasetMode != DATASET_TAR_REGRESSION &&
+		config.datasetMode != DATASET_SYNTHETIC_REGRESSION &&
+		config.datasetMode != DATASET_PACKED) &&
 		(config.mode == MODE_REGRESSION || config.mode == MODE_REGRESSION_SCRIPT))
 	{
 		Log(Log::ERROR)<<"The regression mode can only be trained with a regression dataset";
@@ -301,6 +353,17 @@ int main(int argc, char** argv)
 
 	choose_device(config.noGpu);
 	batch_size = config.batchSize;
+	data_workers = config.workers;
+	prefetch_depth = config.prefetch;
+	shuffle_block = config.shuffleBlock;
+	shuffle_buffer = config.shuffleBuffer ? config.shuffleBuffer : config.shuffleBlock*64;
+	anomaly_check_interval = config.checkInterval;
+	anomaly_snapshot_interval = config.snapshotInterval;
+	if(config.seed)
+		rd::seed(*config.seed);
+	else
+		rd::init();
+	Log(Log::INFO)<<"Using seed "<<rd::getSeed();
 
 	if(!check_options(config))
 		return 3;
@@ -319,6 +382,12 @@ int main(int argc, char** argv)
 			return train<RegressionLoaderDir>(config);
 		case DATASET_TAR_REGRESSION:
 			return train<RegressionLoaderTar>(config);
+		case DATASET_PACKED:
+			return train<EisPackedDataset>(config);
+		case DATASET_SYNTHETIC:
+			return train<EisSyntheticDataset>(config);
+		case DATASET_SYNTHETIC_REGRESSION:
+			return train<RegressionLoaderSynthetic>(config);
 		case DATASET_INVALID:
 			Log(Log::ERROR)<<"You must specify a valid dataset to use: " DATASET_LIST;
 			break;
@@ -0,0 +1,130 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "anomalyguard.h"
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+
+#include "log.h"
+
+AnomalyGuard::AnomalyGuard(ann::Net& net, size_t checkIntervalIn, size_t snapshotIntervalIn):
+checkInterval(std::max<size_t>(checkIntervalIn, 1)), snapshotInterval(snapshotIntervalIn)
+{
+	takeSnapshot(net);
+}
+
+void AnomalyGuard::takeSnapshot(ann::Net& net)
+{
+	torch::NoGradGuard noGrad;
+	std::vector<torch::Tensor> parameters = net.parameters();
+	snapshot.resize(parameters.size());
+	for(size_t i = 0; i < parameters.size(); ++i)
+	{
+		if(snapshot[i].defined() && snapshot[i].sizes() == parameters[i].sizes() && snapshot[i].device() == parameters[i].device())
+			snapshot[i].copy_(parameters[i]);
+		else
+			snapshot[i] = parameters[i].detach().clone();
+	}
+	snapshotStep = steps;
+}
+
+void AnomalyGuard::watch(const torch::Tensor& tensor)
+{
+	torch::NoGradGuard noGrad;
+	torch::Tensor tensorFinite = torch::isfinite(tensor.detach()).all();
+	finite = finite.defined() ? finite.logical_and(tensorFinite) : tensorFinite;
+}
+
+void AnomalyGuard::recordIndices(const std::vector<size_t>& indices)
+{
+	uncheckedIndices.push_back(indices);
+}
+
+bool AnomalyGuard::step(ann::Net& net)
+{
+	++steps;
+	if(steps - checkedStep < checkInterval)
+		return true;
+	return check(net);
+}
+
+bool AnomalyGuard::check(ann::Net& net)
+{
+	// the parameters were updated after the watched forward pass, so they are checked too before they become the snapshot
+	const bool snapshotDue = snapshotInterval > 0 && steps - snapshotStep >= snapshotInterval;
+	if(snapshotDue)
+	{
+		for(const torch::Tensor& parameter : net.parameters())
+			watch(parameter);
+	}
+
+	if(finite.defined() && !finite.item<bool>())
+		return false;
+	finite = torch::Tensor();
+	checkedStep = steps;
+	uncheckedIndices.clear();
+
+	if(snapshotDue)
+		takeSnapshot(net);
+	return true;
+}
+
+std::filesystem::path AnomalyGuard::writeBundle(ann::Net& net, const std::filesystem::path& dir, size_t epoch, const std::string& description,
+												 const std::vector<std::pair<std::string, torch::Tensor>>& tensors)
+{
+	std::filesystem::path bundleDir = dir/("anomaly_" + std::to_string(epoch) + "_" + std::to_string(steps));
+	std::filesystem::create_directories(bundleDir);
+
+	std::ofstream file(bundleDir/"anomaly.txt");
+	file<<description<<'\n';
+	file<<"detected at step "<<steps<<" of the epoch, the last check passed at step "<<checkedStep<<'\n';
+	file<<"snapshot taken at step "<<snapshotStep<<'\n';
+	file<<"dataset indices of the unchecked steps are in indices.txt\n";
+
+	std::ofstream indicesFile(bundleDir/"indices.txt");
+	for(size_t i = 0; i < uncheckedIndices.size(); ++i)
+	{
+		indicesFile<<"step "<<steps - uncheckedIndices.size() + i + 1<<':';
+		for(size_t index : uncheckedIndices[i])
+			indicesFile<<' '<<index;
+		indicesFile<<'\n';
+	}
+	for(const std::pair<std::string, torch::Tensor>& tensor : tensors)
+	{
+		if(!tensor.second.defined())
+			continue;
+		torch::save(tensor.second.cpu(), bundleDir/(tensor.first + ".pt"));
+		file<<tensor.first<<": "<<tensor.second.sizes()<<'\n';
+	}
+
+	net.saveToCheckpointDir(bundleDir/"anomalous");
+
+	torch::NoGradGuard noGrad;
+	std::vector<torch::Tensor> parameters = net.parameters();
+	assert(parameters.size() == snapshot.size());
+	for(size_t i = 0; i < parameters.size(); ++i)
+		parameters[i].copy_(snapshot[i]);
+	net.saveToCheckpointDir(bundleDir/"snapshot");
+
+	Log(Log::ERROR)<<"Wrote anomaly bundle to "<<bundleDir;
+	return bundleDir;
+}
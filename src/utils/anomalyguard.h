@@ -0,0 +1,97 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "net.h"
+
+/**
+ * @brief Detects non finite values during training without synchronizing with the device every step.
+ *
+ * The tensors passed to watch are reduced into a single flag on their device, which is only read back every
+ * checkInterval steps. When at least snapshotInterval steps passed since the last snapshot, the parameters of the
+ * network are included in the check and, if it passes, copied on the device, so that the last known good state
+ * is available once an anomaly is detected.
+ */
+class AnomalyGuard
+{
+private:
+	size_t checkInterval;
+	size_t snapshotInterval;
+	torch::Tensor finite;
+	size_t steps = 0;
+	size_t checkedStep = 0;
+	std::vector<torch::Tensor> snapshot;
+	size_t snapshotStep = 0;
+	// the dataset indices of every step since the last passing check, any of them may have caused an anomaly
+	std::vector<std::vector<size_t>> uncheckedIndices;
+
+	void takeSnapshot(ann::Net& net);
+
+public:
+	AnomalyGuard(ann::Net& net, size_t checkInterval, size_t snapshotInterval);
+
+	/**
+	 * @brief Adds tensor to the values checked at the next check
+	 */
+	void watch(const torch::Tensor& tensor);
+
+	/**
+	 * @brief Records the dataset indices of the examples in the current step, so that they can be written to a bundle
+	 */
+	void recordIndices(const std::vector<size_t>& indices);
+
+	/**
+	 * @brief Ends a training step and checks the watched tensors if checkInterval steps passed since the last check
+	 *
+	 * @return false if a watched tensor contained a non finite value
+	 */
+	bool step(ann::Net& net);
+
+	/**
+	 * @brief Checks the watched tensors now, synchronizing with the device
+	 *
+	 * @return false if a watched tensor contained a non finite value
+	 */
+	bool check(ann::Net& net);
+
+	/**
+	 * @brief Writes a bundle to reproduce an anomaly to dir
+	 *
+	 * The bundle contains the network in its current state and in the state of the last snapshot as checkpoints,
+	 * the given tensors, the dataset indices of every step since the last passing check and a description of when
+	 * the anomaly occurred.
+	 * The parameters of net are restored to the last snapshot afterwards.
+	 *
+	 * @param net the network that was trained
+	 * @param dir the directory to create the bundle in
+	 * @param epoch the epoch the anomaly occurred in, steps are counted per epoch
+	 * @param description text describing the run, like the seed and epoch the anomaly occurred in
+	 * @param tensors named tensors to save, typically the inputs, targets and predictions of the last step
+	 * @return the directory of the bundle
+	 */
+	std::filesystem::path writeBundle(ann::Net& net, const std::filesystem::path& dir, size_t epoch, const std::string& description,
+									  const std::vector<std::pair<std::string, torch::Tensor>>& tensors);
+};
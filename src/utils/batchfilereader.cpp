@@ -0,0 +1,356 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "batchfilereader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+#ifdef ENABLE_URING
+#include <liburing.h>
+#endif
+
+#include "log.h"
+
+typedef BatchFileReader::Request Request;
+
+// one byte more than the hint, so that a file of the expected size is known to be complete after a single short read
+static void prepareBuffer(Request& request)
+{
+	if(request.buffer->size() < request.sizeHint + 1)
+		request.buffer->resize(request.sizeHint + 1);
+}
+
+// continues reading fd from request.size until a short read marks the end of the file
+static void readToEnd(int fd, Request& request)
+{
+	std::vector<char>& buffer = *request.buffer;
+	while(true)
+	{
+		if(request.size == buffer.size())
+			buffer.resize(std::max<size_t>(buffer.size()*2, 4096));
+		size_t want = buffer.size() - request.size;
+		ssize_t ret = pread(fd, buffer.data() + request.size, want, request.size);
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret < 0)
+		{
+			request.error = errno;
+			return;
+		}
+		request.size += ret;
+		if(static_cast<size_t>(ret) < want)
+			return;
+	}
+}
+
+static void readSync(Request& request)
+{
+	request.size = 0;
+	request.error = 0;
+	int fd = ::open(request.path, O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+	{
+		request.error = errno;
+		return;
+	}
+	prepareBuffer(request);
+	readToEnd(fd, request);
+	::close(fd);
+}
+
+class IoPool
+{
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<std::function<void()>> tasks;
+	std::vector<std::thread> threads;
+	bool stop = false;
+
+	void run()
+	{
+		while(true)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this](){return stop || !tasks.empty();});
+				if(stop && tasks.empty())
+					return;
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
+
+public:
+	explicit IoPool(size_t count)
+	{
+		for(size_t i = 0; i < count; ++i)
+			threads.push_back(std::thread(&IoPool::run, this));
+	}
+
+	~IoPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		condition.notify_all();
+		for(std::thread& thread : threads)
+			thread.join();
+	}
+
+	void post(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push_back(std::move(task));
+		}
+		condition.notify_one();
+	}
+};
+
+static void readPool(Request* requests, size_t count)
+{
+	static IoPool pool(BatchFileReader::POOL_THREADS);
+
+	struct Shared
+	{
+		Request* requests;
+		size_t count;
+		std::atomic<size_t> next = 0;
+		std::atomic<size_t> done = 0;
+		std::mutex mutex;
+		std::condition_variable condition;
+	};
+	std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+	shared->requests = requests;
+	shared->count = count;
+
+	// the pool threads and the calling thread claim requests until none are left,
+	// so a busy pool never stalls a caller and late helpers never touch the requests
+	auto drain = [shared]()
+	{
+		size_t i;
+		while((i = shared->next++) < shared->count)
+		{
+			readSync(shared->requests[i]);
+			if(++shared->done == shared->count)
+			{
+				std::lock_guard<std::mutex> lock(shared->mutex);
+				shared->condition.notify_all();
+			}
+		}
+	};
+
+	size_t helpers = std::min<size_t>(BatchFileReader::POOL_THREADS, count - 1);
+	for(size_t i = 0; i < helpers; ++i)
+		pool.post(drain);
+	drain();
+
+	std::unique_lock<std::mutex> lock(shared->mutex);
+	shared->condition.wait(lock, [&shared](){return shared->done == shared->count;});
+}
+
+#ifdef ENABLE_URING
+static std::atomic<bool> uringUnavailable = false;
+
+class Ring
+{
+	struct io_uring ring;
+	bool valid = false;
+
+	void fail(const std::string& reason)
+	{
+		if(!uringUnavailable.exchange(true))
+			Log(Log::WARN)<<"io_uring is unavailable ("<<reason<<"), files will be read by a thread pool";
+		if(valid)
+			io_uring_queue_exit(&ring);
+		valid = false;
+	}
+
+	// waits for count completions and passes the result of each to callback with the index of its request
+	bool complete(size_t count, const std::function<void(size_t, int)>& callback)
+	{
+		int ret = io_uring_submit_and_wait(&ring, count);
+		if(ret < 0)
+		{
+			fail(std::string("submit failed: ") + strerror(-ret));
+			return false;
+		}
+		for(size_t i = 0; i < count; ++i)
+		{
+			struct io_uring_cqe* cqe;
+			ret = io_uring_wait_cqe(&ring, &cqe);
+			if(ret < 0)
+			{
+				fail(std::string("wait failed: ") + strerror(-ret));
+				return false;
+			}
+			callback(reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe)), cqe->res);
+			io_uring_cqe_seen(&ring, cqe);
+		}
+		return true;
+	}
+
+public:
+	Ring()
+	{
+		int ret = io_uring_queue_init(BatchFileReader::QUEUE_DEPTH, &ring, 0);
+		if(ret < 0)
+		{
+			fail(strerror(-ret));
+			return;
+		}
+		valid = true;
+
+		struct io_uring_probe* probe = io_uring_get_probe_ring(&ring);
+		bool supported = probe && io_uring_opcode_supported(probe, IORING_OP_OPENAT) &&
+			io_uring_opcode_supported(probe, IORING_OP_READ);
+		if(probe)
+			io_uring_free_probe(probe);
+		if(!supported)
+			fail("the kernel dose not support the required operations");
+	}
+
+	~Ring()
+	{
+		if(valid)
+			io_uring_queue_exit(&ring);
+	}
+
+	bool isValid() const
+	{
+		return valid && !uringUnavailable;
+	}
+
+	// reads up to QUEUE_DEPTH files, returns false if the ring failed and the requests must be read some other way
+	bool read(Request* requests, size_t count)
+	{
+		std::vector<int> fds(count, -1);
+
+		for(size_t i = 0; i < count; ++i)
+		{
+			requests[i].size = 0;
+			requests[i].error = 0;
+			struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+			io_uring_prep_openat(sqe, AT_FDCWD, requests[i].path, O_RDONLY | O_CLOEXEC, 0);
+			io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(i)));
+		}
+		if(!complete(count, [&](size_t i, int res)
+		{
+			if(res < 0)
+				requests[i].error = -res;
+			else
+				fds[i] = res;
+		}))
+		{
+			for(int fd : fds)
+			{
+				if(fd >= 0)
+					::close(fd);
+			}
+			return false;
+		}
+
+		size_t opened = 0;
+		for(size_t i = 0; i < count; ++i)
+		{
+			if(fds[i] < 0)
+				continue;
+			prepareBuffer(requests[i]);
+			struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+			io_uring_prep_read(sqe, fds[i], requests[i].buffer->data(), requests[i].buffer->size(), 0);
+			io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(i)));
+			++opened;
+		}
+		bool readOk = complete(opened, [&](size_t i, int res)
+		{
+			if(res < 0)
+				requests[i].error = -res;
+			else
+				requests[i].size = res;
+		});
+
+		// files larger than their hint are finished synchronously, this is rare as the hints come from the index
+		for(size_t i = 0; i < count && readOk; ++i)
+		{
+			if(fds[i] >= 0 && requests[i].error == 0 && requests[i].size == requests[i].buffer->size())
+				readToEnd(fds[i], requests[i]);
+		}
+
+		// closing through the ring would leave the fds in an unknown state if it failed part way through,
+		// closing them again then could close files other threads opened in the meantime
+		for(int fd : fds)
+		{
+			if(fd >= 0)
+				::close(fd);
+		}
+		return readOk;
+	}
+};
+
+static Ring& threadRing()
+{
+	thread_local Ring ring;
+	return ring;
+}
+#endif
+
+void BatchFileReader::read(std::vector<Request>& requests)
+{
+	size_t done = 0;
+
+#ifdef ENABLE_URING
+	Ring& ring = threadRing();
+	while(ring.isValid() && done < requests.size())
+	{
+		size_t count = std::min<size_t>(QUEUE_DEPTH, requests.size() - done);
+		if(!ring.read(requests.data() + done, count))
+			break;
+		done += count;
+	}
+#endif
+
+	if(done < requests.size())
+		readPool(requests.data() + done, requests.size() - done);
+}
+
+bool BatchFileReader::usesUring()
+{
+#ifdef ENABLE_URING
+	return threadRing().isValid();
+#else
+	return false;
+#endif
+}
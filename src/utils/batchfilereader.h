@@ -0,0 +1,62 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Reads the whole contents of many small files at once.
+ *
+ * Reading small files one after the other is dominated by the latency of open, read and close,
+ * especially on network filesystems. With io_uring the opens and reads of up to QUEUE_DEPTH
+ * files are each submitted with a single system call and are serviced concurrently by the kernel.
+ * The files are closed synchronously, as the fds would be in an unknown state if the ring failed
+ * part way through closing them.
+ * Without io_uring support, or if the kernel refuses to set up a ring, the files are read by a
+ * shared pool of threads instead.
+ *
+ * read() may be called from any number of threads at once, each thread uses its own ring.
+ */
+class BatchFileReader
+{
+public:
+	static constexpr unsigned int QUEUE_DEPTH = 64;
+	static constexpr size_t POOL_THREADS = 16;
+
+	struct Request
+	{
+		const char* path;
+		size_t sizeHint; // expected size of the file, larger files are read with additional reads
+		std::vector<char>* buffer; // receives the contents of the file, it is grown as required but never shrunk
+		size_t size = 0; // the number of bytes read
+		int error = 0; // errno of the failed operation or 0 on success
+	};
+
+	/**
+	 * @brief Reads all requested files, failures are reported per request in Request::error
+	 */
+	static void read(std::vector<Request>& requests);
+
+	/**
+	 * @brief True if io_uring is used, false if the thread pool fallback is used
+	 */
+	static bool usesUring();
+};
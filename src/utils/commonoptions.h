@@ -20,7 +20,7 @@
 
 #pragma once
 
-#define DATASET_LIST "dir, tar, dirreg, tarreg"
+#define DATASET_LIST "dir, tar, dirreg, tarreg, packed, synth, synthreg"
 
 typedef enum
 {
@@ -28,7 +28,10 @@ typedef enum
 	DATASET_DIR,
 	DATASET_TAR,
 	DATASET_DIR_REGRESSION,
-	DATASET_TAR_REGRESSION
+	DATASET_TAR_REGRESSION,
+	DATASET_PACKED,
+	DATASET_SYNTHETIC,
+	DATASET_SYNTHETIC_REGRESSION
 } DatasetMode;
 
 static inline constexpr const char* datasetModeToStr(const DatasetMode mode)
@@ -43,6 +46,12 @@ static inline constexpr const char* datasetModeToStr(const DatasetMode mode)
 			return "dirreg";
 		case DATASET_TAR_REGRESSION:
 			return "tarreg";
+		case DATASET_PACKED:
+			return "packed";
+		case DATASET_SYNTHETIC:
+			return "synth";
+		case DATASET_SYNTHETIC_REGRESSION:
+			return "synthreg";
 		default:
 			return "invalid";
 	}
@@ -58,5 +67,11 @@ static inline DatasetMode parseDatasetMode(const std::string& in)
 		return DATASET_DIR_REGRESSION;
 	else if(in == datasetModeToStr(DATASET_TAR_REGRESSION))
 		return DATASET_TAR_REGRESSION;
+	else if(in == datasetModeToStr(DATASET_PACKED))
+		return DATASET_PACKED;
+	else if(in == datasetModeToStr(DATASET_SYNTHETIC))
+		return DATASET_SYNTHETIC;
+	else if(in == datasetModeToStr(DATASET_SYNTHETIC_REGRESSION))
+		return DATASET_SYNTHETIC_REGRESSION;
 	return DATASET_INVALID;
 }
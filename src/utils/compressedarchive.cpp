@@ -0,0 +1,463 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "compressedarchive.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <fstream>
+
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "log.h"
+
+static constexpr unsigned char GZIP_MAGIC[2] = {0x1f, 0x8b};
+static constexpr uint32_t ZSTD_FRAME_MAGIC = 0xFD2FB528;
+static constexpr uint32_t ZSTD_SKIPPABLE_MAGIC = 0x184D2A50;
+static constexpr uint32_t ZSTD_SKIPPABLE_MASK = 0xFFFFFFF0;
+static constexpr uint32_t SEEKABLE_MAGIC = 0x8F92EAB1;
+static constexpr size_t SEEKABLE_FOOTER_SIZE = 9;
+static constexpr size_t SKIPPABLE_HEADER_SIZE = 8;
+static constexpr size_t SCRATCH_SIZE = 4*1024*1024;
+
+static uint32_t readLe32(const char* data)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+	return static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 |
+		static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+// used to tell apart the archives in the thread local frame caches, unlike a pointer it is never reused
+static std::atomic<uint64_t> nextId = 1;
+
+CompressedArchive::Format CompressedArchive::detect(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+	char magic[4];
+	if(!file.is_open() || !file.read(magic, sizeof(magic)))
+		return FORMAT_NONE;
+
+	if(std::memcmp(magic, GZIP_MAGIC, sizeof(GZIP_MAGIC)) == 0)
+		return FORMAT_GZIP;
+	uint32_t magicValue = readLe32(magic);
+	if(magicValue == ZSTD_FRAME_MAGIC || (magicValue & ZSTD_SKIPPABLE_MASK) == ZSTD_SKIPPABLE_MAGIC)
+		return FORMAT_ZSTD;
+	return FORMAT_NONE;
+}
+
+CompressedArchive::CompressedArchive(const std::filesystem::path& path, std::vector<Frame> framesIn):
+format(detect(path)), frames(std::move(framesIn)), id(nextId++)
+{
+	if(format == FORMAT_NONE)
+		throw archive_error(path.string() + " is not a gzip or zstd compressed file");
+
+	try
+	{
+		file = std::make_unique<MappedFile>(path, MappedFile::ACCESS_NORMAL);
+	}
+	catch(const MappedFile::mmap_error& err)
+	{
+		throw archive_error(err.what());
+	}
+
+	if(!framesValid())
+	{
+		Log(Log::INFO)<<"Indexing the compressed frames of "<<path;
+		frames.clear();
+		file->advise(MappedFile::ACCESS_SEQUENTIAL);
+		if(format == FORMAT_GZIP)
+			buildGzipFrames();
+		else
+			buildZstdFrames();
+		file->advise(MappedFile::ACCESS_NORMAL);
+	}
+
+	length = frames.empty() ? 0 : frames.back().pos + frames.back().size;
+
+	if(largestFrame() > LARGE_FRAME_SIZE)
+	{
+		Log(Log::WARN)<<path<<" contains compressed frames of up to "<<largestFrame()/(1024*1024)
+			<<" MiB, random access will be slow. Recompress it with many small frames, "
+			<<"for example with zstd --seekable or pzstd, or with bgzip or pigz --independent";
+	}
+}
+
+bool CompressedArchive::framesValid() const
+{
+	if(frames.empty())
+		return false;
+
+	uint64_t pos = 0;
+	for(const Frame& frame : frames)
+	{
+		if(frame.pos != pos || frame.size == 0 || frame.compressedPos > file->size() ||
+			frame.compressedSize > file->size() - frame.compressedPos)
+			return false;
+		pos += frame.size;
+	}
+	return true;
+}
+
+void CompressedArchive::buildGzipFrames()
+{
+#ifdef ENABLE_ZLIB
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(file->begin());
+	uint64_t compressedLength = file->size();
+	std::vector<unsigned char> scratch(SCRATCH_SIZE);
+
+	z_stream stream = {};
+	if(inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+		throw archive_error("Unable to initalize zlib");
+
+	uint64_t compressedPos = 0;
+	uint64_t pos = 0;
+	try
+	{
+		while(compressedPos < compressedLength)
+		{
+			// some tools pad the end of the file with zeros
+			if(data[compressedPos] != GZIP_MAGIC[0])
+			{
+				if(std::all_of(data + compressedPos, data + compressedLength, [](unsigned char c){return c == 0;}))
+					break;
+				throw archive_error(file->getPath().string() + " contains data that is not gzip compressed at offset " + std::to_string(compressedPos));
+			}
+
+			inflateReset(&stream);
+			const unsigned char* memberBegin = data + compressedPos;
+			uint64_t consumed = 0;
+			uint64_t size = 0;
+			int ret = Z_OK;
+			stream.avail_in = 0;
+			while(ret != Z_STREAM_END)
+			{
+				// avail_in is only 32 bits wide, so large files are fed in pieces
+				if(stream.avail_in == 0)
+				{
+					uint64_t remaining = compressedLength - compressedPos - consumed;
+					if(remaining == 0)
+						throw archive_error(file->getPath().string() + " is truncated");
+					stream.next_in = const_cast<unsigned char*>(memberBegin + consumed);
+					stream.avail_in = static_cast<uInt>(std::min<uint64_t>(remaining, UINT_MAX));
+				}
+
+				stream.next_out = scratch.data();
+				stream.avail_out = scratch.size();
+				uInt availIn = stream.avail_in;
+				ret = inflate(&stream, Z_NO_FLUSH);
+				if(ret != Z_OK && ret != Z_STREAM_END)
+					throw archive_error("Unable to decompress " + file->getPath().string() + ": " + (stream.msg ? stream.msg : "corrupt data"));
+				consumed += availIn - stream.avail_in;
+				size += scratch.size() - stream.avail_out;
+			}
+
+			// empty members, like the end of file marker of bgzip, can not be read from
+			if(size > 0)
+				frames.push_back({.compressedPos = compressedPos, .compressedSize = consumed, .pos = pos, .size = size});
+			compressedPos += consumed;
+			pos += size;
+		}
+	}
+	catch(...)
+	{
+		inflateEnd(&stream);
+		throw;
+	}
+	inflateEnd(&stream);
+#else
+	throw archive_error(file->getPath().string() + " is gzip compressed but this application was built without zlib support");
+#endif
+}
+
+bool CompressedArchive::readZstdSeekTable()
+{
+	const char* data = file->begin();
+	uint64_t compressedLength = file->size();
+	if(compressedLength < SEEKABLE_FOOTER_SIZE + SKIPPABLE_HEADER_SIZE)
+		return false;
+
+	const char* footer = data + compressedLength - SEEKABLE_FOOTER_SIZE;
+	if(readLe32(footer + 5) != SEEKABLE_MAGIC)
+		return false;
+
+	uint64_t frameCount = readLe32(footer);
+	unsigned char descriptor = static_cast<unsigned char>(footer[4]);
+	uint64_t entrySize = (descriptor & 0x80) ? 12 : 8;
+	uint64_t tableSize = frameCount*entrySize + SEEKABLE_FOOTER_SIZE;
+	if(tableSize + SKIPPABLE_HEADER_SIZE > compressedLength)
+		return false;
+
+	const char* table = data + compressedLength - tableSize;
+	const char* header = table - SKIPPABLE_HEADER_SIZE;
+	if((readLe32(header) & ZSTD_SKIPPABLE_MASK) != ZSTD_SKIPPABLE_MAGIC || readLe32(header + 4) != tableSize)
+		return false;
+
+	uint64_t compressedPos = 0;
+	uint64_t pos = 0;
+	frames.reserve(frameCount);
+	for(uint64_t i = 0; i < frameCount; ++i)
+	{
+		uint64_t compressedSize = readLe32(table + i*entrySize);
+		uint64_t size = readLe32(table + i*entrySize + 4);
+		if(size > 0)
+			frames.push_back({.compressedPos = compressedPos, .compressedSize = compressedSize, .pos = pos, .size = size});
+		compressedPos += compressedSize;
+		pos += size;
+	}
+
+	if(compressedPos != compressedLength - tableSize - SKIPPABLE_HEADER_SIZE)
+	{
+		Log(Log::WARN)<<"The seek table of "<<file->getPath()<<" dose not match the file, it will be ignored";
+		frames.clear();
+		return false;
+	}
+	return true;
+}
+
+void CompressedArchive::buildZstdFrames()
+{
+#ifdef ENABLE_ZSTD
+	if(readZstdSeekTable())
+		return;
+
+	const char* data = file->begin();
+	uint64_t compressedLength = file->size();
+	uint64_t compressedPos = 0;
+	uint64_t pos = 0;
+	while(compressedPos < compressedLength)
+	{
+		const char* frameBegin = data + compressedPos;
+		uint64_t remaining = compressedLength - compressedPos;
+		if(remaining < 4)
+			throw archive_error(file->getPath().string() + " is truncated");
+
+		if((readLe32(frameBegin) & ZSTD_SKIPPABLE_MASK) == ZSTD_SKIPPABLE_MAGIC)
+		{
+			if(remaining < SKIPPABLE_HEADER_SIZE || readLe32(frameBegin + 4) > remaining - SKIPPABLE_HEADER_SIZE)
+				throw archive_error(file->getPath().string() + " is truncated");
+			compressedPos += SKIPPABLE_HEADER_SIZE + readLe32(frameBegin + 4);
+			continue;
+		}
+
+		size_t compressedSize = ZSTD_findFrameCompressedSize(frameBegin, remaining);
+		if(ZSTD_isError(compressedSize))
+			throw archive_error("Unable to decompress " + file->getPath().string() + ": " + ZSTD_getErrorName(compressedSize));
+
+		unsigned long long size = ZSTD_getFrameContentSize(frameBegin, compressedSize);
+		if(size == ZSTD_CONTENTSIZE_ERROR)
+			throw archive_error(file->getPath().string() + " contains a corrupt zstd frame at offset " + std::to_string(compressedPos));
+		if(size == ZSTD_CONTENTSIZE_UNKNOWN)
+		{
+			// streamed frames do not record their size, so it can only be found by decompressing them
+			Frame frame = {.compressedPos = compressedPos, .compressedSize = compressedSize, .pos = pos, .size = 0};
+			std::vector<char> scratch;
+			decompressFrame(frame, scratch);
+			size = scratch.size();
+		}
+
+		if(size > 0)
+			frames.push_back({.compressedPos = compressedPos, .compressedSize = compressedSize, .pos = pos, .size = size});
+		compressedPos += compressedSize;
+		pos += size;
+	}
+#else
+	throw archive_error(file->getPath().string() + " is zstd compressed but this application was built without zstd support");
+#endif
+}
+
+void CompressedArchive::decompressFrame(const Frame& frame, std::vector<char>& out) const
+{
+	[[maybe_unused]] const char* src = file->begin() + frame.compressedPos;
+
+	if(format == FORMAT_ZSTD)
+	{
+#ifdef ENABLE_ZSTD
+		thread_local std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+		if(!context)
+			throw archive_error("Unable to create a zstd context");
+
+		if(frame.size > 0)
+		{
+			out.resize(frame.size);
+			size_t ret = ZSTD_decompressDCtx(context.get(), out.data(), out.size(), src, frame.compressedSize);
+			if(ZSTD_isError(ret) || ret != frame.size)
+				throw archive_error("Unable to decompress frame at " + std::to_string(frame.compressedPos) + " of " + file->getPath().string());
+			return;
+		}
+
+		// the size of the frame is unknown, decompress it as a stream
+		out.clear();
+		ZSTD_DCtx_reset(context.get(), ZSTD_reset_session_only);
+		ZSTD_inBuffer input = {src, frame.compressedSize, 0};
+		size_t ret = 1;
+		while(ret != 0)
+		{
+			size_t filled = out.size();
+			out.resize(filled + SCRATCH_SIZE);
+			ZSTD_outBuffer output = {out.data() + filled, SCRATCH_SIZE, 0};
+			ret = ZSTD_decompressStream(context.get(), &output, &input);
+			if(ZSTD_isError(ret))
+				throw archive_error("Unable to decompress frame at " + std::to_string(frame.compressedPos) + " of " + file->getPath().string() + ": " + ZSTD_getErrorName(ret));
+			out.resize(filled + output.pos);
+			if(ret != 0 && input.pos == input.size && output.pos < output.size)
+				throw archive_error("Frame at " + std::to_string(frame.compressedPos) + " of " + file->getPath().string() + " is truncated");
+		}
+#else
+		throw archive_error(file->getPath().string() + " is zstd compressed but this application was built without zstd support");
+#endif
+	}
+	else
+	{
+#ifdef ENABLE_ZLIB
+		out.resize(frame.size);
+		z_stream stream = {};
+		if(inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+			throw archive_error("Unable to initalize zlib");
+
+		// avail_in and avail_out are only 32 bits wide, so large members are processed in pieces
+		const unsigned char* input = reinterpret_cast<const unsigned char*>(src);
+		unsigned char* output = reinterpret_cast<unsigned char*>(out.data());
+		uint64_t consumed = 0;
+		uint64_t produced = 0;
+		int ret = Z_OK;
+		while(ret == Z_OK)
+		{
+			if(stream.avail_in == 0)
+			{
+				stream.next_in = const_cast<unsigned char*>(input + consumed);
+				stream.avail_in = static_cast<uInt>(std::min<uint64_t>(frame.compressedSize - consumed, UINT_MAX));
+			}
+			if(stream.avail_out == 0)
+			{
+				stream.next_out = output + produced;
+				stream.avail_out = static_cast<uInt>(std::min<uint64_t>(frame.size - produced, UINT_MAX));
+			}
+			if(stream.avail_in == 0 && stream.avail_out == 0)
+				break;
+
+			uInt availIn = stream.avail_in;
+			uInt availOut = stream.avail_out;
+			ret = inflate(&stream, Z_NO_FLUSH);
+			consumed += availIn - stream.avail_in;
+			produced += availOut - stream.avail_out;
+		}
+		inflateEnd(&stream);
+		if(ret != Z_STREAM_END || produced != frame.size)
+			throw archive_error("Unable to decompress member at " + std::to_string(frame.compressedPos) + " of " + file->getPath().string());
+#else
+		throw archive_error(file->getPath().string() + " is gzip compressed but this application was built without zlib support");
+#endif
+	}
+}
+
+size_t CompressedArchive::findFrame(uint64_t pos) const
+{
+	std::vector<Frame>::const_iterator it = std::upper_bound(frames.begin(), frames.end(), pos,
+		[](uint64_t value, const Frame& frame){return value < frame.pos;});
+	return std::distance(frames.begin(), it) - 1;
+}
+
+const std::vector<char>& CompressedArchive::frameData(size_t index) const
+{
+	struct FrameCache
+	{
+		uint64_t archive = 0;
+		size_t frame = 0;
+		std::vector<char> data;
+	};
+	thread_local FrameCache cache;
+
+	if(cache.archive != id || cache.frame != index)
+	{
+		cache.archive = 0;
+		decompressFrame(frames[index], cache.data);
+		cache.archive = id;
+		cache.frame = index;
+	}
+	return cache.data;
+}
+
+size_t CompressedArchive::read(char* buffer, size_t size, uint64_t offset) const
+{
+	if(offset >= length)
+		return 0;
+	size = std::min<uint64_t>(size, length - offset);
+
+	size_t done = 0;
+	for(size_t index = findFrame(offset); done < size; ++index)
+	{
+		const Frame& frame = frames[index];
+		const std::vector<char>& data = frameData(index);
+		uint64_t inFrame = offset + done - frame.pos;
+		size_t count = std::min<uint64_t>(size - done, frame.size - inFrame);
+		std::memcpy(buffer + done, data.data() + inFrame, count);
+		done += count;
+	}
+	return done;
+}
+
+std::string_view CompressedArchive::view(uint64_t offset, size_t size) const
+{
+	if(offset > length || size > length - offset)
+		throw archive_error("Range " + std::to_string(offset) + '+' + std::to_string(size) + " is outside of " + file->getPath().string());
+	if(size == 0)
+		return std::string_view();
+
+	// ranges within a single frame are viewed in place in the frame cache
+	size_t index = findFrame(offset);
+	const Frame& frame = frames[index];
+	if(offset + size <= frame.pos + frame.size)
+		return std::string_view(frameData(index).data() + (offset - frame.pos), size);
+
+	thread_local std::vector<char> buffer;
+	buffer.resize(size);
+	read(buffer.data(), size, offset);
+	return std::string_view(buffer.data(), size);
+}
+
+uint64_t CompressedArchive::size() const
+{
+	return length;
+}
+
+uint64_t CompressedArchive::largestFrame() const
+{
+	uint64_t largest = 0;
+	for(const Frame& frame : frames)
+		largest = std::max(largest, frame.size);
+	return largest;
+}
+
+const std::vector<CompressedArchive::Frame>& CompressedArchive::getFrames() const
+{
+	return frames;
+}
+
+CompressedArchive::Format CompressedArchive::getFormat() const
+{
+	return format;
+}
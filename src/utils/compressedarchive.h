@@ -0,0 +1,122 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mappedfile.h"
+
+/**
+ * @brief Random access to the uncompressed contents of a gzip or zstd compressed file.
+ *
+ * The compressed file is split into frames that can be decompressed independently of each other:
+ * the frames of a multi frame zstd file, which are listed in the seek table of the zstd seekable
+ * format if present, or the members of a multi member gzip file as written by bgzip or pigz --independent.
+ * Reading a range only decompresses the frames it overlaps. Each thread decompresses into its own
+ * buffer, so any number of threads can read from a single CompressedArchive in parallel.
+ *
+ * A file compressed as a single frame still works, but every read then decompresses the whole file.
+ */
+class CompressedArchive
+{
+public:
+	typedef enum
+	{
+		FORMAT_NONE,
+		FORMAT_GZIP,
+		FORMAT_ZSTD
+	} Format;
+
+	struct Frame
+	{
+		uint64_t compressedPos;
+		uint64_t compressedSize;
+		uint64_t pos; // offset of the frame in the uncompressed data
+		uint64_t size;
+	};
+
+	// frames larger than this make random access slow enough to warn about
+	static constexpr uint64_t LARGE_FRAME_SIZE = 64*1024*1024;
+
+	class archive_error: public std::exception
+	{
+		std::string whatStr;
+	public:
+		archive_error(const std::string& whatIn): whatStr(whatIn)
+		{}
+		virtual const char* what() const noexcept override
+		{
+			return whatStr.c_str();
+		}
+	};
+
+private:
+	std::unique_ptr<MappedFile> file;
+	Format format;
+	std::vector<Frame> frames;
+	uint64_t length = 0;
+	uint64_t id;
+
+	bool framesValid() const;
+	void buildGzipFrames();
+	void buildZstdFrames();
+	bool readZstdSeekTable();
+	size_t findFrame(uint64_t pos) const;
+	const std::vector<char>& frameData(size_t index) const;
+	void decompressFrame(const Frame& frame, std::vector<char>& out) const;
+
+public:
+	/**
+	 * @brief Opens a compressed file
+	 * @param path the file to open, its format is detected from its contents
+	 * @param frames the frame index of the file as previously returned by getFrames(), it is rebuilt if empty or not valid for the file
+	 */
+	explicit CompressedArchive(const std::filesystem::path& path, std::vector<Frame> frames = {});
+	CompressedArchive(const CompressedArchive& in) = delete;
+	CompressedArchive& operator=(const CompressedArchive& in) = delete;
+
+	/**
+	 * @brief Detects if the given file is compressed and in which format
+	 */
+	static Format detect(const std::filesystem::path& path);
+
+	/**
+	 * @brief Reads uncompressed data
+	 * @return the number of bytes read, this is only less than size at the end of the data
+	 */
+	size_t read(char* buffer, size_t size, uint64_t offset) const;
+
+	/**
+	 * @brief Gets a view of a range of the uncompressed data
+	 * @return a view into a thread local buffer, it stays valid until the next call to view() or read() on the same thread
+	 */
+	std::string_view view(uint64_t offset, size_t size) const;
+
+	uint64_t size() const;
+	uint64_t largestFrame() const;
+	const std::vector<Frame>& getFrames() const;
+	Format getFormat() const;
+};
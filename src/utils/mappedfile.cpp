@@ -0,0 +1,110 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "mappedfile.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::filesystem::path& pathI, Access access): path(pathI)
+{
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		throw mmap_error("Unable to open " + path.string() + ": " + std::strerror(errno));
+
+	struct stat st;
+	if(fstat(fd, &st) != 0)
+	{
+		int err = errno;
+		::close(fd);
+		throw mmap_error("Unable to stat " + path.string() + ": " + std::strerror(err));
+	}
+
+	length = static_cast<size_t>(st.st_size);
+	if(length > 0)
+	{
+		void* ptr = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+		if(ptr == MAP_FAILED)
+		{
+			int err = errno;
+			::close(fd);
+			throw mmap_error("Unable to map " + path.string() + ": " + std::strerror(err));
+		}
+		data = static_cast<char*>(ptr);
+	}
+
+	// the mapping keeps its own reference to the file
+	::close(fd);
+	advise(access);
+}
+
+MappedFile::~MappedFile()
+{
+	if(data)
+		munmap(data, length);
+}
+
+void MappedFile::advise(Access access)
+{
+	if(!data)
+		return;
+
+	int advice;
+	switch(access)
+	{
+		case ACCESS_RANDOM:
+			advice = MADV_RANDOM;
+			break;
+		case ACCESS_SEQUENTIAL:
+			advice = MADV_SEQUENTIAL;
+			break;
+		case ACCESS_NORMAL:
+		default:
+			advice = MADV_NORMAL;
+			break;
+	}
+	madvise(data, length, advice);
+}
+
+std::string_view MappedFile::view(size_t offset, size_t size) const
+{
+	if(offset > length || size > length - offset)
+		throw mmap_error("Range " + std::to_string(offset) + '+' + std::to_string(size) + " is outside of " + path.string());
+	return std::string_view(data + offset, size);
+}
+
+const char* MappedFile::begin() const
+{
+	return data;
+}
+
+size_t MappedFile::size() const
+{
+	return length;
+}
+
+const std::filesystem::path& MappedFile::getPath() const
+{
+	return path;
+}
@@ -0,0 +1,71 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief A read only memory mapping of a file.
+ *
+ * The mapping is never written to, so a single MappedFile can be shared between any number of threads.
+ */
+class MappedFile
+{
+public:
+	typedef enum
+	{
+		ACCESS_NORMAL,
+		ACCESS_RANDOM,
+		ACCESS_SEQUENTIAL
+	} Access;
+
+	class mmap_error: public std::exception
+	{
+		std::string whatStr;
+	public:
+		mmap_error(const std::string& whatIn): whatStr(whatIn)
+		{}
+		virtual const char* what() const noexcept override
+		{
+			return whatStr.c_str();
+		}
+	};
+
+private:
+	char* data = nullptr;
+	size_t length = 0;
+	std::filesystem::path path;
+
+public:
+	explicit MappedFile(const std::filesystem::path& path, Access access = ACCESS_NORMAL);
+	MappedFile(const MappedFile& in) = delete;
+	MappedFile& operator=(const MappedFile& in) = delete;
+	~MappedFile();
+
+	void advise(Access access);
+	std::string_view view(size_t offset, size_t size) const;
+	const char* begin() const;
+	size_t size() const;
+	const std::filesystem::path& getPath() const;
+};
@@ -0,0 +1,69 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <istream>
+#include <streambuf>
+#include <string_view>
+
+/**
+ * @brief A std::streambuf that reads directly from a span of memory without copying it.
+ */
+class MemoryStreamBuf: public std::streambuf
+{
+public:
+	explicit MemoryStreamBuf(std::string_view data)
+	{
+		char* begin = const_cast<char*>(data.data());
+		setg(begin, begin, begin + data.size());
+	}
+
+protected:
+	virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in) override
+	{
+		if(!(which & std::ios_base::in))
+			return pos_type(off_type(-1));
+
+		char* target;
+		if(dir == std::ios_base::beg)
+			target = eback() + off;
+		else if(dir == std::ios_base::cur)
+			target = gptr() + off;
+		else
+			target = egptr() + off;
+
+		if(target < eback() || target > egptr())
+			return pos_type(off_type(-1));
+		setg(eback(), target, egptr());
+		return pos_type(target - eback());
+	}
+
+	virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override
+	{
+		return seekoff(off_type(pos), std::ios_base::beg, which);
+	}
+};
+
+class MemoryIStream: private MemoryStreamBuf, public std::istream
+{
+public:
+	explicit MemoryIStream(std::string_view data): MemoryStreamBuf(data), std::istream(static_cast<MemoryStreamBuf*>(this))
+	{}
+};
@@ -0,0 +1,72 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "metricaccumulator.h"
+
+MetricAccumulator::MetricAccumulator(const torch::Device& device)
+{
+	torch::TensorOptions options = torch::TensorOptions().dtype(torch::kFloat32).device(device);
+	lastLoss = torch::zeros({}, options);
+	lossSum = torch::zeros({}, options);
+	hitSum = torch::zeros({}, options);
+}
+
+void MetricAccumulator::add(const torch::Tensor& loss, int64_t sampleCount, const torch::Tensor& hits)
+{
+	torch::NoGradGuard noGrad;
+	lastLoss.copy_(loss.detach().reshape({}));
+	lossSum.add_(lastLoss);
+	if(hits.defined())
+		hitSum.add_(hits.detach().sum());
+	++steps;
+	samples += sampleCount;
+}
+
+MetricAccumulator::Values MetricAccumulator::read() const
+{
+	torch::Tensor values = torch::stack({lastLoss, lossSum, hitSum}).to(torch::kCPU, torch::kFloat64);
+	const double* valuePtr = values.data_ptr<double>();
+
+	Values out;
+	out.loss = valuePtr[0];
+	out.meanLoss = steps > 0 ? valuePtr[1]/steps : 0;
+	out.accuracy = samples > 0 ? valuePtr[2]/samples : 0;
+	return out;
+}
+
+void MetricAccumulator::reset()
+{
+	torch::NoGradGuard noGrad;
+	lastLoss.zero_();
+	lossSum.zero_();
+	hitSum.zero_();
+	steps = 0;
+	samples = 0;
+}
+
+size_t MetricAccumulator::getSteps() const
+{
+	return steps;
+}
+
+size_t MetricAccumulator::getSamples() const
+{
+	return samples;
+}
@@ -0,0 +1,72 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "torchph.h"
+
+/**
+ * @brief Accumulates training metrics on the device, so that the training step does not have to synchronize with it.
+ *
+ * The values are only copied to the host by read, which is intended to be called at the logging interval.
+ */
+class MetricAccumulator
+{
+public:
+	struct Values
+	{
+		// loss of the last step
+		double loss;
+		// mean loss over all steps since the last reset
+		double meanLoss;
+		// hits per sample since the last reset
+		double accuracy;
+	};
+
+private:
+	torch::Tensor lastLoss;
+	torch::Tensor lossSum;
+	torch::Tensor hitSum;
+	size_t steps = 0;
+	size_t samples = 0;
+
+public:
+	explicit MetricAccumulator(const torch::Device& device);
+
+	/**
+	 * @brief Adds a training step
+	 *
+	 * @param loss the scalar loss of the step
+	 * @param sampleCount the number of samples in the batch of the step
+	 * @param hits optional number of correct predictions in the batch
+	 */
+	void add(const torch::Tensor& loss, int64_t sampleCount, const torch::Tensor& hits = torch::Tensor());
+
+	/**
+	 * @brief Copies the accumulated values to the host, synchronizing with the device
+	 */
+	Values read() const;
+
+	void reset();
+	size_t getSteps() const;
+	size_t getSamples() const;
+};
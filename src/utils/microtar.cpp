@@ -20,10 +20,14 @@
  * IN THE SOFTWARE.
  */
 
+/* 64 bit file offsets on 32 bit platforms */
+#define _FILE_OFFSET_BITS 64
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
+#include <sys/types.h>
 
 #include "microtar.h"
 
@@ -40,12 +44,60 @@ typedef struct {
   char _padding[255];
 } mtar_raw_header_t;
 
+/* Offset of the ustar prefix field in _padding */
+#define USTAR_PREFIX_OFFSET 88
+#define USTAR_PREFIX_SIZE 155
+
+/* Largest value that fits the octal size field */
+#define OCTAL_SIZE_MAX 077777777777ULL
+
 
-static unsigned round_up(unsigned n, unsigned incr) {
+static uint64_t round_up(uint64_t n, uint64_t incr) {
   return n + (incr - n % incr) % incr;
 }
 
 
+static uint64_t parse_numeric(const char *field, size_t size) {
+  size_t i = 0;
+  uint64_t value = 0;
+  /* GNU base-256 encoding, used for values that do not fit in octal */
+  if ((unsigned char) field[0] & 0x80) {
+    value = (unsigned char) field[0] & 0x7f;
+    for (i = 1; i < size; i++) {
+      value = (value << 8) | (unsigned char) field[i];
+    }
+    return value;
+  }
+  while (i < size && (field[i] == ' ' || field[i] == '\0')) {
+    i++;
+  }
+  for (; i < size && field[i] >= '0' && field[i] <= '7'; i++) {
+    value = (value << 3) | (uint64_t) (field[i] - '0');
+  }
+  return value;
+}
+
+
+static void write_base256(char *field, size_t size, uint64_t value) {
+  size_t i;
+  for (i = size - 1; i > 0; i--) {
+    field[i] = (char) (value & 0xff);
+    value >>= 8;
+  }
+  field[0] = (char) 0x80;
+}
+
+
+static void copy_name(char *dst, size_t dst_size, const char *src, size_t src_size) {
+  size_t len = strnlen(src, src_size);
+  if (len >= dst_size) {
+    len = dst_size - 1;
+  }
+  memcpy(dst, src, len);
+  dst[len] = '\0';
+}
+
+
 static unsigned checksum(const mtar_raw_header_t* rh) {
   unsigned i;
   unsigned char *p = (unsigned char*) rh;
@@ -87,7 +139,7 @@ static int write_null_bytes(mtar_t *tar, int n) {
 }
 
 
-static int raw_to_header(mtar_header_t *h, const mtar_raw_header_t *rh, long pos) {
+static int raw_to_header(mtar_header_t *h, const mtar_raw_header_t *rh, uint64_t pos) {
   unsigned chksum1, chksum2;
 
   /* If the checksum starts with a null byte we assume the record is NULL */
@@ -105,13 +157,26 @@ static int raw_to_header(mtar_header_t *h, const mtar_raw_header_t *rh, long pos
   /* Load raw header into header */
   sscanf(rh->mode, "%o", &h->mode);
   sscanf(rh->owner, "%o", &h->owner);
-  sscanf(rh->size, "%o", &h->size);
+  h->size = parse_numeric(rh->size, sizeof(rh->size));
   sscanf(rh->mtime, "%o", &h->mtime);
   h->type = rh->type;
-  strcpy(h->name, rh->name);
-  strcpy(h->linkname, rh->linkname);
+  copy_name(h->name, sizeof(h->name), rh->name, sizeof(rh->name));
+  copy_name(h->linkname, sizeof(h->linkname), rh->linkname, sizeof(rh->linkname));
   h->pos = pos;
 
+  /* Prepend the ustar prefix of long names */
+  if (!memcmp(rh->_padding, "ustar", 5) && rh->_padding[USTAR_PREFIX_OFFSET] != '\0') {
+    char name[MTAR_NAME_MAX];
+    size_t len;
+    copy_name(name, sizeof(name), rh->_padding + USTAR_PREFIX_OFFSET, USTAR_PREFIX_SIZE);
+    len = strlen(name);
+    if (len + 1 < sizeof(name)) {
+      name[len] = '/';
+      copy_name(name + len + 1, sizeof(name) - len - 1, h->name, sizeof(h->name));
+    }
+    memcpy(h->name, name, sizeof(name));
+  }
+
   return MTAR_ESUCCESS;
 }
 
@@ -123,11 +188,16 @@ static int header_to_raw(mtar_raw_header_t *rh, const mtar_header_t *h) {
   memset(rh, 0, sizeof(*rh));
   sprintf(rh->mode, "%o", h->mode);
   sprintf(rh->owner, "%o", h->owner);
-  sprintf(rh->size, "%o", h->size);
+  if (h->size > OCTAL_SIZE_MAX) {
+    write_base256(rh->size, sizeof(rh->size), h->size);
+  } else {
+    sprintf(rh->size, "%llo", (unsigned long long) h->size);
+  }
   sprintf(rh->mtime, "%o", h->mtime);
   rh->type = h->type ? h->type : MTAR_TREG;
-  strcpy(rh->name, h->name);
-  strcpy(rh->linkname, h->linkname);
+  /* Longer names are written to a GNU long name record by mtar_write_header */
+  memcpy(rh->name, h->name, strnlen(h->name, sizeof(rh->name)));
+  strncpy(rh->linkname, h->linkname, sizeof(rh->linkname));
 
   /* Calculate and write checksum */
   chksum = checksum(rh);
@@ -164,8 +234,8 @@ static int file_read(mtar_t *tar, void *data, size_t size) {
   return (res == size) ? MTAR_ESUCCESS : MTAR_EREADFAIL;
 }
 
-static int file_seek(mtar_t *tar, long offset) {
-  int res = fseek(tar->stream, offset, SEEK_SET);
+static int file_seek(mtar_t *tar, uint64_t offset) {
+  int res = fseeko(tar->stream, (off_t) offset, SEEK_SET);
   return (res == 0) ? MTAR_ESUCCESS : MTAR_ESEEKFAIL;
 }
 
@@ -214,7 +284,7 @@ int mtar_close(mtar_t *tar) {
 }
 
 
-int mtar_seek(mtar_t *tar, long pos) {
+int mtar_seek(mtar_t *tar, uint64_t pos) {
   int err = tar->seek(tar, pos);
   if (err == MTAR_ESUCCESS)
     tar->pos = pos;
@@ -230,7 +300,8 @@ int mtar_rewind(mtar_t *tar) {
 
 
 int mtar_next(mtar_t *tar) {
-  int err, n;
+  int err;
+  uint64_t n;
   mtar_header_t h;
   /* Load header */
   err = mtar_read_header(tar, &h);
@@ -238,8 +309,8 @@ int mtar_next(mtar_t *tar) {
     return err;
   }
   /* Seek to next record */
-  n = round_up(h.size, 512) + sizeof(mtar_raw_header_t);
-  return mtar_seek(tar, tar->pos + n);
+  n = round_up(h.size, 512);
+  return mtar_seek(tar, tar->data_pos + n);
 }
 
 
@@ -269,7 +340,7 @@ int mtar_find(mtar_t *tar, const char *name, mtar_header_t *h) {
 }
 
 
-int mtar_read_header(mtar_t *tar, mtar_header_t *h) {
+static int read_raw_header(mtar_t *tar, mtar_header_t *h) {
   int err;
   mtar_raw_header_t rh;
   /* Save header position */
@@ -289,6 +360,105 @@ int mtar_read_header(mtar_t *tar, mtar_header_t *h) {
 }
 
 
+static void parse_pax(const char *data, size_t size, char *name, int *has_name, uint64_t *file_size, int *has_size) {
+  /* Records have the form "<length> <key>=<value>\n" */
+  const char *p = data;
+  const char *end = data + size;
+  while (p < end) {
+    char *num_end;
+    unsigned long len = strtoul(p, &num_end, 10);
+    const char *record_end = p + len;
+    const char *key, *eq;
+    if (len == 0 || num_end >= end || *num_end != ' ' || record_end > end) {
+      return;
+    }
+    key = num_end + 1;
+    eq = (const char*) memchr(key, '=', record_end - key);
+    if (eq) {
+      size_t key_len = eq - key;
+      size_t value_len = record_end - eq - 2;
+      if (key_len == 4 && !memcmp(key, "path", 4)) {
+        copy_name(name, MTAR_NAME_MAX, eq + 1, value_len);
+        *has_name = 1;
+      } else if (key_len == 4 && !memcmp(key, "size", 4)) {
+        *file_size = strtoull(eq + 1, NULL, 10);
+        *has_size = 1;
+      }
+    }
+    p = record_end;
+  }
+}
+
+
+static int read_extended(mtar_t *tar, const mtar_header_t *ext, char *name, int *has_name, uint64_t *file_size, int *has_size) {
+  int err;
+  char *data;
+  /* Global pax headers do not describe the next file */
+  if (ext->type == MTAR_TPAX_GLOBAL) {
+    return MTAR_ESUCCESS;
+  }
+  data = (char*) malloc(ext->size + 1);
+  if (!data) {
+    return MTAR_EFAILURE;
+  }
+  err = mtar_seek(tar, ext->pos + sizeof(mtar_raw_header_t));
+  if (!err) {
+    err = tread(tar, data, ext->size);
+  }
+  if (!err) {
+    data[ext->size] = '\0';
+    if (ext->type == MTAR_TGNU_LONGNAME) {
+      copy_name(name, MTAR_NAME_MAX, data, ext->size);
+      *has_name = 1;
+    } else {
+      parse_pax(data, ext->size, name, has_name, file_size, has_size);
+    }
+  }
+  free(data);
+  return err;
+}
+
+
+int mtar_read_header(mtar_t *tar, mtar_header_t *h) {
+  int err;
+  char name[MTAR_NAME_MAX];
+  int has_name = 0;
+  int has_size = 0;
+  uint64_t size = 0;
+  uint64_t start = tar->pos;
+  /* Pax and GNU long name records describe the header that follows them */
+  while (1) {
+    err = read_raw_header(tar, h);
+    if (err) {
+      return err;
+    }
+    if (h->type != MTAR_TPAX && h->type != MTAR_TPAX_GLOBAL && h->type != MTAR_TGNU_LONGNAME) {
+      break;
+    }
+    err = read_extended(tar, h, name, &has_name, &size, &has_size);
+    if (err) {
+      return err;
+    }
+    err = mtar_seek(tar, h->pos + sizeof(mtar_raw_header_t) + round_up(h->size, 512));
+    if (err) {
+      return err;
+    }
+  }
+  if (has_name) {
+    memcpy(h->name, name, sizeof(name));
+  }
+  if (has_size) {
+    h->size = size;
+  }
+  /* The record of this file starts at its first extended header, tar->pos is left there
+   * so reading the header again resolves the extensions again */
+  tar->data_pos = h->pos + sizeof(mtar_raw_header_t);
+  h->pos = start;
+  tar->last_header = start;
+  return mtar_seek(tar, start);
+}
+
+
 int mtar_read_data(mtar_t *tar, void *ptr, size_t size) {
   int err;
   /* If we have no remaining data then this is the first read, we get the size,
@@ -300,8 +470,8 @@ int mtar_read_data(mtar_t *tar, void *ptr, size_t size) {
     if (err) {
       return err;
     }
-    /* Seek past header and init remaining data */
-    err = mtar_seek(tar, tar->pos + sizeof(mtar_raw_header_t));
+    /* Seek past the header and its extensions and init remaining data */
+    err = mtar_seek(tar, tar->data_pos);
     if (err) {
       return err;
     }
@@ -323,7 +493,28 @@ int mtar_read_data(mtar_t *tar, void *ptr, size_t size) {
 
 
 int mtar_write_header(mtar_t *tar, const mtar_header_t *h) {
+  int err;
   mtar_raw_header_t rh;
+  size_t len = strnlen(h->name, sizeof(h->name));
+  /* Names that do not fit the name field are preceded by a GNU long name record */
+  if (len > sizeof(rh.name)) {
+    mtar_header_t lh;
+    memset(&lh, 0, sizeof(lh));
+    strcpy(lh.name, "././@LongLink");
+    lh.size = len + 1;
+    lh.type = MTAR_TGNU_LONGNAME;
+    header_to_raw(&rh, &lh);
+    err = twrite(tar, &rh, sizeof(rh));
+    if (!err) {
+      err = twrite(tar, h->name, len);
+    }
+    if (!err) {
+      err = write_null_bytes(tar, round_up(tar->pos + 1, 512) - tar->pos);
+    }
+    if (err) {
+      return err;
+    }
+  }
   /* Build raw header and write */
   header_to_raw(&rh, h);
   tar->remaining_data = h->size;
@@ -331,11 +522,15 @@ int mtar_write_header(mtar_t *tar, const mtar_header_t *h) {
 }
 
 
-int mtar_write_file_header(mtar_t *tar, const char *name, size_t size) {
+int mtar_write_file_header(mtar_t *tar, const char *name, uint64_t size) {
   mtar_header_t h;
+  /* Names that do not fit are rejected instead of truncated */
+  if (strlen(name) >= sizeof(h.name)) {
+    return MTAR_EFAILURE;
+  }
   /* Build header */
   memset(&h, 0, sizeof(h));
-  strcpy(h.name, name);
+  copy_name(h.name, sizeof(h.name), name, strlen(name));
   h.size = size;
   h.type = MTAR_TREG;
   h.mode = 0664;
@@ -346,9 +541,13 @@ int mtar_write_file_header(mtar_t *tar, const char *name, size_t size) {
 
 int mtar_write_dir_header(mtar_t *tar, const char *name) {
   mtar_header_t h;
+  /* Names that do not fit are rejected instead of truncated */
+  if (strlen(name) >= sizeof(h.name)) {
+    return MTAR_EFAILURE;
+  }
   /* Build header */
   memset(&h, 0, sizeof(h));
-  strcpy(h.name, name);
+  copy_name(h.name, sizeof(h.name), name, strlen(name));
   h.type = MTAR_TDIR;
   h.mode = 0775;
   /* Write header */
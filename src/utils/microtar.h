@@ -10,6 +10,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #define MTAR_VERSION "0.1.0"
 
@@ -32,18 +33,24 @@ enum {
   MTAR_TCHR   = '3',
   MTAR_TBLK   = '4',
   MTAR_TDIR   = '5',
-  MTAR_TFIFO  = '6'
+  MTAR_TFIFO  = '6',
+  MTAR_TGNU_LONGNAME = 'L',
+  MTAR_TPAX_GLOBAL   = 'g',
+  MTAR_TPAX          = 'x'
 };
 
+/* Longer names from pax headers or GNU long name records are truncated */
+#define MTAR_NAME_MAX 256
+
 typedef struct {
   unsigned mode;
   unsigned owner;
-  unsigned size;
+  uint64_t size;
   unsigned mtime;
   unsigned type;
-  char name[100];
+  char name[MTAR_NAME_MAX];
   char linkname[100];
-  long pos;
+  uint64_t pos;
 } mtar_header_t;
 
 
@@ -52,12 +59,13 @@ typedef struct mtar_t mtar_t;
 struct mtar_t {
   int (*read)(mtar_t *tar, void *data, size_t size);
   int (*write)(mtar_t *tar, const void *data, size_t size);
-  int (*seek)(mtar_t *tar, long pos);
+  int (*seek)(mtar_t *tar, uint64_t pos);
   int (*close)(mtar_t *tar);
   FILE *stream;
-  size_t pos;
-  size_t remaining_data;
-  size_t last_header;
+  uint64_t pos;
+  uint64_t remaining_data;
+  uint64_t last_header;
+  uint64_t data_pos; /* Offset of the data of the last header read */
 };
 
 
@@ -66,7 +74,7 @@ const char* mtar_strerror(int err);
 int mtar_open(mtar_t *tar, const char *filename, const char *mode);
 int mtar_close(mtar_t *tar);
 
-int mtar_seek(mtar_t *tar, long pos);
+int mtar_seek(mtar_t *tar, uint64_t pos);
 int mtar_rewind(mtar_t *tar);
 int mtar_next(mtar_t *tar);
 int mtar_find(mtar_t *tar, const char *name, mtar_header_t *h);
@@ -74,7 +82,7 @@ int mtar_read_header(mtar_t *tar, mtar_header_t *h);
 int mtar_read_data(mtar_t *tar, void *ptr, size_t size);
 
 int mtar_write_header(mtar_t *tar, const mtar_header_t *h);
-int mtar_write_file_header(mtar_t *tar, const char *name, size_t size);
+int mtar_write_file_header(mtar_t *tar, const char *name, uint64_t size);
 int mtar_write_dir_header(mtar_t *tar, const char *name);
 int mtar_write_data(mtar_t *tar, const void *data, size_t size);
 int mtar_finalize(mtar_t *tar);
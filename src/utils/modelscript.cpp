@@ -21,12 +21,55 @@
 
 #include "modelscript.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <c10/core/ScalarType.h>
+
 #include "data/eistotorch.h"
+#include "log.h"
+
+static constexpr size_t COMPILED_MODEL_CACHE_SIZE = 64;
 
 std::shared_ptr<torch::CompilationUnit> compileModel(eis::Model &model)
 {
+	typedef std::list<std::pair<std::string, std::shared_ptr<torch::CompilationUnit>>> CacheList;
+
+	// keyed by the function the callers run, so a cached unit always contains the function the model names
+	std::string key = model.getCompiledFunctionName();
+
+	static std::mutex cacheMutex;
+	static CacheList cache;
+	static std::unordered_map<std::string, CacheList::iterator> lookup;
+
+	{
+		std::scoped_lock lock(cacheMutex);
+		auto search = lookup.find(key);
+		if(search != lookup.end())
+		{
+			cache.splice(cache.begin(), cache, search->second);
+			return search->second->second;
+		}
+	}
+
 	std::string torchScript = model.getTorchScript();
 	std::shared_ptr<torch::CompilationUnit> compiledModule = torch::jit::compile(torchScript);
+
+	std::scoped_lock lock(cacheMutex);
+	auto search = lookup.find(key);
+	if(search != lookup.end())
+		return search->second->second;
+	cache.emplace_front(key, compiledModule);
+	lookup.emplace(key, cache.begin());
+	if(cache.size() > COMPILED_MODEL_CACHE_SIZE)
+	{
+		lookup.erase(cache.back().first);
+		cache.pop_back();
+	}
 	return compiledModule;
 }
 
@@ -57,3 +100,286 @@ torch::Tensor runScriptModel(eis::Model& model, size_t step, std::shared_ptr<tor
 	torch::Tensor parameters = fvalueVectorToTensor(parameterVec);
 	return runScriptModel(model, compiledScript, parameters, omegas);
 }
+
+class CircuitModel::Parser
+{
+private:
+	const std::string& str;
+	size_t pos = 0;
+	size_t parameters = 0;
+
+	static size_t elementParameters(char element)
+	{
+		switch(element)
+		{
+			case 'r':
+			case 'c':
+			case 'l':
+			case 'w':
+				return 1;
+			case 'p':
+				return 2;
+			default:
+				throw std::invalid_argument(std::string("element ") + element + " is not supported natively");
+		}
+	}
+
+	// elements written next to each other are in parallel, parallel groups separated by - are in series
+	Node parseSeries()
+	{
+		Node node;
+		node.type = Node::SERIES;
+		node.children.push_back(parseParallel());
+		while(pos < str.size() && str[pos] == '-')
+		{
+			++pos;
+			node.children.push_back(parseParallel());
+		}
+		return node.children.size() == 1 ? std::move(node.children.front()) : node;
+	}
+
+	Node parseParallel()
+	{
+		Node node;
+		node.type = Node::PARALLEL;
+		while(pos < str.size() && str[pos] != '-' && str[pos] != ')')
+			node.children.push_back(parseTerm());
+		if(node.children.empty())
+			throw std::invalid_argument("empty group at " + std::to_string(pos));
+		return node.children.size() == 1 ? std::move(node.children.front()) : node;
+	}
+
+	Node parseTerm()
+	{
+		if(str[pos] == '(')
+		{
+			++pos;
+			Node node = parseSeries();
+			if(pos >= str.size() || str[pos] != ')')
+				throw std::invalid_argument("unbalanced brackets");
+			++pos;
+			return node;
+		}
+
+		Node node;
+		node.type = Node::ELEMENT;
+		node.element = str[pos];
+		node.parameter = parameters;
+		parameters += elementParameters(str[pos]);
+		++pos;
+
+		// the values given in the model string are not needed, the parameters are supplied at evaluation
+		if(pos < str.size() && str[pos] == '{')
+		{
+			pos = str.find('}', pos);
+			if(pos == std::string::npos)
+				throw std::invalid_argument("unbalanced brackets");
+			++pos;
+		}
+		return node;
+	}
+
+public:
+	explicit Parser(const std::string& strIn): str(strIn)
+	{}
+
+	Node parse()
+	{
+		if(str.empty())
+			throw std::invalid_argument("empty model");
+		Node node = parseSeries();
+		if(pos != str.size())
+			throw std::invalid_argument("unexpected " + std::string(1, str[pos]) + " at " + std::to_string(pos));
+		return node;
+	}
+
+	size_t parameterCount() const
+	{
+		return parameters;
+	}
+};
+
+CircuitModel::CircuitModel(const std::string& modelStrIn): modelStr(modelStrIn)
+{
+	eis::Model model(modelStr);
+	parameterCount = model.getParameterCount();
+
+	try
+	{
+		Parser parser(modelStr);
+		Node node = parser.parse();
+		if(parser.parameterCount() != parameterCount)
+			throw std::invalid_argument("parameter count does not match eisgenerator");
+		root = std::make_unique<Node>(std::move(node));
+	}
+	catch(const std::invalid_argument& err)
+	{
+		Log(Log::DEBUG)<<"Evaluating "<<modelStr<<" with TorchScript: "<<err.what();
+		script = compileModel(model);
+		functionName = model.getCompiledFunctionName();
+	}
+}
+
+torch::Tensor CircuitModel::evaluate(const Node& node, const torch::Tensor& parameters, const torch::Tensor& omegas) const
+{
+	if(node.type == Node::SERIES)
+	{
+		torch::Tensor impedance = evaluate(node.children[0], parameters, omegas);
+		for(size_t i = 1; i < node.children.size(); ++i)
+			impedance = impedance + evaluate(node.children[i], parameters, omegas);
+		return impedance;
+	}
+	else if(node.type == Node::PARALLEL)
+	{
+		torch::Tensor admittance = evaluate(node.children[0], parameters, omegas).reciprocal();
+		for(size_t i = 1; i < node.children.size(); ++i)
+			admittance = admittance + evaluate(node.children[i], parameters, omegas).reciprocal();
+		return admittance.reciprocal();
+	}
+
+	// omegas is [1, points] and every parameter column [batch, 1], so all elements broadcast to [batch, points]
+	torch::Tensor value = parameters.narrow(1, node.parameter, 1);
+	torch::Tensor real;
+	torch::Tensor imag;
+	switch(node.element)
+	{
+		case 'r':
+			real = value.expand({parameters.size(0), omegas.size(1)});
+			imag = torch::zeros_like(real);
+			break;
+		case 'c':
+			imag = -1/(omegas*value);
+			real = torch::zeros_like(imag);
+			break;
+		case 'l':
+			imag = omegas*value;
+			real = torch::zeros_like(imag);
+			break;
+		case 'w':
+			real = value/torch::sqrt(omegas);
+			imag = -real;
+			break;
+		case 'p':
+		{
+			// 1/(q*(j*omega)^alpha) with (j*omega)^alpha = omega^alpha*e^(j*alpha*pi/2)
+			torch::Tensor alpha = parameters.narrow(1, node.parameter + 1, 1);
+			torch::Tensor magnitude = 1/(value*torch::pow(omegas, alpha));
+			torch::Tensor phase = alpha*(M_PI/2);
+			real = magnitude*torch::cos(phase);
+			imag = -magnitude*torch::sin(phase);
+			break;
+		}
+		default:
+			assert(false);
+	}
+	return torch::complex(real, imag);
+}
+
+torch::Tensor CircuitModel::simulate(torch::Tensor parameters, const torch::Tensor& omegas) const
+{
+	const bool single = parameters.dim() == 1;
+	if(single)
+		parameters = parameters.unsqueeze(0);
+	if(parameters.dim() != 2 || parameters.size(1) != static_cast<int64_t>(parameterCount))
+	{
+		throw std::invalid_argument("model " + modelStr + " expects " + std::to_string(parameterCount) +
+			" parameters per row, got a tensor of size " + std::to_string(parameters.size(-1)));
+	}
+
+	torch::Tensor omegaRow = omegas.reshape({1, -1}).to(parameters.device(), parameters.scalar_type());
+	torch::Tensor impedance;
+	if(root)
+	{
+		impedance = evaluate(*root, parameters, omegaRow);
+	}
+	else
+	{
+		const int64_t batch = parameters.size(0);
+		const int64_t points = omegaRow.size(1);
+		// scripts that evaluate one set of parameters per column return [omegas, batch]
+		torch::Tensor result = script->run_method(functionName, parameters.t(), omegaRow.t()).toTensor();
+		if(result.sizes() == torch::IntArrayRef({points, batch}) || (batch == 1 && result.numel() == points))
+		{
+			impedance = result.reshape({points, batch}).t();
+		}
+		else
+		{
+			// otherwise the script only handles a single set of parameters, so the rows are evaluated one by one
+			std::vector<torch::Tensor> rows(batch);
+			for(int64_t row = 0; row < batch; ++row)
+			{
+				torch::Tensor rowResult = script->run_method(functionName, parameters[row], omegaRow.t()).toTensor();
+				if(rowResult.numel() != points)
+				{
+					throw std::runtime_error("TorchScript of " + modelStr + " returned " + std::to_string(rowResult.numel()) +
+						" values for " + std::to_string(points) + " omegas");
+				}
+				rows[row] = rowResult.reshape({points});
+			}
+			impedance = torch::stack(rows);
+		}
+	}
+
+	return single ? impedance.squeeze(0) : impedance;
+}
+
+size_t CircuitModel::getParameterCount() const
+{
+	return parameterCount;
+}
+
+const std::string& CircuitModel::getModelStr() const
+{
+	return modelStr;
+}
+
+bool CircuitModel::isNative() const
+{
+	return root != nullptr;
+}
+
+CircuitSimulator::CircuitSimulator(const std::vector<std::string>& modelStrs)
+{
+	for(const std::string& modelStr : modelStrs)
+		models.push_back(std::make_shared<const CircuitModel>(modelStr));
+}
+
+torch::Tensor CircuitSimulator::simulate(const torch::Tensor& parameters, const torch::Tensor& modelIds, const torch::Tensor& omegas) const
+{
+	assert(parameters.dim() == 2 && modelIds.numel() == parameters.size(0));
+	if(models.size() == 1)
+		return models.front()->simulate(parameters.narrow(1, 0, models.front()->getParameterCount()), omegas);
+
+	torch::Tensor ids = modelIds.reshape({-1}).to(parameters.device(), torch::kInt64);
+	torch::Tensor impedance = torch::zeros({parameters.size(0), omegas.numel()},
+		parameters.options().dtype(c10::toComplexType(parameters.scalar_type())));
+
+	for(size_t i = 0; i < models.size(); ++i)
+	{
+		torch::Tensor rows = torch::nonzero(ids == static_cast<int64_t>(i)).reshape({-1});
+		if(rows.numel() == 0)
+			continue;
+		const CircuitModel& model = *models[i];
+		torch::Tensor part = model.simulate(parameters.index_select(0, rows).narrow(1, 0, model.getParameterCount()), omegas);
+		impedance = impedance.index_copy(0, rows, part);
+	}
+	return impedance;
+}
+
+size_t CircuitSimulator::getParameterCount() const
+{
+	size_t count = 0;
+	for(const std::shared_ptr<const CircuitModel>& model : models)
+		count = std::max(count, model->getParameterCount());
+	return count;
+}
+
+const CircuitModel& CircuitSimulator::getModel(size_t index) const
+{
+	return *models.at(index);
+}
+
+size_t CircuitSimulator::size() const
+{
+	return models.size();
+}
@@ -23,10 +23,17 @@
 #include <eisgenerator/model.h>
 #include <string>
 #include <memory>
+#include <vector>
 #include <torch/jit.h>
 
 #include "torchph.h"
 
+/**
+ * @brief Compiles the TorchScript of a model.
+ *
+ * Compilation units are cached by the name of the compiled function of the model, the most recently used ones are kept in memory and
+ * shared between callers.
+ */
 std::shared_ptr<torch::CompilationUnit> compileModel(eis::Model &model);
 std::shared_ptr<torch::CompilationUnit> compileModel(std::string modelstr);
 
@@ -36,3 +43,77 @@ torch::Tensor runScriptModel(eis::Model& model, std::shared_ptr<torch::Compilati
 torch::Tensor runScriptModel(eis::Model& model, size_t step,
 							std::shared_ptr<torch::CompilationUnit> compiledScript,
 							torch::Tensor omegas);
+
+/**
+ * @brief Evaluates a circuit model for a batch of parameter sets with native tensor operations.
+ *
+ * The model string is parsed into a tree of series and parallel connections of r, c, l, p (cpe) and w (warburg)
+ * elements, which is evaluated with differentiable tensor operations on the device of the parameters.
+ * Models with other elements fall back to the TorchScript of eis::Model.
+ */
+class CircuitModel
+{
+private:
+	struct Node
+	{
+		enum Type
+		{
+			SERIES,
+			PARALLEL,
+			ELEMENT
+		};
+
+		Type type = ELEMENT;
+		char element = 0;
+		size_t parameter = 0;
+		std::vector<Node> children;
+	};
+
+	class Parser;
+
+	std::string modelStr;
+	size_t parameterCount;
+	std::unique_ptr<Node> root;
+	std::shared_ptr<torch::CompilationUnit> script;
+	std::string functionName;
+
+	torch::Tensor evaluate(const Node& node, const torch::Tensor& parameters, const torch::Tensor& omegas) const;
+
+public:
+	explicit CircuitModel(const std::string& modelStr);
+
+	/**
+	 * @brief Computes the impedance of the model
+	 * @param parameters the parameters of the model as [batch, parameters] or [parameters]
+	 * @param omegas the angular frequencies to evaluate at
+	 * @return the complex impedance as [batch, omegas] or [omegas], differentiable with respect to parameters
+	 */
+	torch::Tensor simulate(torch::Tensor parameters, const torch::Tensor& omegas) const;
+
+	size_t getParameterCount() const;
+	const std::string& getModelStr() const;
+	bool isNative() const;
+};
+
+/**
+ * @brief Evaluates a batch that mixes several circuit models, grouping the rows by model
+ */
+class CircuitSimulator
+{
+private:
+	std::vector<std::shared_ptr<const CircuitModel>> models;
+
+public:
+	explicit CircuitSimulator(const std::vector<std::string>& modelStrs);
+
+	/**
+	 * @param parameters [batch, getParameterCount()], rows of models with fewer parameters are padded at the end
+	 * @param modelIds [batch] integer index of the model of every row
+	 * @return the complex impedance as [batch, omegas]
+	 */
+	torch::Tensor simulate(const torch::Tensor& parameters, const torch::Tensor& modelIds, const torch::Tensor& omegas) const;
+
+	size_t getParameterCount() const;
+	const CircuitModel& getModel(size_t index) const;
+	size_t size() const;
+};
@@ -0,0 +1,84 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Calls function(i) for every i in [0, count) spread over threads threads, the calling thread included.
+ *
+ * Indices are claimed in small chunks so that slow items, like files on a network filesystem, do not stall a thread
+ * with a large static share of the work. The first exception thrown by function stops all threads and is rethrown.
+ * @param threads the number of threads to use, 0 uses one per hardware thread
+ */
+template <typename Function>
+void parallelFor(size_t count, Function function, size_t threads = 0)
+{
+	constexpr size_t CHUNK_SIZE = 16;
+
+	if(threads == 0)
+		threads = std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
+	threads = std::max<size_t>(std::min(threads, (count + CHUNK_SIZE - 1)/CHUNK_SIZE), 1);
+
+	std::atomic<size_t> next = 0;
+	std::atomic<bool> failed = false;
+	std::exception_ptr error;
+	std::mutex errorMutex;
+
+	auto work = [&]()
+	{
+		try
+		{
+			while(!failed)
+			{
+				size_t begin = next.fetch_add(CHUNK_SIZE);
+				if(begin >= count)
+					break;
+				size_t end = std::min(begin + CHUNK_SIZE, count);
+				for(size_t i = begin; i < end; ++i)
+					function(i);
+			}
+		}
+		catch(...)
+		{
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if(!error)
+				error = std::current_exception();
+			failed = true;
+		}
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	for(size_t i = 1; i < threads; ++i)
+		workers.push_back(std::thread(work));
+	work();
+	for(std::thread& worker : workers)
+		worker.join();
+
+	if(error)
+		std::rethrow_exception(error);
+}
@@ -21,32 +21,138 @@
 
 #include "randomgen.h"
 #include <assert.h>
+#include <atomic>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <random>
 
-static std::default_random_engine randomEngine;
+static std::atomic<uint64_t> globalSeed{0x853c49e6748fea9b};
+static std::atomic<uint64_t> seedGeneration{0};
+static std::atomic<uint64_t> threadCounter{0};
+
+static uint64_t splitMix(uint64_t x)
+{
+	x += 0x9e3779b97f4a7c15;
+	x = (x ^ (x >> 30))*0xbf58476d1ce4e5b9;
+	x = (x ^ (x >> 27))*0x94d049bb133111eb;
+	return x ^ (x >> 31);
+}
+
+// every thread gets its own engine that is reseeded when the global seed changes
+static std::mt19937_64& engine()
+{
+	thread_local std::mt19937_64 randomEngine;
+	thread_local uint64_t thread = threadCounter.fetch_add(1, std::memory_order_relaxed);
+	thread_local uint64_t generation = UINT64_MAX;
+
+	uint64_t current = seedGeneration.load(std::memory_order_acquire);
+	if(generation != current)
+	{
+		randomEngine.seed(splitMix(globalSeed.load(std::memory_order_relaxed) ^ splitMix(thread)));
+		generation = current;
+	}
+	return randomEngine;
+}
 
 double rd::rand(double min, double max)
 {
 	std::uniform_real_distribution<double> dist(min, max);
-	return dist(randomEngine);
+	return dist(engine());
 }
 
 double rd::rand(double max)
 {
-	static std::uniform_real_distribution<double> dist(0, 1);
-	return dist(randomEngine)*max;
+	std::uniform_real_distribution<double> dist(0, 1);
+	return dist(engine())*max;
 }
 
 size_t rd::uid()
 {
-	static std::uniform_int_distribution<size_t> distSt(0, SIZE_MAX);
-	return distSt(randomEngine);
+	std::uniform_int_distribution<size_t> distSt(0, SIZE_MAX);
+	return distSt(engine());
+}
+
+void rd::seed(uint64_t seed)
+{
+	globalSeed.store(seed, std::memory_order_relaxed);
+	seedGeneration.fetch_add(1, std::memory_order_release);
+}
+
+uint64_t rd::getSeed()
+{
+	return globalSeed.load(std::memory_order_relaxed);
 }
 
 void rd::init()
 {
 	std::random_device randomDevice;
-	randomEngine.seed(randomDevice());
+	seed(static_cast<uint64_t>(randomDevice()) << 32 | randomDevice());
+}
+
+rd::Philox::Philox(uint64_t seed, uint64_t stream)
+{
+	uint64_t mixed = splitMix(seed ^ splitMix(stream));
+	key[0] = static_cast<uint32_t>(mixed);
+	key[1] = static_cast<uint32_t>(mixed >> 32);
+}
+
+std::array<uint32_t, 4> rd::Philox::block(uint64_t index, uint64_t position) const
+{
+	return block({static_cast<uint32_t>(position), static_cast<uint32_t>(position >> 32),
+		static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32)}, {key[0], key[1]});
+}
+
+std::array<uint32_t, 4> rd::Philox::block(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> roundKey)
+{
+	constexpr uint32_t multiplier0 = 0xd2511f53;
+	constexpr uint32_t multiplier1 = 0xcd9e8d57;
+	constexpr uint32_t weyl0 = 0x9e3779b9;
+	constexpr uint32_t weyl1 = 0xbb67ae85;
+
+	for(int round = 0; round < 10; ++round)
+	{
+		uint64_t product0 = static_cast<uint64_t>(multiplier0)*counter[0];
+		uint64_t product1 = static_cast<uint64_t>(multiplier1)*counter[2];
+		uint32_t next[4] = {
+			static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ roundKey[0],
+			static_cast<uint32_t>(product1),
+			static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ roundKey[1],
+			static_cast<uint32_t>(product0)};
+		for(int i = 0; i < 4; ++i)
+			counter[i] = next[i];
+		roundKey[0] += weyl0;
+		roundKey[1] += weyl1;
+	}
+
+	return counter;
+}
+
+void rd::Philox::uniform(float* out, size_t count, uint64_t index, uint64_t position) const
+{
+	for(size_t i = 0; i < count; i += 4)
+	{
+		std::array<uint32_t, 4> values = block(index, position + i/4);
+		for(size_t j = 0; j < 4 && i + j < count; ++j)
+			out[i + j] = static_cast<float>(values[j] >> 8)*(1.0f/16777216.0f);
+	}
+}
+
+void rd::Philox::normal(float* out, size_t count, uint64_t index, uint64_t position) const
+{
+	constexpr float twoPi = 6.283185307179586f;
+	for(size_t i = 0; i < count; i += 4)
+	{
+		std::array<uint32_t, 4> values = block(index, position + i/4);
+		for(size_t j = 0; j < 4 && i + j < count; j += 2)
+		{
+			// box muller, the first value is shifted into (0, 1] so that the logarithm is finite
+			float radiusUniform = (static_cast<float>(values[j] >> 8) + 1.0f)*(1.0f/16777216.0f);
+			float angleUniform = static_cast<float>(values[j + 1] >> 8)*(1.0f/16777216.0f);
+			float radius = std::sqrt(-2.0f*std::log(radiusUniform));
+			out[i + j] = radius*std::cos(twoPi*angleUniform);
+			if(i + j + 1 < count)
+				out[i + j + 1] = radius*std::sin(twoPi*angleUniform);
+		}
+	}
 }
@@ -20,11 +20,51 @@
 
 #pragma once
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
+
 namespace rd
 {
+// these are safe to call from any thread, every thread draws from its own engine
 double rand(double max = 1);
 double rand(double min, double max);
 void init();
+void seed(uint64_t seed);
+uint64_t getSeed();
 size_t uid();
+
+/**
+ * @brief Counter based Philox4x32-10 generator.
+ *
+ * The generator has no state besides its key, the value for a given key and counter is always the same,
+ * so any thread can draw any part of the stream without synchronization and in any order.
+ * The key is derived from a seed and a stream number such as the epoch,
+ * the counter from an index such as the sample index and a position inside the samples stream.
+ */
+class Philox
+{
+private:
+	uint32_t key[2];
+
+public:
+	Philox(uint64_t seed, uint64_t stream = 0);
+
+	std::array<uint32_t, 4> block(uint64_t index, uint64_t position) const;
+
+	/**
+	 * @brief The Philox4x32-10 function itself, for a raw counter and key as used by the Random123 known answer tests
+	 */
+	static std::array<uint32_t, 4> block(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key);
+
+	/**
+	 * @brief Fills out with count uniform values in [0, 1) drawn from the stream of index starting at block position
+	 */
+	void uniform(float* out, size_t count, uint64_t index, uint64_t position = 0) const;
+
+	/**
+	 * @brief Fills out with count standard normal values drawn from the stream of index starting at block position
+	 */
+	void normal(float* out, size_t count, uint64_t index, uint64_t position = 0) const;
+};
 }
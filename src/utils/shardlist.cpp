@@ -0,0 +1,96 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "shardlist.h"
+
+#include <algorithm>
+#include <fstream>
+#include <glob.h>
+#include <string>
+
+#include "log.h"
+
+static bool isGlob(const std::string& spec)
+{
+	return spec.find_first_of("*?[") != std::string::npos;
+}
+
+static bool isManifest(const std::filesystem::path& spec)
+{
+	return spec.extension() == ".manifest";
+}
+
+bool isShardSpec(const std::filesystem::path& spec)
+{
+	return isGlob(spec.string()) || isManifest(spec);
+}
+
+static std::vector<std::filesystem::path> expandGlob(const std::string& pattern)
+{
+	std::vector<std::filesystem::path> out;
+	glob_t result;
+	int ret = glob(pattern.c_str(), GLOB_ERR, nullptr, &result);
+	if(ret == 0)
+	{
+		for(size_t i = 0; i < result.gl_pathc; ++i)
+			out.push_back(result.gl_pathv[i]);
+	}
+	else if(ret != GLOB_NOMATCH)
+	{
+		Log(Log::ERROR)<<"Unable to expand "<<pattern;
+	}
+	globfree(&result);
+	std::sort(out.begin(), out.end());
+	return out;
+}
+
+static std::vector<std::filesystem::path> readManifest(const std::filesystem::path& manifest)
+{
+	std::vector<std::filesystem::path> out;
+	std::ifstream file(manifest);
+	if(!file.is_open())
+	{
+		Log(Log::ERROR)<<"Unable to open shard manifest "<<manifest;
+		return out;
+	}
+
+	std::string line;
+	while(std::getline(file, line))
+	{
+		size_t begin = line.find_first_not_of(" \t\r");
+		if(begin == std::string::npos || line[begin] == '#')
+			continue;
+		size_t end = line.find_last_not_of(" \t\r");
+		std::filesystem::path shard = line.substr(begin, end - begin + 1);
+		if(shard.is_relative())
+			shard = manifest.parent_path()/shard;
+		out.push_back(shard);
+	}
+	return out;
+}
+
+std::vector<std::filesystem::path> expandShards(const std::filesystem::path& spec)
+{
+	if(isManifest(spec))
+		return readManifest(spec);
+	if(isGlob(spec.string()))
+		return expandGlob(spec.string());
+	return {spec};
+}
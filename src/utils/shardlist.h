@@ -0,0 +1,41 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <filesystem>
+#include <vector>
+
+/**
+ * @brief Returns true if spec names several dataset shards rather than a single dataset.
+ *
+ * A spec containing any of the glob characters *?[ is expanded as a glob pattern,
+ * a spec ending in .manifest names a text file that lists one shard per line.
+ */
+bool isShardSpec(const std::filesystem::path& spec);
+
+/**
+ * @brief Expands a shard spec to the list of shard paths.
+ *
+ * Shards of a glob are returned in lexical order. Relative paths in a manifest are relative to
+ * the directory of the manifest, empty lines and lines starting with # are ignored.
+ * A spec that is neither a glob nor a manifest is returned as is.
+ * @return the shards, empty if the spec matched nothing or the manifest could not be read
+ */
+std::vector<std::filesystem::path> expandShards(const std::filesystem::path& spec);
@@ -0,0 +1,449 @@
+//
+// TorchKissAnn - A collection of tools to train various types of Machine learning
+// algorithms on various types of EIS data
+// Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+//
+// This file is part of TorchKissAnn.
+//
+// TorchKissAnn is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TorchKissAnn is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "tarscan.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <string_view>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+static constexpr uint64_t ARCHIVE_END = std::numeric_limits<uint64_t>::max();
+static constexpr uint64_t NO_HEADER = std::numeric_limits<uint64_t>::max() - 1;
+
+static constexpr size_t NAME_OFFSET = 0;
+static constexpr size_t NAME_SIZE = 100;
+static constexpr size_t SIZE_OFFSET = 124;
+static constexpr size_t SIZE_SIZE = 12;
+static constexpr size_t CHECKSUM_OFFSET = 148;
+static constexpr size_t CHECKSUM_SIZE = 8;
+static constexpr size_t TYPE_OFFSET = 156;
+static constexpr size_t MAGIC_OFFSET = 257;
+static constexpr size_t PREFIX_OFFSET = 345;
+static constexpr size_t PREFIX_SIZE = 155;
+// extension headers larger than this are considered corrupt
+static constexpr uint64_t MAX_EXTENSION_SIZE = 1024*1024;
+
+typedef enum
+{
+	HEADER_VALID,
+	HEADER_NULL,
+	HEADER_INVALID
+} HeaderResult;
+
+struct TarScanner::RangeResult
+{
+	std::vector<Member> members;
+	uint64_t start = NO_HEADER;
+	uint64_t end = NO_HEADER;
+	bool valid = true;
+	std::exception_ptr error;
+};
+
+class TarScanner::ChunkReader
+{
+	const Reader& reader;
+	uint64_t length;
+	std::atomic<uint64_t>& scanned;
+	std::vector<char> buffer;
+	uint64_t start = 0;
+	size_t filled = 0;
+
+public:
+	ChunkReader(const Reader& readerI, uint64_t lengthI, std::atomic<uint64_t>& scannedI):
+	reader(readerI), length(lengthI), scanned(scannedI), buffer(CHUNK_SIZE)
+	{}
+
+	// returns the block at pos or nullptr if the archive ends before it
+	const char* block(uint64_t pos)
+	{
+		if(pos > length || length - pos < BLOCK_SIZE)
+			return nullptr;
+
+		if(pos < start || pos + BLOCK_SIZE > start + filled)
+		{
+			size_t want = std::min<uint64_t>(CHUNK_SIZE, length - pos);
+			size_t got = reader(buffer.data(), want, pos);
+			start = pos;
+			filled = got;
+			scanned += got;
+			if(filled < BLOCK_SIZE)
+				return nullptr;
+		}
+
+		return buffer.data() + (pos - start);
+	}
+};
+
+static uint64_t parseNumeric(const char* field, size_t size)
+{
+	// GNU base-256 encoding, used for values that do not fit in octal
+	if(static_cast<unsigned char>(field[0]) & 0x80)
+	{
+		uint64_t value = static_cast<unsigned char>(field[0]) & 0x7f;
+		for(size_t i = 1; i < size; ++i)
+			value = (value << 8) | static_cast<unsigned char>(field[i]);
+		return value;
+	}
+
+	size_t i = 0;
+	while(i < size && (field[i] == ' ' || field[i] == '\0'))
+		++i;
+	uint64_t value = 0;
+	for(; i < size && field[i] >= '0' && field[i] <= '7'; ++i)
+		value = (value << 3) | static_cast<uint64_t>(field[i] - '0');
+	return value;
+}
+
+static bool isUstar(const char* block)
+{
+	return std::memcmp(block + MAGIC_OFFSET, "ustar", 5) == 0;
+}
+
+static bool checksumValid(const char* block)
+{
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(block);
+	uint64_t sum = 0;
+	for(size_t i = 0; i < TarScanner::BLOCK_SIZE; ++i)
+		sum += (i >= CHECKSUM_OFFSET && i < CHECKSUM_OFFSET + CHECKSUM_SIZE) ? ' ' : data[i];
+	return sum == parseNumeric(block + CHECKSUM_OFFSET, CHECKSUM_SIZE);
+}
+
+static HeaderResult parseHeader(const char* block, TarScanner::Member& member, char& type)
+{
+	if(block[CHECKSUM_OFFSET] == '\0')
+		return HEADER_NULL;
+	if(!checksumValid(block))
+		return HEADER_INVALID;
+
+	type = block[TYPE_OFFSET];
+	member.size = parseNumeric(block + SIZE_OFFSET, SIZE_SIZE);
+	member.name.assign(block + NAME_OFFSET, strnlen(block + NAME_OFFSET, NAME_SIZE));
+	if(isUstar(block) && block[PREFIX_OFFSET] != '\0')
+	{
+		std::string prefix(block + PREFIX_OFFSET, strnlen(block + PREFIX_OFFSET, PREFIX_SIZE));
+		member.name = prefix + '/' + member.name;
+	}
+	return HEADER_VALID;
+}
+
+static uint64_t roundUp(uint64_t n, uint64_t incr)
+{
+	return n + (incr - n % incr) % incr;
+}
+
+static bool isExtension(char type)
+{
+	return type == 'x' || type == 'g' || type == 'L' || type == 'K';
+}
+
+// the overrides pax and GNU long name headers carry for the member that follows them
+struct Extension
+{
+	std::string name;
+	uint64_t size = 0;
+	bool hasName = false;
+	bool hasSize = false;
+
+	bool pending() const
+	{
+		return hasName || hasSize;
+	}
+
+	void parsePax(std::string_view data)
+	{
+		// records have the form "<length> <key>=<value>\n"
+		while(!data.empty())
+		{
+			size_t space = data.find(' ');
+			if(space == std::string_view::npos)
+				return;
+			uint64_t length = 0;
+			for(size_t i = 0; i < space && data[i] >= '0' && data[i] <= '9'; ++i)
+				length = length*10 + (data[i] - '0');
+			if(length <= space + 1 || length > data.size())
+				return;
+
+			std::string_view record = data.substr(space + 1, length - space - 2);
+			size_t equals = record.find('=');
+			if(equals != std::string_view::npos)
+			{
+				std::string_view key = record.substr(0, equals);
+				std::string_view value = record.substr(equals + 1);
+				if(key == "path")
+				{
+					name.assign(value);
+					hasName = true;
+				}
+				else if(key == "size")
+				{
+					size = 0;
+					for(char digit : value)
+						size = size*10 + (digit - '0');
+					hasSize = true;
+				}
+			}
+			data.remove_prefix(length);
+		}
+	}
+};
+
+TarScanner::TarScanner(const std::filesystem::path& path): name(path.string())
+{
+	fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		throw scan_error("Unable to open " + path.string() + ": " + std::strerror(errno));
+
+	struct stat st;
+	if(fstat(fd, &st) != 0)
+	{
+		int err = errno;
+		::close(fd);
+		throw scan_error("Unable to stat " + path.string() + ": " + std::strerror(err));
+	}
+	length = st.st_size;
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	reader = [this](char* buffer, size_t size, uint64_t offset) -> size_t
+	{
+		size_t got = 0;
+		while(got < size)
+		{
+			ssize_t ret = pread(fd, buffer + got, size - got, offset + got);
+			if(ret < 0 && errno == EINTR)
+				continue;
+			if(ret < 0)
+				throw scan_error(std::string("Unable to read tar archive: ") + std::strerror(errno));
+			if(ret == 0)
+				break;
+			got += ret;
+		}
+		return got;
+	};
+}
+
+TarScanner::TarScanner(Reader readerI, uint64_t lengthI, const std::string& nameI):
+reader(std::move(readerI)), length(lengthI), name(nameI)
+{
+}
+
+TarScanner::~TarScanner()
+{
+	if(fd >= 0)
+		::close(fd);
+}
+
+void TarScanner::scanRange(uint64_t begin, uint64_t end, bool search, RangeResult& result)
+{
+	ChunkReader chunks(reader, length, scanned);
+	uint64_t pos = begin;
+
+	result.members.clear();
+	result.valid = true;
+
+	if(search)
+	{
+		const char* block = chunks.block(pos);
+		while(pos < end && block && !(isUstar(block) && checksumValid(block)))
+		{
+			pos += BLOCK_SIZE;
+			block = chunks.block(pos);
+		}
+		if(pos >= end || !block)
+		{
+			result.start = NO_HEADER;
+			result.end = NO_HEADER;
+			return;
+		}
+	}
+
+	result.start = pos;
+	Member member;
+	Extension extension;
+	char type;
+	// a extension header applies to the next member, so a range only ends after the member that uses it
+	while(pos < end || extension.pending())
+	{
+		const char* block = chunks.block(pos);
+		if(!block)
+		{
+			pos = ARCHIVE_END;
+			break;
+		}
+
+		HeaderResult ret = parseHeader(block, member, type);
+		if(ret == HEADER_NULL)
+		{
+			pos = ARCHIVE_END;
+			break;
+		}
+		else if(ret == HEADER_INVALID)
+		{
+			if(search)
+			{
+				result.valid = false;
+				return;
+			}
+			throw scan_error(name + " has a corrupt header at offset " + std::to_string(pos));
+		}
+
+		if(isExtension(type))
+		{
+			if(member.size > MAX_EXTENSION_SIZE)
+			{
+				if(search)
+				{
+					result.valid = false;
+					return;
+				}
+				throw scan_error(name + " has a corrupt extension header at offset " + std::to_string(pos));
+			}
+
+			std::string data;
+			for(uint64_t offset = 0; offset < member.size; offset += BLOCK_SIZE)
+			{
+				const char* dataBlock = chunks.block(pos + BLOCK_SIZE + offset);
+				if(!dataBlock)
+					throw scan_error(name + " ends inside a extension header");
+				data.append(dataBlock, std::min<uint64_t>(BLOCK_SIZE, member.size - offset));
+			}
+
+			if(type == 'L')
+			{
+				extension.name.assign(data.c_str());
+				extension.hasName = true;
+			}
+			else if(type == 'x')
+			{
+				extension.parsePax(data);
+			}
+		}
+		else
+		{
+			if(extension.hasName)
+				member.name = std::move(extension.name);
+			if(extension.hasSize)
+				member.size = extension.size;
+			extension = Extension();
+
+			if(type == '0' || type == '\0')
+			{
+				member.pos = pos + BLOCK_SIZE;
+				result.members.push_back(member);
+			}
+		}
+		pos += BLOCK_SIZE + roundUp(member.size, BLOCK_SIZE);
+	}
+	result.end = pos;
+}
+
+std::vector<TarScanner::Member> TarScanner::scan(size_t threads)
+{
+	scanned = 0;
+
+	char block[BLOCK_SIZE];
+	if(reader(block, BLOCK_SIZE, 0) != BLOCK_SIZE || block[CHECKSUM_OFFSET] == '\0' || !checksumValid(block))
+		throw scan_error(name + " is not a valid tar archive");
+
+	// searching for headers in the middle of a archive relies on the ustar magic
+	if(!isUstar(block))
+		threads = 1;
+
+	if(threads == 0)
+		threads = std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
+	threads = std::max<size_t>(std::min<uint64_t>(threads, length/MIN_RANGE_SIZE), 1);
+
+	uint64_t rangeSize = roundUp(length/threads, BLOCK_SIZE);
+	std::vector<uint64_t> bounds(threads + 1);
+	for(size_t i = 0; i < threads; ++i)
+		bounds[i] = std::min<uint64_t>(i*rangeSize, length);
+	bounds[threads] = length;
+
+	std::vector<RangeResult> results(threads);
+	std::vector<std::thread> workers;
+	for(size_t i = 1; i < threads; ++i)
+	{
+		workers.push_back(std::thread([this, &bounds, &results, i]()
+		{
+			try
+			{
+				scanRange(bounds[i], bounds[i+1], true, results[i]);
+			}
+			catch(...)
+			{
+				results[i].error = std::current_exception();
+			}
+		}));
+	}
+
+	try
+	{
+		scanRange(bounds[0], bounds[1], false, results[0]);
+	}
+	catch(...)
+	{
+		results[0].error = std::current_exception();
+	}
+
+	for(std::thread& worker : workers)
+		worker.join();
+
+	if(results[0].error)
+		std::rethrow_exception(results[0].error);
+
+	// stitch the chains together, rescaning any range that was entered at a false header
+	uint64_t expected = results[0].end;
+	for(size_t i = 1; i < threads; ++i)
+	{
+		if(expected >= bounds[i+1])
+		{
+			results[i].members.clear();
+			continue;
+		}
+		if(results[i].error || !results[i].valid || results[i].start != expected)
+			scanRange(expected, bounds[i+1], false, results[i]);
+		expected = results[i].end;
+	}
+
+	size_t count = 0;
+	for(const RangeResult& result : results)
+		count += result.members.size();
+
+	std::vector<Member> members;
+	members.reserve(count);
+	for(RangeResult& result : results)
+		std::move(result.members.begin(), result.members.end(), std::back_inserter(members));
+	return members;
+}
+
+uint64_t TarScanner::bytesScanned() const
+{
+	return scanned;
+}
+
+uint64_t TarScanner::size() const
+{
+	return length;
+}
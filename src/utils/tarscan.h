@@ -0,0 +1,111 @@
+/* * TorchKissAnn - A collection of tools to train various types of Machine learning
+ * algorithms on various types of EIS data
+ * Copyright (C) 2025 Carl Klemm <carl@uvos.xyz>
+ *
+ * This file is part of TorchKissAnn.
+ *
+ * TorchKissAnn is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TorchKissAnn is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TorchKissAnn.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Lists the regular files in a tar archive.
+ *
+ * The archive is read in large sequential chunks and the headers are parsed in place,
+ * so the scan is limited by disk bandwith instead of the latency of many small reads.
+ * Large archives are split into byte ranges that are scanned by seperate threads, the
+ * resulting chains of headers are then stitched together and any range whose chain
+ * dose not line up with the one before it is rescanned serially.
+ * Sizes beyond the octal limit in GNU base-256 encoding as well as pax and GNU long name
+ * extension headers are supported.
+ * Instead of a file the scanner can also read from a Reader, for example to scan the
+ * uncompressed contents of a compressed archive.
+ */
+class TarScanner
+{
+public:
+	static constexpr size_t BLOCK_SIZE = 512;
+	static constexpr size_t CHUNK_SIZE = 8*1024*1024;
+	static constexpr uint64_t MIN_RANGE_SIZE = 256*1024*1024;
+
+	/**
+	 * @brief Reads size bytes at offset into buffer, returns the number of bytes read, which is only less than size at the end of the data
+	 */
+	typedef std::function<size_t(char* buffer, size_t size, uint64_t offset)> Reader;
+
+	struct Member
+	{
+		std::string name;
+		uint64_t pos; // offset of the file data in the archive
+		uint64_t size;
+	};
+
+	class scan_error: public std::exception
+	{
+		std::string whatStr;
+	public:
+		scan_error(const std::string& whatIn): whatStr(whatIn)
+		{}
+		virtual const char* what() const noexcept override
+		{
+			return whatStr.c_str();
+		}
+	};
+
+private:
+	struct RangeResult;
+	class ChunkReader;
+
+	int fd = -1;
+	Reader reader;
+	uint64_t length = 0;
+	std::string name;
+	std::atomic<uint64_t> scanned = 0;
+
+	void scanRange(uint64_t begin, uint64_t end, bool search, RangeResult& result);
+
+public:
+	explicit TarScanner(const std::filesystem::path& path);
+	/**
+	 * @brief Scans the data returned by reader instead of a file
+	 * @param reader the reader to read from, it is called from multiple threads at once
+	 * @param length the length of the data
+	 * @param name the name of the archive used in error messages
+	 */
+	TarScanner(Reader reader, uint64_t length, const std::string& name);
+	TarScanner(const TarScanner& in) = delete;
+	TarScanner& operator=(const TarScanner& in) = delete;
+	~TarScanner();
+
+	/**
+	 * @brief Scans the archive
+	 * @param threads the number of threads to use, 0 selects a suitable number based on the archive size
+	 * @return all regular files in the archive in the order they appear
+	 */
+	std::vector<Member> scan(size_t threads = 0);
+
+	/**
+	 * @brief The number of bytes read so far, can be polled from other threads to report progress
+	 */
+	uint64_t bytesScanned() const;
+	uint64_t size() const;
+};